@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <concepts>
+
+#include "math_functions.hpp"
+
+// A dual number value + derivative*e with e^2 = 0. Nesting them,
+// Dual<Dual<T>>, gives hyper-dual numbers carrying two independent
+// infinitesimals and their mixed second order term.
+template<class T>
+struct Dual {
+    constexpr Dual(T v = T{}, T d = T{})
+        : value{std::move(v)}, derivative{std::move(d)}
+    {}
+
+    template<std::integral I>
+    constexpr Dual(I v) : Dual(T(v)) {}
+
+    constexpr auto& operator+=(const Dual& other) {
+        value += other.value;
+        derivative += other.derivative;
+        return *this;
+    }
+
+    constexpr auto& operator-=(const Dual& other) {
+        value -= other.value;
+        derivative -= other.derivative;
+        return *this;
+    }
+
+    constexpr auto& operator*=(const Dual& other) {
+        derivative = derivative * other.value + value * other.derivative;
+        value *= other.value;
+        return *this;
+    }
+
+    constexpr auto& operator/=(const Dual& other) {
+        derivative = (derivative * other.value - value * other.derivative) / (other.value * other.value);
+        value /= other.value;
+        return *this;
+    }
+
+    friend constexpr auto operator-(const Dual& x) { return Dual(-x.value, -x.derivative); }
+    friend constexpr auto operator+(Dual lhs, const Dual& rhs) { lhs += rhs; return lhs; }
+    friend constexpr auto operator-(Dual lhs, const Dual& rhs) { lhs -= rhs; return lhs; }
+    friend constexpr auto operator*(Dual lhs, const Dual& rhs) { lhs *= rhs; return lhs; }
+    friend constexpr auto operator/(Dual lhs, const Dual& rhs) { lhs /= rhs; return lhs; }
+    // For the d == T{} check of reverse_sweep over dual numbers
+    friend constexpr bool operator==(const Dual&, const Dual&) = default;
+
+    T value;
+    T derivative;
+};
+
+template<class T>
+using HyperDual = Dual<Dual<T>>;
+
+// A value with derivatives in N directions at once. The directions are
+// stored contiguously, so every operation is a loop over N lanes.
+template<class T, std::size_t N>
+struct VectorDual {
+    constexpr VectorDual(T v = T{})
+        : value{std::move(v)}, derivatives{}
+    {}
+
+    template<std::integral I>
+    constexpr VectorDual(I v) : VectorDual(T(v)) {}
+
+    constexpr VectorDual(T v, std::array<T, N> d)
+        : value{std::move(v)}, derivatives{std::move(d)}
+    {}
+
+    constexpr auto& operator+=(const VectorDual& other) {
+        value += other.value;
+        for(std::size_t k = 0; k < N; k++) derivatives[k] += other.derivatives[k];
+        return *this;
+    }
+
+    constexpr auto& operator-=(const VectorDual& other) {
+        value -= other.value;
+        for(std::size_t k = 0; k < N; k++) derivatives[k] -= other.derivatives[k];
+        return *this;
+    }
+
+    constexpr auto& operator*=(const VectorDual& other) {
+        for(std::size_t k = 0; k < N; k++){
+            derivatives[k] = derivatives[k] * other.value + value * other.derivatives[k];
+        }
+        value *= other.value;
+        return *this;
+    }
+
+    constexpr auto& operator/=(const VectorDual& other) {
+        auto inv = T{1} / other.value;
+        value *= inv;
+        for(std::size_t k = 0; k < N; k++){
+            derivatives[k] = (derivatives[k] - value * other.derivatives[k]) * inv;
+        }
+        return *this;
+    }
+
+    // Chain rule, given f(value) and f'(value)
+    constexpr auto apply(T fx, const T& dfx) const {
+        auto ret = VectorDual(std::move(fx));
+        for(std::size_t k = 0; k < N; k++) ret.derivatives[k] = dfx * derivatives[k];
+        return ret;
+    }
+
+    friend constexpr auto operator-(const VectorDual& x) { return x.apply(-x.value, T{-1}); }
+    friend constexpr auto operator+(VectorDual lhs, const VectorDual& rhs) { lhs += rhs; return lhs; }
+    friend constexpr auto operator-(VectorDual lhs, const VectorDual& rhs) { lhs -= rhs; return lhs; }
+    friend constexpr auto operator*(VectorDual lhs, const VectorDual& rhs) { lhs *= rhs; return lhs; }
+    friend constexpr auto operator/(VectorDual lhs, const VectorDual& rhs) { lhs /= rhs; return lhs; }
+
+    T value;
+    std::array<T, N> derivatives;
+};
+
+template<class T>
+auto log(const Dual<T>& x) -> Dual<T> {
+    using std::log;
+    return Dual<T>(log(x.value), x.derivative / x.value);
+}
+
+template<class T, std::integral U>
+struct math::impl::pow<Dual<T>, U>{
+    static constexpr auto func(const Dual<T>& x, U n) -> Dual<T> {
+        if(n == 0) return Dual<T>(T{1});
+        auto p = math::pow(x.value, n - 1);
+        return Dual<T>(p * x.value, T(n) * p * x.derivative);
+    }
+};
+
+template<class T>
+struct math::impl::pow<Dual<T>, Dual<T>>{
+    // d(x^y) = y*x^(y-1)*dx + x^y*log(x)*dy. The log term is only added
+    // for exponents that vary, so that x^y with a constant y > 1 is still
+    // differentiable at x = 0.
+    static auto func(const Dual<T>& x, const Dual<T>& y) -> Dual<T> {
+        using std::log;
+        auto v = math::pow(x.value, y.value);
+        auto d = y.value * math::pow(x.value, y.value - T(1)) * x.derivative;
+        if(y.derivative != T{}) d += v * log(x.value) * y.derivative;
+        return Dual<T>(v, d);
+    }
+};
+
+template<class T, std::size_t N, std::integral U>
+struct math::impl::pow<VectorDual<T, N>, U>{
+    static constexpr auto func(const VectorDual<T, N>& x, U n) -> VectorDual<T, N> {
+        if(n == 0) return VectorDual<T, N>(T{1});
+        auto p = math::pow(x.value, n - 1);
+        return x.apply(p * x.value, T(n) * p);
+    }
+};
+
+template<class T, std::size_t N>
+struct math::impl::pow<VectorDual<T, N>, VectorDual<T, N>>{
+    static auto func(const VectorDual<T, N>& x, const VectorDual<T, N>& y) -> VectorDual<T, N> {
+        using std::log;
+        auto v = math::pow(x.value, y.value);
+        auto ret = x.apply(v, y.value * math::pow(x.value, y.value - T(1)));
+        // As for Dual, only lanes in which the exponent varies take the log
+        for(std::size_t k = 0; k < N; k++){
+            if(y.derivatives[k] != T{}) ret.derivatives[k] += v * log(x.value) * y.derivatives[k];
+        }
+        return ret;
+    }
+};
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "modular.hpp"
+#include "mpi.hpp"
+#include "poly_gcd.hpp"
+#include "sparse_poly.hpp"
+#include "upoly.hpp"
+
+// content * product of factors^multiplicity, the factors primitive with a
+// positive leading coefficient and the content carrying the sign
+template<class P>
+struct Factorization {
+    multiprecision::MPi content;
+    std::vector<std::pair<P, long>> factors;
+};
+
+namespace factor_impl{
+
+using multiprecision::MPi;
+using poly_gcd_impl::Dense;
+using poly_gcd_impl::trim;
+using poly_gcd_impl::multiply;
+using poly_gcd_impl::divide;
+using poly_gcd_impl::dense_gcd;
+using modular::add_mod;
+using modular::sub_mod;
+using modular::mul_mod;
+using modular::inverse_mod;
+
+// Primes are tried from here on, the one giving the fewest factors out of
+// factor_primes candidates is lifted
+constexpr std::uint64_t first_prime = std::uint64_t{1} << 15;
+constexpr int factor_primes = 5;
+
+/* ***********************************************
+    Square-free decomposition
+************************************************** */
+
+// The partial derivative in x_v
+inline auto derivative(const SparsePoly<MPi>& f, std::size_t v) -> SparsePoly<MPi> {
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(std::size_t i = 0; i < f.size(); i++){
+        auto e = f.exponents(i);
+        if(e[v] == 0) continue;
+        auto c = f.coefficient(i) * MPi(e[v]);
+        e[v]--;
+        terms.emplace_back(std::move(c), std::move(e));
+    }
+    return SparsePoly<MPi>::from_terms(f.layout(), std::move(terms));
+}
+
+// The gcd of the coefficients of f as a polynomial in x_v
+inline auto content(const SparsePoly<MPi>& f, std::size_t v) -> SparsePoly<MPi> {
+    std::vector<std::vector<std::pair<MPi, std::vector<long>>>> coefficients;
+    for(std::size_t i = 0; i < f.size(); i++){
+        auto e = f.exponents(i);
+        auto j = static_cast<std::size_t>(e[v]);
+        e[v] = 0;
+        if(coefficients.size() <= j) coefficients.resize(j + 1);
+        coefficients[j].emplace_back(f.coefficient(i), std::move(e));
+    }
+    auto ret = SparsePoly<MPi>(f.layout());
+    for(auto& terms : coefficients){
+        if(terms.empty()) continue;
+        ret = gcd(ret, SparsePoly<MPi>::from_terms(f.layout(), std::move(terms)));
+        if(ret.degree() == 0 && mpz_cmpabs_ui(ret.leading_coefficient().handle(), 1) == 0) break;
+    }
+    return ret;
+}
+
+// Yun's algorithm in the first variable f depends on, after splitting off
+// the content in that variable, which is decomposed in turn. f is
+// primitive with a positive leading coefficient.
+inline void square_free(const SparsePoly<MPi>& f, std::vector<std::pair<SparsePoly<MPi>, long>>& out) {
+    auto n = f.layout().variables();
+    auto v = n;
+    for(std::size_t k = 0; k < n && v == n; k++){
+        if(f.degree(k) > 0) v = k;
+    }
+    if(v == n) return;
+    auto c = content(f, v);
+    auto pp = *divide_exact(f, c);
+
+    auto b = pp, d = derivative(pp, v);
+    auto a = gcd(b, d);
+    b = *divide_exact(b, a);
+    auto w = *divide_exact(d, a) - derivative(b, v);
+    for(long i = 1; b.degree() > 0; i++){
+        a = gcd(b, w);
+        b = *divide_exact(b, a);
+        if(a.degree() > 0) out.emplace_back(a, i);
+        if(b.degree() > 0) w = *divide_exact(w, a) - derivative(b, v);
+    }
+    square_free(c, out);
+}
+
+/* ***********************************************
+    Factorization modulo a prime
+************************************************** */
+
+inline auto subtract(Dense a, const Dense& b, std::uint64_t p) -> Dense {
+    if(a.size() < b.size()) a.resize(b.size(), 0);
+    for(std::size_t i = 0; i < b.size(); i++) a[i] = sub_mod(a[i], b[i], p);
+    trim(a);
+    return a;
+}
+
+inline auto scale(Dense a, std::uint64_t c, std::uint64_t p) -> Dense {
+    for(auto& x : a) x = mul_mod(x, c, p);
+    trim(a);
+    return a;
+}
+
+inline auto remainder(const Dense& a, const Dense& b, std::uint64_t p) -> Dense {
+    return divide(a, b, p).second;
+}
+
+inline auto power_mod(Dense a, std::uint64_t e, const Dense& f, std::uint64_t p) -> Dense {
+    auto ret = Dense{1};
+    for(a = remainder(a, f, p); e != 0; e >>= 1){
+        if(e & 1) ret = remainder(multiply(ret, a, p), f, p);
+        a = remainder(multiply(a, a, p), f, p);
+    }
+    return ret;
+}
+
+// s a + t b = 1 for coprime a and b with deg s < deg b, deg t < deg a
+inline auto bezout(const Dense& a, const Dense& b, std::uint64_t p) -> std::pair<Dense, Dense> {
+    Dense r0 = a, r1 = b, s0{1}, s1, t0, t1{1};
+    while(not r1.empty()){
+        auto [q, r] = divide(r0, r1, p);
+        auto s = subtract(s0, multiply(q, s1, p), p);
+        auto t = subtract(t0, multiply(q, t1, p), p);
+        r0 = std::exchange(r1, std::move(r));
+        s0 = std::exchange(s1, std::move(s));
+        t0 = std::exchange(t1, std::move(t));
+    }
+    auto inv = inverse_mod(r0.front(), p);
+    return {scale(std::move(s0), inv, p), scale(std::move(t0), inv, p)};
+}
+
+// The rows x^(i p) mod f, the Frobenius map a -> a^p is linear modulo p
+struct Frobenius {
+    std::vector<Dense> rows;
+    std::uint64_t p;
+
+    Frobenius(const Dense& f, std::uint64_t _p)
+        : p{_p}
+    {
+        auto xp = power_mod(Dense{0, 1}, p, f, p);
+        rows.push_back(Dense{1});
+        for(std::size_t i = 2; i < f.size(); i++) rows.push_back(remainder(multiply(rows.back(), xp, p), f, p));
+    }
+
+    // a^p modulo f, for a of lower degree
+    auto operator()(const Dense& a) const -> Dense {
+        Dense ret;
+        for(std::size_t i = 0; i < a.size(); i++){
+            if(a[i] == 0) continue;
+            const auto& row = rows[i];
+            if(ret.size() < row.size()) ret.resize(row.size(), 0);
+            for(std::size_t j = 0; j < row.size(); j++) ret[j] = add_mod(ret[j], mul_mod(a[i], row[j], p), p);
+        }
+        trim(ret);
+        return ret;
+    }
+};
+
+// The products of all irreducible factors of each degree d of a monic,
+// square-free f: the gcd of f with x^(p^d) - x.
+inline auto distinct_degree(Dense f, const Frobenius& frobenius, std::uint64_t p) -> std::vector<std::pair<Dense, std::size_t>> {
+    std::vector<std::pair<Dense, std::size_t>> ret;
+    auto x = Dense{0, 1};
+    auto h = x;
+    for(std::size_t d = 1; 2 * d < f.size(); d++){
+        h = frobenius(h);
+        auto u = dense_gcd(f, subtract(remainder(h, f, p), x, p), p);
+        if(u.size() > 1){
+            f = divide(f, u, p).first;
+            ret.emplace_back(std::move(u), d);
+        }
+    }
+    if(f.size() > 1){
+        auto d = f.size() - 1;
+        ret.emplace_back(std::move(f), d);
+    }
+    return ret;
+}
+
+// Cantor and Zassenhaus: for random a, gcd(f, a^((p^d - 1) / 2) - 1)
+// splits a product of irreducibles of degree d about in half. The power is
+// the norm a a^p ... a^(p^(d-1)) raised to (p - 1) / 2.
+inline void equal_degree(const Dense& f, std::size_t d, const Frobenius& frobenius, std::uint64_t p, std::mt19937_64& rng, std::vector<Dense>& out) {
+    if(f.size() - 1 == d){
+        out.push_back(f);
+        return;
+    }
+    auto dist = std::uniform_int_distribution<std::uint64_t>(0, p - 1);
+    while(true){
+        Dense a(f.size() - 1);
+        for(auto& c : a) c = dist(rng);
+        trim(a);
+        if(a.size() <= 1) continue;
+        auto norm = a, b = a;
+        for(std::size_t i = 1; i < d; i++){
+            b = remainder(frobenius(b), f, p);
+            norm = remainder(multiply(norm, b, p), f, p);
+        }
+        auto w = power_mod(std::move(norm), (p - 1) / 2, f, p);
+        auto u = dense_gcd(f, subtract(std::move(w), Dense{1}, p), p);
+        if(u.size() <= 1 || u.size() == f.size()) continue;
+        equal_degree(u, d, frobenius, p, rng, out);
+        equal_degree(divide(f, u, p).first, d, frobenius, p, rng, out);
+        return;
+    }
+}
+
+inline auto reduce(const UPoly<MPi>& f, std::uint64_t p) -> Dense {
+    Dense ret;
+    for(const auto& c : f.coefficients()) ret.push_back(mpz_fdiv_ui(c.handle(), p));
+    trim(ret);
+    return ret;
+}
+
+inline auto monic(Dense f, std::uint64_t p) -> Dense {
+    return scale(std::move(f), inverse_mod(f.back(), p), p);
+}
+
+/* ***********************************************
+    Hensel lifting and recombination
+************************************************** */
+
+inline auto to_upoly(const Dense& a) -> UPoly<MPi> {
+    std::vector<MPi> c(a.size());
+    for(std::size_t i = 0; i < a.size(); i++) mpz_set_ui(c[i].handle(), a[i]);
+    return UPoly<MPi>(std::move(c));
+}
+
+// The coefficients in the symmetric range modulo m
+inline auto reduce(const UPoly<MPi>& f, const MPi& m) -> UPoly<MPi> {
+    auto half = MPi();
+    mpz_fdiv_q_2exp(half.handle(), m.handle(), 1);
+    std::vector<MPi> c(f.coefficients().begin(), f.coefficients().end());
+    for(auto& x : c){
+        mpz_fdiv_r(x.handle(), x.handle(), m.handle());
+        if(mpz_cmp(x.handle(), half.handle()) > 0) mpz_sub(x.handle(), x.handle(), m.handle());
+    }
+    return UPoly<MPi>(std::move(c));
+}
+
+// a = q b + r modulo m for a monic b, both in the symmetric range. Over Z
+// the quotient would grow with the degree.
+inline auto divide(const UPoly<MPi>& a, const UPoly<MPi>& b, const MPi& m) -> std::pair<UPoly<MPi>, UPoly<MPi>> {
+    if(a.degree() < b.degree()) return {UPoly<MPi>(), a};
+    std::vector<MPi> r(a.coefficients().begin(), a.coefficients().end());
+    std::vector<MPi> q(r.size() - b.size() + 1);
+    for(auto k = q.size(); k-- > 0;){
+        auto& top = r[k + b.size() - 1];
+        mpz_fdiv_r(top.handle(), top.handle(), m.handle());
+        q[k] = top;
+        for(std::size_t j = 0; j < b.size(); j++) mpz_submul(r[k + j].handle(), q[k].handle(), b[j].handle());
+    }
+    r.resize(b.size() - 1);
+    return {reduce(UPoly<MPi>(std::move(q)), m), reduce(UPoly<MPi>(std::move(r)), m)};
+}
+
+struct Lifting {
+    UPoly<MPi> g, h, s, t;
+};
+
+// From f = g h and s g + t h = 1 modulo m to the same modulo m^2, for a
+// monic h (von zur Gathen and Gerhard, algorithm 15.10)
+inline auto hensel_step(const UPoly<MPi>& f, const Lifting& x, const MPi& m) -> Lifting {
+    auto m2 = m * m;
+    auto one = UPoly<MPi>::constant(MPi(1));
+    auto e = reduce(f - x.g * x.h, m2);
+    auto [q, r] = divide(reduce(x.s * e, m2), x.h, m2);
+    auto g = reduce(x.g + x.t * e + q * x.g, m2);
+    auto h = reduce(x.h + r, m2);
+    auto b = reduce(x.s * g + x.t * h - one, m2);
+    auto [c, d] = divide(reduce(x.s * b, m2), h, m2);
+    auto s = reduce(x.s - d, m2);
+    auto t = reduce(x.t - x.t * b - c * g, m2);
+    return {std::move(g), std::move(h), std::move(s), std::move(t)};
+}
+
+// Lifts f = lc(f) u_1 ... u_r modulo p to modulo p^(2^steps), splitting the
+// factors in halves and lifting both products. The lifted factors are
+// monic.
+inline void hensel_lift(const UPoly<MPi>& f, std::span<const Dense> factors, std::uint64_t p, int steps, std::vector<UPoly<MPi>>& out) {
+    auto modulus = MPi();
+    mpz_ui_pow_ui(modulus.handle(), p, 1ul << steps);
+    if(factors.size() == 1){
+        auto inv = MPi();
+        mpz_invert(inv.handle(), f.leading_coefficient().handle(), modulus.handle());
+        out.push_back(reduce(f * inv, modulus));
+        return;
+    }
+    auto k = factors.size() / 2;
+    auto lc = mpz_fdiv_ui(f.leading_coefficient().handle(), p);
+    auto g = Dense{lc}, h = Dense{1};
+    for(std::size_t i = 0; i < k; i++) g = multiply(g, factors[i], p);
+    for(std::size_t i = k; i < factors.size(); i++) h = multiply(h, factors[i], p);
+    auto [s, t] = bezout(g, h, p);
+    auto x = Lifting{to_upoly(g), to_upoly(h), to_upoly(s), to_upoly(t)};
+    auto m = MPi();
+    mpz_set_ui(m.handle(), p);
+    for(int i = 0; i < steps; i++){
+        x = hensel_step(f, x, m);
+        m = m * m;
+    }
+    hensel_lift(x.g, factors.first(k), p, steps, out);
+    hensel_lift(x.h, factors.subspan(k), p, steps, out);
+}
+
+// Zassenhaus: the factors over Z are lc(f) times products of subsets of the
+// monic lifted factors, brought into the symmetric range. Subsets are tried
+// by increasing size, a candidate's constant term has to divide lc(f) f(0)
+// before the whole product is formed and divided. f(0) != 0.
+inline auto recombine(UPoly<MPi> f, std::vector<UPoly<MPi>> lifted, const MPi& modulus) -> std::vector<UPoly<MPi>> {
+    std::vector<UPoly<MPi>> ret;
+    auto half = MPi();
+    mpz_fdiv_q_2exp(half.handle(), modulus.handle(), 1);
+    auto symmetric = [&](MPi& x){
+        mpz_fdiv_r(x.handle(), x.handle(), modulus.handle());
+        if(mpz_cmp(x.handle(), half.handle()) > 0) mpz_sub(x.handle(), x.handle(), modulus.handle());
+    };
+    for(std::size_t s = 1; 2 * s <= lifted.size(); s++){
+        std::vector<std::size_t> subset(s);
+        std::iota(subset.begin(), subset.end(), std::size_t{0});
+        while(true){
+            auto lc = f.leading_coefficient();
+            auto trailing = lc * f[0];
+            auto c = lc;
+            for(auto i : subset) c = c * lifted[i][0];
+            symmetric(c);
+            auto found = false;
+            if(mpz_sgn(c.handle()) != 0 && mpz_divisible_p(trailing.handle(), c.handle())){
+                auto candidate = UPoly<MPi>::constant(lc);
+                for(auto i : subset) candidate = reduce(candidate * lifted[i], modulus);
+                auto content = MPi(0);
+                for(const auto& x : candidate.coefficients()) mpz_gcd(content.handle(), content.handle(), x.handle());
+                std::vector<MPi> primitive(candidate.coefficients().begin(), candidate.coefficients().end());
+                for(auto& x : primitive) mpz_divexact(x.handle(), x.handle(), content.handle());
+                candidate = UPoly<MPi>(std::move(primitive));
+                if(auto q = divide_exact(f, candidate)){
+                    if(candidate.leading_coefficient() < 0){
+                        candidate = -candidate;
+                        *q = -*q;
+                    }
+                    ret.push_back(std::move(candidate));
+                    f = std::move(*q);
+                    for(auto k = subset.size(); k-- > 0;) lifted.erase(lifted.begin() + static_cast<std::ptrdiff_t>(subset[k]));
+                    found = true;
+                }
+            }
+            if(found){
+                if(lifted.size() < s) break;
+                std::iota(subset.begin(), subset.end(), std::size_t{0});
+                continue;
+            }
+            // The next subset in lexicographic order
+            auto k = s;
+            while(k > 0 && subset[k - 1] == lifted.size() - s + k - 1) k--;
+            if(k == 0) break;
+            subset[k - 1]++;
+            for(auto j = k; j < s; j++) subset[j] = subset[j - 1] + 1;
+        }
+    }
+    if(f.degree() > 0) ret.push_back(std::move(f));
+    return ret;
+}
+
+// The irreducible factors of a square-free, primitive f of degree at least
+// two with a positive leading coefficient and f(0) != 0
+inline auto factor_square_free(const UPoly<MPi>& f) -> std::vector<UPoly<MPi>> {
+    auto n = static_cast<std::size_t>(f.degree());
+    auto rng = std::mt19937_64(0);
+    // The degrees a factor over Z may have, known from every prime
+    std::vector<char> possible(n + 1, 1);
+    auto best = std::uint64_t{0};
+    auto best_count = n + 1;
+    auto best_split = std::vector<std::pair<Dense, std::size_t>>();
+    auto p = first_prime;
+    for(int tried = 0; tried < factor_primes; p++){
+        if(not modular::is_prime(p) || mpz_fdiv_ui(f.leading_coefficient().handle(), p) == 0) continue;
+        auto fp = monic(reduce(f, p), p);
+        Dense derivative;
+        for(std::size_t i = 1; i < fp.size(); i++) derivative.push_back(mul_mod(fp[i], i % p, p));
+        trim(derivative);
+        if(dense_gcd(fp, derivative, p).size() != 1) continue;
+        tried++;
+
+        auto split = distinct_degree(fp, Frobenius(fp, p), p);
+        std::vector<char> sums(n + 1, 0);
+        sums[0] = 1;
+        std::size_t count = 0;
+        for(const auto& [u, d] : split){
+            for(auto k = (u.size() - 1) / d; k > 0; k--, count++){
+                for(auto j = n; j >= d; j--) sums[j] |= sums[j - d];
+            }
+        }
+        for(std::size_t j = 0; j <= n; j++) possible[j] &= sums[j];
+        if(std::count(possible.begin() + 1, possible.end() - 1, 1) == 0) return {f};
+        if(count < best_count){
+            best = p;
+            best_count = count;
+            best_split = std::move(split);
+        }
+    }
+    if(best_count == 1) return {f};
+
+    p = best;
+    auto fp = monic(reduce(f, p), p);
+    auto frobenius = Frobenius(fp, p);
+    std::vector<Dense> factors;
+    for(const auto& [u, d] : best_split) equal_degree(u, d, frobenius, p, rng, factors);
+
+    // Mignotte: a factor of f has coefficients below 2^n |f|_2, times lc(f)
+    // for the candidates, and the modulus has to exceed twice that
+    auto norm = MPi(0);
+    for(const auto& c : f.coefficients()) mpz_addmul(norm.handle(), c.handle(), c.handle());
+    auto bits = n + mpz_sizeinbase(norm.handle(), 2) / 2 + 1 + mpz_sizeinbase(f.leading_coefficient().handle(), 2) + 2;
+    auto prime_bits = static_cast<std::size_t>(std::bit_width(p)) - 1;
+    int steps = 0;
+    while((prime_bits << steps) < bits) steps++;
+
+    std::vector<UPoly<MPi>> lifted;
+    hensel_lift(f, factors, p, steps, lifted);
+    auto modulus = MPi();
+    mpz_ui_pow_ui(modulus.handle(), p, 1ul << steps);
+    return recombine(f, std::move(lifted), modulus);
+}
+
+inline auto to_sparse(const UPoly<MPi>& f) -> SparsePoly<MPi> {
+    auto layout = MonomialLayout(1, MonomialOrder::Lex, f.degree() < (1l << 15) ? 16u : 32u);
+    auto ret = SparsePoly<MPi>(layout);
+    std::vector<std::uint64_t> m(layout.words());
+    for(auto k = f.size(); k-- > 0;){
+        if(mpz_sgn(f[k].handle()) == 0) continue;
+        std::vector<long> e{static_cast<long>(k)};
+        layout.pack(e, m.data());
+        ret.push_back(f[k], m.data());
+    }
+    return ret;
+}
+
+inline auto to_upoly(const SparsePoly<MPi>& f) -> UPoly<MPi> {
+    std::vector<MPi> c(static_cast<std::size_t>(f.degree() + 1));
+    for(std::size_t i = 0; i < f.size(); i++) c[static_cast<std::size_t>(f.exponents(i)[0])] = f.coefficient(i);
+    return UPoly<MPi>(std::move(c));
+}
+
+} // namespace factor_impl
+
+// f = content * a_1 a_2^2 a_3^3 ... with square-free, pairwise coprime a_i,
+// by Yun's algorithm variable by variable. Empty multiplicities are left
+// out.
+inline auto square_free(const SparsePoly<multiprecision::MPi>& f) -> Factorization<SparsePoly<multiprecision::MPi>> {
+    using multiprecision::MPi;
+    auto ret = Factorization<SparsePoly<MPi>>{poly_gcd_impl::content(f), {}};
+    if(f.is_zero()) return ret;
+    if(f.leading_coefficient() < 0) ret.content = -ret.content;
+    std::vector<std::pair<SparsePoly<MPi>, long>> parts;
+    factor_impl::square_free(poly_gcd_impl::divide_coefficients(f, ret.content), parts);
+    // The parts of the contents come separately, they are merged by
+    // multiplicity
+    std::ranges::stable_sort(parts, {}, [](const auto& part){ return part.second; });
+    for(auto& [a, i] : parts){
+        if(not ret.factors.empty() && ret.factors.back().second == i) ret.factors.back().first *= a;
+        else ret.factors.emplace_back(std::move(a), i);
+    }
+    return ret;
+}
+
+// The factorization into irreducible polynomials over Z: square-free parts
+// are factored modulo a prime by distinct and equal degree factorization,
+// lifted by Hensel's lemma and recombined as by Zassenhaus. The degrees
+// possible modulo several primes often prove irreducibility early. Factors
+// are ordered by degree.
+inline auto factor(const UPoly<multiprecision::MPi>& f) -> Factorization<UPoly<multiprecision::MPi>> {
+    using multiprecision::MPi;
+    using namespace factor_impl;
+    auto ret = Factorization<UPoly<MPi>>{MPi(0), {}};
+    for(const auto& c : f.coefficients()) mpz_gcd(ret.content.handle(), ret.content.handle(), c.handle());
+    if(f.is_zero()) return ret;
+    if(f.leading_coefficient() < 0) ret.content = -ret.content;
+
+    std::size_t low = 0;
+    while(mpz_sgn(f[low].handle()) == 0) low++;
+    if(low > 0) ret.factors.emplace_back(UPoly<MPi>::monomial(MPi(1), 1), static_cast<long>(low));
+    std::vector<MPi> c(f.coefficients().begin() + static_cast<std::ptrdiff_t>(low), f.coefficients().end());
+    for(auto& x : c) mpz_divexact(x.handle(), x.handle(), ret.content.handle());
+
+    auto parts = square_free(to_sparse(UPoly<MPi>(std::move(c))));
+    for(auto& [a, i] : parts.factors){
+        auto g = to_upoly(a);
+        if(g.degree() == 1){
+            ret.factors.emplace_back(std::move(g), i);
+            continue;
+        }
+        for(auto& h : factor_square_free(g)) ret.factors.emplace_back(std::move(h), i);
+    }
+    std::ranges::stable_sort(ret.factors, {}, [](const auto& factor){ return factor.first.degree(); });
+    return ret;
+}
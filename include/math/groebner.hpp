@@ -0,0 +1,811 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "modular.hpp"
+#include "mpi.hpp"
+#include "rational.hpp"
+#include "sparse_poly.hpp"
+
+struct GroebnerOptions {
+    // 0 selects std::thread::hardware_concurrency()
+    unsigned threads = 0;
+    // Number of matrix rows each thread has to be given at least
+    std::size_t rows_per_thread = 32;
+};
+
+namespace groebner_impl{
+
+using multiprecision::MPi;
+using Rational = FieldOfFractions<MPi>;
+using modular::add_mod;
+using modular::sub_mod;
+using modular::mul_mod;
+using modular::inverse_mod;
+using modular::Montgomery;
+
+// A polynomial over Z_p with coefficients in Montgomery form and terms in
+// decreasing order, monic once it is part of a basis
+struct ModPoly {
+    std::vector<std::uint64_t> coefficients;
+    std::vector<std::uint64_t> monomials;
+
+    auto size() const { return coefficients.size(); }
+};
+
+// Monomials numbered in the order they are first seen, each one once
+class MonomialTable {
+public:
+    explicit MonomialTable(const MonomialLayout& _layout)
+        : m_layout{_layout}, m_scratch(_layout.words()), m_ids(64, Hash{this}, Equal{this})
+    {}
+
+    MonomialTable(const MonomialTable&) = delete;
+    auto operator=(const MonomialTable&) -> MonomialTable& = delete;
+
+    auto size() const -> std::uint32_t { return m_size; }
+    auto operator[](std::uint32_t id) const -> const std::uint64_t* { return m_pool.data() + id * m_layout.words(); }
+
+    // The number of a * b
+    auto product(const std::uint64_t* a, const std::uint64_t* b) -> std::uint32_t {
+        if(not m_layout.multiply(a, b, m_scratch.data())){
+            throw std::runtime_error(fmt::format("Degree exceeds the {} bit exponent fields", m_layout.bits()));
+        }
+        m_pool.insert(m_pool.end(), m_scratch.begin(), m_scratch.end());
+        auto [it, inserted] = m_ids.insert(m_size);
+        if(inserted) return m_size++;
+        m_pool.resize(m_size * m_layout.words());
+        return *it;
+    }
+
+private:
+    struct Hash {
+        const MonomialTable* table;
+        auto operator()(std::uint32_t id) const -> std::size_t {
+            auto m = (*table)[id];
+            std::uint64_t h = 0;
+            for(std::size_t k = 0; k < table->m_layout.words(); k++) h = (h ^ m[k]) * 0x9e3779b97f4a7c15;
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    struct Equal {
+        const MonomialTable* table;
+        auto operator()(std::uint32_t a, std::uint32_t b) const -> bool {
+            return table->m_layout.equal((*table)[a], (*table)[b]);
+        }
+    };
+
+    const MonomialLayout& m_layout;
+    std::vector<std::uint64_t> m_pool;
+    std::vector<std::uint64_t> m_scratch;
+    std::uint32_t m_size = 0;
+    std::unordered_set<std::uint32_t, Hash, Equal> m_ids;
+};
+
+// A critical pair of basis elements i < j. Pairs are selected by degree,
+// the degree of their lcm in degree orders and its sugar otherwise.
+struct Pair {
+    std::uint32_t i;
+    std::uint32_t j;
+    std::vector<long> lcm;
+    long degree;
+};
+
+// A row t * g of a matrix, its columns increase as the terms decrease
+struct Row {
+    std::vector<std::uint32_t> columns;
+    std::span<const std::uint64_t> values;
+};
+
+using RowView = std::pair<std::span<const std::uint32_t>, std::span<const std::uint64_t>>;
+
+// A row owning its values
+struct Reduced {
+    std::vector<std::uint32_t> columns;
+    std::vector<std::uint64_t> values;
+};
+
+// Faugère's F4 over Z_p. The critical pairs of lowest degree are reduced
+// together: the products t * g making up their S-polynomials are rows of a
+// sparse matrix, symbolic preprocessing adds a multiple of a basis element
+// for every monomial a leading monomial divides, and the rows that are no
+// such reducers are reduced by them and then brought to echelon form among
+// themselves. The rows with new leading monomials join the basis. Pairs are
+// pruned by the criteria of Gebauer and Möller.
+//
+// In lex the degree of an lcm says little about the work of a pair, and
+// selecting by it lets the matrices grow without bound. There every element
+// carries a sugar, the total degree of an input and the degree of the pairs
+// it came from otherwise, and pairs are selected by the largest sugar of
+// their two products t * g.
+//
+// Every row is reduced by the reducers on its own, this is spread over
+// threads. The result does not depend on their number.
+class Engine {
+public:
+    Engine(const MonomialLayout& _layout, const Montgomery& _mont, unsigned _threads, std::size_t _rows_per_thread)
+        : m_layout{_layout}, m_mont{_mont}, m_threads{_threads}, m_rows_per_thread{_rows_per_thread}
+    {}
+
+    // The reduced basis by decreasing leading monomials
+    auto run(std::vector<ModPoly> input) -> std::vector<ModPoly> {
+        for(auto& f : input){
+            if(f.size() == 0) continue;
+            long sugar = 0;
+            for(std::size_t k = 0; k < f.size(); k++) sugar = std::max(sugar, m_layout.degree(f.monomials.data() + k * m_layout.words()));
+            update(monic(std::move(f)), sugar);
+        }
+        while(not m_pairs.empty()){
+            auto [selected, degree] = select();
+            std::vector<std::pair<std::vector<std::uint64_t>, std::uint32_t>> products;
+            for(const auto& pair : selected){
+                std::vector<std::uint64_t> lcm(m_layout.words());
+                m_layout.pack(pair.lcm, lcm.data());
+                for(auto g : {pair.i, pair.j}){
+                    std::vector<std::uint64_t> t(m_layout.words());
+                    m_layout.divide(lcm.data(), lead(g), t.data());
+                    products.emplace_back(std::move(t), g);
+                }
+            }
+            for(auto& h : reduce(products, false)) update(std::move(h), degree);
+        }
+        return interreduce();
+    }
+
+    // The normal forms of monomials by the basis run has computed
+    auto normal_forms(const std::vector<std::vector<std::uint64_t>>& monomials) const -> std::vector<ModPoly> {
+        std::vector<ModPoly> ret(monomials.size());
+        std::vector<std::size_t> reducible;
+        std::vector<std::pair<std::vector<std::uint64_t>, std::uint32_t>> products;
+        for(std::size_t k = 0; k < monomials.size(); k++){
+            const auto& m = monomials[k];
+            auto g = divisor(m.data());
+            if(not g){
+                ret[k] = ModPoly{{m_mont.to(1)}, m};
+                continue;
+            }
+            std::vector<std::uint64_t> t(m_layout.words());
+            m_layout.divide(m.data(), lead(*g), t.data());
+            products.emplace_back(std::move(t), *g);
+            reducible.push_back(k);
+        }
+        // m = t * lm(g) is congruent to m - t * g, so its normal form is
+        // minus the reduced tail of the row t * g
+        auto rows = reduce(products, true);
+        for(std::size_t r = 0; r < rows.size(); r++){
+            auto& f = ret[reducible[r]];
+            f.coefficients.assign(rows[r].coefficients.begin() + 1, rows[r].coefficients.end());
+            f.monomials.assign(rows[r].monomials.begin() + static_cast<long>(m_layout.words()), rows[r].monomials.end());
+            for(auto& c : f.coefficients) c = sub_mod(0, c, m_mont.p);
+        }
+        return ret;
+    }
+
+private:
+    auto lead(std::uint32_t g) const -> const std::uint64_t* { return m_basis[g].monomials.data(); }
+
+    auto monic(ModPoly f) const -> ModPoly {
+        auto inv = m_mont.pow(f.coefficients.front(), m_mont.p - 2);
+        for(auto& c : f.coefficients) c = m_mont.mul(c, inv);
+        return f;
+    }
+
+    static auto divides(const std::vector<long>& a, const std::vector<long>& b) -> bool {
+        for(std::size_t k = 0; k < a.size(); k++){
+            if(a[k] > b[k]) return false;
+        }
+        return true;
+    }
+
+    auto make_pair(std::uint32_t i, std::uint32_t j) const -> Pair {
+        auto ret = Pair{i, j, m_leads[i], 0};
+        for(std::size_t k = 0; k < ret.lcm.size(); k++){
+            ret.lcm[k] = std::max(ret.lcm[k], m_leads[j][k]);
+            ret.degree += ret.lcm[k];
+        }
+        if(m_layout.order() == MonomialOrder::Lex){
+            auto lcm_degree = ret.degree;
+            ret.degree = std::max(m_sugar[i] + lcm_degree - m_lead_degrees[i], m_sugar[j] + lcm_degree - m_lead_degrees[j]);
+        }
+        return ret;
+    }
+
+    auto coprime(const Pair& pair) const -> bool {
+        for(std::size_t k = 0; k < pair.lcm.size(); k++){
+            if(m_leads[pair.i][k] != 0 && m_leads[pair.j][k] != 0) return false;
+        }
+        return true;
+    }
+
+    // Adds h to the basis. Of the new pairs, one with a coprime lcm reduces
+    // to zero, as does one whose lcm another new pair's lcm divides. An old
+    // pair whose lcm lm(h) strictly divides also does, by way of the two
+    // new pairs with its elements. Elements whose leading monomial lm(h)
+    // divides are redundant from here on.
+    void update(ModPoly h, long sugar) {
+        auto t = static_cast<std::uint32_t>(m_basis.size());
+        m_leads.push_back(m_layout.unpack(h.monomials.data()));
+        m_lead_degrees.push_back(m_layout.degree(h.monomials.data()));
+        m_sugar.push_back(sugar);
+        m_basis.push_back(std::move(h));
+        m_redundant.push_back(false);
+
+        std::vector<Pair> candidates;
+        for(std::uint32_t i = 0; i < t; i++){
+            if(not m_redundant[i]) candidates.push_back(make_pair(i, t));
+        }
+        std::vector<Pair> kept;
+        for(std::size_t a = 0; a < candidates.size(); a++){
+            auto divided = [&](const Pair& b){ return divides(b.lcm, candidates[a].lcm); };
+            if(coprime(candidates[a]) || (std::none_of(candidates.begin() + static_cast<long>(a) + 1, candidates.end(), divided) && std::ranges::none_of(kept, divided))){
+                kept.push_back(std::move(candidates[a]));
+            }
+        }
+
+        std::erase_if(m_pairs, [&](const Pair& p){
+            return divides(m_leads[t], p.lcm) && make_pair(p.i, t).lcm != p.lcm && make_pair(p.j, t).lcm != p.lcm;
+        });
+        for(auto& p : kept){
+            if(not coprime(p)) m_pairs.push_back(std::move(p));
+        }
+        for(std::uint32_t i = 0; i < t; i++){
+            if(divides(m_leads[t], m_leads[i])) m_redundant[i] = true;
+        }
+    }
+
+    // The pairs of lowest degree and that degree, the normal strategy, or
+    // the sugar strategy in lex
+    auto select() -> std::pair<std::vector<Pair>, long> {
+        auto degree = std::ranges::min_element(m_pairs, {}, &Pair::degree)->degree;
+        std::vector<Pair> ret;
+        for(auto& p : m_pairs){
+            if(p.degree == degree) ret.push_back(std::move(p));
+        }
+        std::erase_if(m_pairs, [&](const Pair& p){ return p.degree == degree; });
+        return {std::move(ret), degree};
+    }
+
+    // The basis element whose leading monomial divides m with the fewest
+    // terms
+    auto divisor(const std::uint64_t* m) const -> std::optional<std::uint32_t> {
+        std::optional<std::uint32_t> ret;
+        for(std::uint32_t g = 0; g < m_basis.size(); g++){
+            if(m_redundant[g] || not m_layout.divides(lead(g), m)) continue;
+            if(not ret || m_basis[g].size() < m_basis[*ret].size()) ret = g;
+        }
+        return ret;
+    }
+
+    // The rows t * g of the products reduced. Without tails the first row
+    // of every leading monomial is a reducer, the others are reduced and
+    // then echelonized, and the rows with new leading terms are returned
+    // monic. With tails all of them are returned in order with only the
+    // terms below the leading one reduced.
+    auto reduce(const std::vector<std::pair<std::vector<std::uint64_t>, std::uint32_t>>& products, bool tails) const -> std::vector<ModPoly> {
+        auto w = m_layout.words();
+        auto table = MonomialTable(m_layout);
+        std::vector<Row> reducers, rows;
+        std::vector<std::int64_t> reducer_of;
+        auto product_row = [&](const std::uint64_t* t, std::uint32_t g){
+            const auto& f = m_basis[g];
+            auto ret = Row{{}, f.coefficients};
+            for(std::size_t k = 0; k < f.size(); k++) ret.columns.push_back(table.product(t, f.monomials.data() + k * w));
+            reducer_of.resize(table.size(), -1);
+            return ret;
+        };
+        for(const auto& [t, g] : products){
+            auto r = product_row(t.data(), g);
+            if(not tails && reducer_of[r.columns.front()] < 0){
+                reducer_of[r.columns.front()] = static_cast<std::int64_t>(reducers.size());
+                reducers.push_back(std::move(r));
+            }else{
+                rows.push_back(std::move(r));
+            }
+        }
+
+        // Symbolic preprocessing, the table grows as reducers are added
+        std::vector<std::uint64_t> t(w);
+        for(std::uint32_t id = 0; id < table.size(); id++){
+            if(reducer_of[id] >= 0) continue;
+            auto g = divisor(table[id]);
+            if(not g) continue;
+            m_layout.divide(table[id], lead(*g), t.data());
+            auto r = product_row(t.data(), *g);
+            reducer_of[id] = static_cast<std::int64_t>(reducers.size());
+            reducers.push_back(std::move(r));
+        }
+
+        // Columns by decreasing monomials
+        auto n = table.size();
+        std::vector<std::uint32_t> ids(n);
+        for(std::uint32_t id = 0; id < n; id++) ids[id] = id;
+        std::ranges::sort(ids, [&](std::uint32_t a, std::uint32_t b){ return m_layout.compare(table[a], table[b]) > 0; });
+        std::vector<std::uint32_t> column(n);
+        for(std::uint32_t c = 0; c < n; c++) column[ids[c]] = c;
+        std::vector<std::int64_t> pivot(n, -1);
+        for(auto& r : reducers){
+            for(auto& c : r.columns) c = column[c];
+        }
+        for(std::uint32_t id = 0; id < n; id++){
+            if(reducer_of[id] >= 0) pivot[column[id]] = reducer_of[id];
+        }
+        for(auto& r : rows){
+            for(auto& c : r.columns) c = column[c];
+        }
+
+        // Scatters a row into dense, which is left zero, and eliminates the
+        // columns from start on that have a pivot row
+        auto sweep = [&](std::span<const std::uint32_t> columns, std::span<const std::uint64_t> values, std::vector<std::uint64_t>& dense, std::uint32_t start, const auto& pivot_row){
+            for(std::size_t k = 0; k < columns.size(); k++) dense[columns[k]] = values[k];
+            auto ret = Reduced{};
+            for(auto c = columns.front(); c < n; c++){
+                auto v = dense[c];
+                if(v == 0) continue;
+                dense[c] = 0;
+                auto r = c >= start ? pivot_row(c) : RowView{};
+                if(r.first.empty()){
+                    ret.columns.push_back(c);
+                    ret.values.push_back(v);
+                    continue;
+                }
+                for(std::size_t k = 1; k < r.first.size(); k++){
+                    auto& d = dense[r.first[k]];
+                    d = sub_mod(d, m_mont.mul(v, r.second[k]), m_mont.p);
+                }
+            }
+            return ret;
+        };
+        auto reducer_row = [&](std::uint32_t c){
+            auto r = pivot[c];
+            if(r < 0) return RowView{};
+            const auto& row = reducers[static_cast<std::size_t>(r)];
+            return RowView{row.columns, row.values};
+        };
+
+        std::vector<Reduced> reduced(rows.size());
+        auto threads = m_threads != 0 ? m_threads : std::max(std::thread::hardware_concurrency(), 1u);
+        threads = static_cast<unsigned>(std::clamp<std::size_t>(rows.size() / std::max<std::size_t>(m_rows_per_thread, 1), 1, threads));
+        std::atomic<std::size_t> next_row = 0;
+        auto worker = [&]{
+            std::vector<std::uint64_t> dense(n, 0);
+            for(auto i = next_row++; i < rows.size(); i = next_row++){
+                const auto& r = rows[i];
+                reduced[i] = sweep(r.columns, r.values, dense, tails ? r.columns.front() + 1 : r.columns.front(), reducer_row);
+            }
+        };
+        std::vector<std::jthread> pool;
+        for(unsigned k = 1; k < threads; k++){
+            pool.emplace_back(worker);
+        }
+        worker();
+        pool.clear();
+
+        auto to_poly = [&](Reduced& r){
+            auto ret = ModPoly{std::move(r.values), {}};
+            ret.monomials.reserve(r.columns.size() * w);
+            for(auto c : r.columns) ret.monomials.insert(ret.monomials.end(), table[ids[c]], table[ids[c]] + w);
+            return ret;
+        };
+        std::vector<ModPoly> ret;
+        if(tails){
+            for(auto& r : reduced) ret.push_back(to_poly(r));
+            return ret;
+        }
+
+        // The rows with new leading terms, each reduced by the earlier ones
+        std::vector<Reduced> echelon;
+        std::vector<std::int64_t> fresh(n, -1);
+        auto fresh_row = [&](std::uint32_t c){
+            auto r = fresh[c];
+            if(r < 0) return RowView{};
+            const auto& row = echelon[static_cast<std::size_t>(r)];
+            return RowView{row.columns, row.values};
+        };
+        std::vector<std::uint64_t> dense(n, 0);
+        for(auto& r : reduced){
+            if(r.columns.empty()) continue;
+            auto e = sweep(r.columns, r.values, dense, 0, fresh_row);
+            if(e.columns.empty()) continue;
+            auto inv = m_mont.pow(e.values.front(), m_mont.p - 2);
+            for(auto& v : e.values) v = m_mont.mul(v, inv);
+            fresh[e.columns.front()] = static_cast<std::int64_t>(echelon.size());
+            echelon.push_back(std::move(e));
+        }
+        for(auto& r : echelon) ret.push_back(to_poly(r));
+        return ret;
+    }
+
+    // The minimal basis with every tail reduced. Inputs are not reduced
+    // when they join the basis, an earlier one's leading monomial may
+    // divide theirs.
+    auto interreduce() -> std::vector<ModPoly> {
+        for(std::uint32_t g = 0; g < m_basis.size(); g++){
+            for(std::uint32_t h = 0; h < m_basis.size() && not m_redundant[g]; h++){
+                if(h != g && not m_redundant[h] && divides(m_leads[h], m_leads[g])) m_redundant[g] = true;
+            }
+        }
+        std::vector<std::pair<std::vector<std::uint64_t>, std::uint32_t>> products;
+        for(std::uint32_t g = 0; g < m_basis.size(); g++){
+            if(not m_redundant[g]) products.emplace_back(std::vector<std::uint64_t>(m_layout.words(), 0), g);
+        }
+        auto ret = reduce(products, true);
+        std::ranges::sort(ret, [&](const ModPoly& a, const ModPoly& b){
+            return m_layout.compare(a.monomials.data(), b.monomials.data()) > 0;
+        });
+        return ret;
+    }
+
+    const MonomialLayout& m_layout;
+    Montgomery m_mont;
+    unsigned m_threads;
+    std::size_t m_rows_per_thread;
+    std::vector<ModPoly> m_basis;
+    std::vector<std::vector<long>> m_leads;
+    std::vector<long> m_lead_degrees;
+    std::vector<long> m_sugar;
+    std::vector<bool> m_redundant;
+    std::vector<Pair> m_pairs;
+};
+
+// The reduced basis in the order of target of a zero-dimensional ideal, from
+// its reduced basis in another order computed by engine, by the algorithm of
+// Faugère, Gianni, Lazard and Mora. The quotient ring has as a basis the D
+// standard monomials of the given basis, the monomials no leading monomial
+// divides, and the normal forms of their products with the variables give
+// the matrices of multiplication by a variable. Monomials are then visited
+// in increasing target order, each one a variable times one visited before,
+// and their normal forms, found by a matrix product, are brought to echelon
+// form. The first monomials whose normal form depends on those before are
+// the new leading monomials, the dependencies the new basis. It takes
+// O(n D^3) operations against a lex run of F4 that can grow without bound.
+// Nothing if the ideal is not zero-dimensional.
+inline auto fglm(const Engine& engine, const std::vector<ModPoly>& basis, const MonomialLayout& source, const MonomialLayout& target, const Montgomery& mont) -> std::optional<std::vector<ModPoly>> {
+    auto n = source.variables();
+    std::vector<std::vector<long>> leads;
+    for(const auto& g : basis) leads.push_back(source.unpack(g.monomials.data()));
+    auto divides = [](const std::vector<long>& a, const std::vector<long>& b){
+        for(std::size_t k = 0; k < a.size(); k++){
+            if(a[k] > b[k]) return false;
+        }
+        return true;
+    };
+    // Finitely many standard monomials iff every variable has a pure power
+    // among the leading monomials, 1 counting as one of every variable
+    for(std::size_t k = 0; k < n; k++){
+        auto pure = [&](const std::vector<long>& e){
+            for(std::size_t l = 0; l < n; l++){
+                if(l != k && e[l] > 0) return false;
+            }
+            return true;
+        };
+        if(std::ranges::none_of(leads, pure)) return std::nullopt;
+    }
+    auto standard = [&](const std::vector<long>& e){
+        return std::ranges::none_of(leads, [&](const auto& l){ return divides(l, e); });
+    };
+
+    // The standard monomials, closed under division
+    std::map<std::vector<long>, std::uint32_t> index;
+    std::vector<std::vector<long>> monomials;
+    if(standard(std::vector<long>(n, 0))){
+        index.emplace(std::vector<long>(n, 0), 0);
+        monomials.emplace_back(n, 0);
+    }
+    for(std::size_t s = 0; s < monomials.size(); s++){
+        for(std::size_t k = 0; k < n; k++){
+            auto e = monomials[s];
+            e[k]++;
+            if(standard(e) && index.emplace(e, static_cast<std::uint32_t>(monomials.size())).second) monomials.push_back(std::move(e));
+        }
+    }
+    auto d = monomials.size();
+
+    // mult[k][s] is the normal form of x_k times standard monomial s, sparse
+    // in the standard monomials
+    using Sparse = std::vector<std::pair<std::uint32_t, std::uint64_t>>;
+    std::vector<std::vector<Sparse>> mult(n, std::vector<Sparse>(d));
+    std::vector<std::vector<std::uint64_t>> border;
+    std::vector<std::pair<std::size_t, std::size_t>> border_of;
+    for(std::size_t s = 0; s < d; s++){
+        for(std::size_t k = 0; k < n; k++){
+            auto e = monomials[s];
+            e[k]++;
+            if(auto it = index.find(e); it != index.end()){
+                mult[k][s].emplace_back(it->second, mont.to(1));
+                continue;
+            }
+            border.emplace_back(source.words());
+            source.pack(e, border.back().data());
+            border_of.emplace_back(k, s);
+        }
+    }
+    auto forms = engine.normal_forms(border);
+    for(std::size_t b = 0; b < forms.size(); b++){
+        auto [k, s] = border_of[b];
+        for(std::size_t i = 0; i < forms[b].size(); i++){
+            auto e = source.unpack(forms[b].monomials.data() + i * source.words());
+            mult[k][s].emplace_back(index.at(e), forms[b].coefficients[i]);
+        }
+    }
+
+    // Candidates by increasing target order, with the visited monomial and
+    // variable they are the product of, variable n for 1
+    struct Candidate {
+        std::vector<long> exponents;
+        std::size_t parent;
+        std::size_t variable;
+    };
+    auto less = [&](const std::vector<std::uint64_t>& a, const std::vector<std::uint64_t>& b){ return target.compare(a.data(), b.data()) < 0; };
+    std::map<std::vector<std::uint64_t>, Candidate, decltype(less)> candidates(less);
+    std::vector<std::uint64_t> one(target.words());
+    target.pack(std::vector<long>(n, 0), one.data());
+    candidates.emplace(one, Candidate{std::vector<long>(n, 0), 0, n});
+
+    // The visited monomials independent of those before and their normal
+    // forms, dense in the standard monomials. Row r of the echelon form is
+    // the combination combination[r] of their normal forms, monic with
+    // pivot[r] its first column.
+    std::vector<std::vector<long>> independent;
+    std::vector<std::vector<std::uint64_t>> forms_of, echelon, combination;
+    std::vector<std::int64_t> row_of(d, -1);
+    std::vector<std::vector<long>> new_leads;
+    std::vector<ModPoly> ret;
+    auto pack = [&](const std::vector<long>& e){
+        std::vector<std::uint64_t> m(target.words());
+        target.pack(e, m.data());
+        return m;
+    };
+    while(not candidates.empty()){
+        auto node = candidates.extract(candidates.begin());
+        auto& c = node.mapped();
+        if(std::ranges::any_of(new_leads, [&](const auto& l){ return divides(l, c.exponents); })) continue;
+
+        std::vector<std::uint64_t> v(d, 0);
+        if(c.variable == n){
+            if(d > 0) v[0] = mont.to(1);
+        }else{
+            const auto& parent = forms_of[c.parent];
+            for(std::size_t s = 0; s < d; s++){
+                if(parent[s] == 0) continue;
+                for(auto [t, x] : mult[c.variable][s]) v[t] = add_mod(v[t], mont.mul(parent[s], x), mont.p);
+            }
+        }
+        auto form = v;
+        std::vector<std::uint64_t> mu(independent.size(), 0);
+        for(std::size_t col = 0; col < d; col++){
+            if(v[col] == 0 || row_of[col] < 0) continue;
+            auto r = static_cast<std::size_t>(row_of[col]);
+            auto lambda = v[col];
+            for(std::size_t t = col; t < d; t++) v[t] = sub_mod(v[t], mont.mul(lambda, echelon[r][t]), mont.p);
+            for(std::size_t j = 0; j < combination[r].size(); j++) mu[j] = add_mod(mu[j], mont.mul(lambda, combination[r][j]), mont.p);
+        }
+        auto pivot = std::ranges::find_if(v, [](std::uint64_t x){ return x != 0; });
+        if(pivot == v.end()){
+            // m - sum mu_j b_j, the b_j below m
+            auto g = ModPoly{{mont.to(1)}, pack(c.exponents)};
+            for(std::size_t j = independent.size(); j-- > 0;){
+                if(mu[j] == 0) continue;
+                g.coefficients.push_back(sub_mod(0, mu[j], mont.p));
+                auto m = pack(independent[j]);
+                g.monomials.insert(g.monomials.end(), m.begin(), m.end());
+            }
+            ret.push_back(std::move(g));
+            new_leads.push_back(std::move(c.exponents));
+            continue;
+        }
+        auto col = static_cast<std::size_t>(pivot - v.begin());
+        auto inv = mont.pow(v[col], mont.p - 2);
+        for(auto& x : v) x = mont.mul(x, inv);
+        for(auto& x : mu) x = mont.mul(sub_mod(0, x, mont.p), inv);
+        mu.push_back(inv);
+        row_of[col] = static_cast<std::int64_t>(echelon.size());
+        echelon.push_back(std::move(v));
+        combination.push_back(std::move(mu));
+        auto a = independent.size();
+        for(std::size_t k = 0; k < n; k++){
+            auto e = c.exponents;
+            e[k]++;
+            auto m = pack(e);
+            candidates.emplace(std::move(m), Candidate{std::move(e), a, k});
+        }
+        independent.push_back(std::move(c.exponents));
+        forms_of.push_back(std::move(form));
+    }
+    // The terms of every element were added by decreasing monomials, since
+    // the visited ones are below the leading one
+    std::ranges::sort(ret, [&](const ModPoly& a, const ModPoly& b){
+        return target.compare(a.monomials.data(), b.monomials.data()) > 0;
+    });
+    return ret;
+}
+
+// n / d with |n|, d <= sqrt(m / 2) and n = a * d mod m, by the extended
+// Euclidean algorithm stopped halfway. Unique if it exists.
+inline auto rational_reconstruction(const MPi& a, const MPi& m) -> std::optional<Rational> {
+    auto bound = MPi();
+    mpz_fdiv_q_2exp(bound.handle(), m.handle(), 1);
+    mpz_sqrt(bound.handle(), bound.handle());
+    auto r0 = m, r1 = a, t0 = MPi(0), t1 = MPi(1), q = MPi(), r = MPi();
+    while(mpz_cmp(r1.handle(), bound.handle()) > 0){
+        mpz_fdiv_qr(q.handle(), r.handle(), r0.handle(), r1.handle());
+        mpz_swap(r0.handle(), r1.handle());
+        mpz_swap(r1.handle(), r.handle());
+        mpz_submul(t0.handle(), q.handle(), t1.handle());
+        mpz_swap(t0.handle(), t1.handle());
+    }
+    if(mpz_cmpabs(t1.handle(), bound.handle()) > 0) return std::nullopt;
+    mpz_gcd(q.handle(), r1.handle(), t1.handle());
+    if(mpz_cmp_ui(q.handle(), 1) != 0) return std::nullopt;
+    if(mpz_sgn(t1.handle()) < 0){
+        mpz_neg(r1.handle(), r1.handle());
+        mpz_neg(t1.handle(), t1.handle());
+    }
+    return Rational(std::move(r1), std::move(t1), true);
+}
+
+// The monomials of a basis modulo a prime, primes giving the same one have
+// their images combined
+inline auto shape(const std::vector<ModPoly>& basis) -> std::vector<std::uint64_t> {
+    std::vector<std::uint64_t> ret;
+    for(const auto& g : basis){
+        ret.push_back(g.size());
+        ret.insert(ret.end(), g.monomials.begin(), g.monomials.end());
+    }
+    return ret;
+}
+
+// The images of a basis modulo several primes combined by the Chinese
+// remainder theorem, coefficients in [0, modulus)
+struct Lift {
+    std::vector<ModPoly> shape;
+    std::vector<MPi> residues;
+    MPi modulus = MPi(1);
+    std::size_t primes = 0;
+
+    // An image with coefficients in the standard representation
+    void add(std::vector<ModPoly> image, std::uint64_t p) {
+        if(primes == 0){
+            for(const auto& g : image) residues.resize(residues.size() + g.size(), MPi(0));
+        }
+        auto u = inverse_mod(mpz_fdiv_ui(modulus.handle(), p), p);
+        std::size_t k = 0;
+        for(const auto& g : image){
+            for(auto c : g.coefficients){
+                auto& h = residues[k++];
+                auto delta = mul_mod(sub_mod(c, mpz_fdiv_ui(h.handle(), p), p), u, p);
+                mpz_addmul_ui(h.handle(), modulus.handle(), delta);
+            }
+        }
+        mpz_mul_ui(modulus.handle(), modulus.handle(), p);
+        primes++;
+        if(shape.empty()) shape = std::move(image);
+    }
+
+    auto reconstruct(const MonomialLayout& layout) const -> std::optional<std::vector<SparsePoly<Rational>>> {
+        std::vector<SparsePoly<Rational>> ret;
+        std::size_t k = 0;
+        for(const auto& g : shape){
+            auto f = SparsePoly<Rational>(layout);
+            f.reserve(g.size());
+            for(std::size_t i = 0; i < g.size(); i++){
+                auto c = rational_reconstruction(residues[k++], modulus);
+                if(not c) return std::nullopt;
+                f.push_back(std::move(*c), g.monomials.data() + i * layout.words());
+            }
+            ret.push_back(std::move(f));
+        }
+        return ret;
+    }
+};
+
+// Whether the basis over Q reduces to the image modulo p
+inline auto agrees(const std::vector<SparsePoly<Rational>>& basis, const std::vector<ModPoly>& image, std::uint64_t p) -> bool {
+    for(std::size_t i = 0; i < basis.size(); i++){
+        for(std::size_t k = 0; k < basis[i].size(); k++){
+            const auto& c = basis[i].coefficient(k);
+            auto d = mpz_fdiv_ui(c.denom().handle(), p);
+            if(d == 0) return false;
+            if(mul_mod(mpz_fdiv_ui(c.num().handle(), p), inverse_mod(d, p), p) != image[i].coefficients[k]) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace groebner_impl
+
+// The reduced Gröbner basis over Q of the ideal the polynomials generate,
+// in the monomial order of their common layout: monic, by decreasing
+// leading monomials. Empty for the zero ideal.
+//
+// The basis is computed by F4 modulo random 63 bit primes not dividing any
+// leading coefficient. In lex, it is computed in grevlex first and converted
+// by FGLM if the ideal is zero-dimensional, with F4 in lex as the fallback. The images with equal monomials are combined by the
+// Chinese remainder theorem and lifted to Q by rational reconstruction;
+// unlucky primes give different monomials, the most frequent ones win. A
+// lift is accepted once it reduces to the image modulo the next prime, it
+// is then wrong with a probability on the order of 2^-62. Proving it
+// correct over Q would cost more than computing it.
+inline auto groebner(const std::vector<SparsePoly<multiprecision::MPi>>& polys, GroebnerOptions options = {}) -> std::vector<SparsePoly<FieldOfFractions<multiprecision::MPi>>> {
+    using namespace groebner_impl;
+    std::vector<const SparsePoly<MPi>*> inputs;
+    for(const auto& f : polys){
+        if(not f.is_zero()) inputs.push_back(&f);
+    }
+    if(inputs.empty()) return {};
+    const auto& layout = inputs.front()->layout();
+    for(auto f : inputs){
+        if(not (f->layout() == layout)) throw std::runtime_error("Polynomials over different monomial layouts");
+    }
+
+    // Lex bases of zero-dimensional ideals are converted from grevlex ones
+    auto graded_layout = MonomialLayout(layout.variables(), MonomialOrder::Grevlex, layout.bits());
+    std::vector<SparsePoly<MPi>> graded;
+    if(layout.order() == MonomialOrder::Lex){
+        for(auto f : inputs){
+            std::vector<std::pair<MPi, std::vector<long>>> terms;
+            for(std::size_t i = 0; i < f->size(); i++) terms.emplace_back(f->coefficient(i), f->exponents(i));
+            graded.push_back(SparsePoly<MPi>::from_terms(graded_layout, std::move(terms)));
+        }
+    }
+
+    auto rng = std::mt19937_64(0);
+    std::map<std::vector<std::uint64_t>, Lift> lifts;
+    std::optional<std::pair<std::vector<std::uint64_t>, std::vector<SparsePoly<Rational>>>> candidate;
+    while(true){
+        auto p = modular::random_prime(rng);
+        auto unlucky = [&](const SparsePoly<MPi>& f){ return mpz_fdiv_ui(f.leading_coefficient().handle(), p) == 0; };
+        if(std::ranges::any_of(inputs, [&](auto f){ return unlucky(*f); }) || std::ranges::any_of(graded, unlucky)) continue;
+        auto mont = Montgomery(p);
+        auto reduced = [&](const SparsePoly<MPi>& f){
+            auto g = ModPoly{};
+            auto w = f.layout().words();
+            for(std::size_t i = 0; i < f.size(); i++){
+                auto c = mpz_fdiv_ui(f.coefficient(i).handle(), p);
+                if(c == 0) continue;
+                g.coefficients.push_back(mont.to(c));
+                g.monomials.insert(g.monomials.end(), f.monomial(i), f.monomial(i) + w);
+            }
+            return g;
+        };
+
+        std::optional<std::vector<ModPoly>> image;
+        if(not graded.empty()){
+            std::vector<ModPoly> system;
+            for(const auto& f : graded) system.push_back(reduced(f));
+            auto engine = Engine(graded_layout, mont, options.threads, options.rows_per_thread);
+            auto basis = engine.run(std::move(system));
+            image = fglm(engine, basis, graded_layout, layout, mont);
+        }
+        if(not image){
+            std::vector<ModPoly> system;
+            for(auto f : inputs) system.push_back(reduced(*f));
+            image = Engine(layout, mont, options.threads, options.rows_per_thread).run(std::move(system));
+        }
+        for(auto& g : *image){
+            for(auto& c : g.coefficients) c = mont.from(c);
+        }
+
+        auto key = shape(*image);
+        if(candidate && candidate->first == key && agrees(candidate->second, *image, p)) return std::move(candidate->second);
+        auto& lift = lifts[key];
+        lift.add(std::move(*image), p);
+        if(std::ranges::all_of(lifts, [&](const auto& l){ return l.second.primes <= lift.primes; })){
+            if(auto basis = lift.reconstruct(layout)) candidate.emplace(std::move(key), std::move(*basis));
+            else candidate.reset();
+        }
+    }
+}
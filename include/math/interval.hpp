@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <cfenv>
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <numbers>
+
+#include "math_functions.hpp"
+
+// Closed intervals [lo, hi] with outward rounding.
+//
+// All arithmetic assumes the FPU rounds upwards, see RoundUpward. Upper
+// bounds are then rounded correctly by the hardware, lower bounds are
+// computed as -((-a) op b), which rounds them downwards. Code using these
+// operations must be compiled with -frounding-math, otherwise the compiler
+// may fold the negations away.
+template<std::floating_point T>
+struct Interval {
+    constexpr Interval(T v = T{0}) : lo{v}, hi{v} {}
+    constexpr Interval(T l, T h) : lo{l}, hi{h} {}
+
+    template<std::integral I>
+    constexpr Interval(I v) : Interval(static_cast<T>(v)) {}
+
+    static constexpr auto whole() {
+        return Interval(-std::numeric_limits<T>::infinity(), std::numeric_limits<T>::infinity());
+    }
+
+    static constexpr auto invalid() {
+        return Interval(std::numeric_limits<T>::quiet_NaN(), std::numeric_limits<T>::quiet_NaN());
+    }
+
+    auto contains(T x) const { return lo <= x && x <= hi; }
+    auto width() const { return hi - lo; }
+
+    auto& operator+=(const Interval& other) {
+        lo = -((-lo) - other.lo);
+        hi = hi + other.hi;
+        return *this;
+    }
+
+    auto& operator-=(const Interval& other) {
+        lo = -(other.hi - lo);
+        hi = hi - other.lo;
+        return *this;
+    }
+
+    auto& operator*=(const Interval& other) {
+        // Upper bound of x*y and upper bound of -(x*y) for all corners. A
+        // zero times an infinite bound is 0, as the NaN would be dropped
+        // by std::max.
+        auto times = [](T x, T y){ return x == 0 || y == 0 ? T{0} : x * y; };
+        auto up = -std::numeric_limits<T>::infinity();
+        auto down = -std::numeric_limits<T>::infinity();
+        for(auto x : {lo, hi}){
+            for(auto y : {other.lo, other.hi}){
+                up = std::max(up, times(x, y));
+                down = std::max(down, times(-x, y));
+            }
+        }
+        lo = -down;
+        hi = up;
+        return *this;
+    }
+
+    auto& operator/=(const Interval& other) {
+        if(other.contains(0)) return *this = whole();
+        auto up = -std::numeric_limits<T>::infinity();
+        auto down = -std::numeric_limits<T>::infinity();
+        for(auto x : {lo, hi}){
+            for(auto y : {other.lo, other.hi}){
+                up = std::max(up, x / y);
+                down = std::max(down, (-x) / y);
+            }
+        }
+        lo = -down;
+        hi = up;
+        return *this;
+    }
+
+    friend auto operator-(const Interval& x) { return Interval(-x.hi, -x.lo); }
+    friend auto operator+(Interval lhs, const Interval& rhs) { lhs += rhs; return lhs; }
+    friend auto operator-(Interval lhs, const Interval& rhs) { lhs -= rhs; return lhs; }
+    friend auto operator*(Interval lhs, const Interval& rhs) { lhs *= rhs; return lhs; }
+    friend auto operator/(Interval lhs, const Interval& rhs) { lhs /= rhs; return lhs; }
+
+    T lo;
+    T hi;
+};
+
+namespace interval_impl{
+
+// Bounds of x^n for x >= 0 by repeated squaring, rounded upwards and downwards.
+template<std::floating_point T>
+auto pow_up(T x, long n) {
+    auto ret = T{1};
+    for(; n != 0; n >>= 1){
+        if(n & 1) ret = ret * x;
+        x = x * x;
+    }
+    return ret;
+}
+
+template<std::floating_point T>
+auto pow_down(T x, long n) {
+    auto ret = T{1};
+    for(; n != 0; n >>= 1){
+        if(n & 1) ret = -((-ret) * x);
+        x = -((-x) * x);
+    }
+    return ret;
+}
+
+// Widens the result of a libm function, which is only accurate to within
+// an ulp, to a rigorous bound.
+template<std::floating_point T>
+auto below(T x) { return std::nextafter(x, -std::numeric_limits<T>::infinity()); }
+
+template<std::floating_point T>
+auto above(T x) { return std::nextafter(x, std::numeric_limits<T>::infinity()); }
+
+// Whether a + k*period lies in x for some integer k. Borderline cases count
+// as contained, which can only make the enclosure wider.
+template<std::floating_point T>
+auto contains_periodic(const Interval<T>& x, T a, T period) {
+    auto slack = 4 * std::numeric_limits<T>::epsilon() * (std::abs(x.lo) + std::abs(x.hi) + period);
+    auto lo = x.lo - slack;
+    auto hi = x.hi + slack;
+    auto k = std::ceil((lo - a) / period);
+    for(auto j : {k - 1, k}){
+        auto p = a + j * period;
+        if(lo <= p && p <= hi) return true;
+    }
+    return false;
+}
+
+} // namespace interval_impl
+
+template<std::floating_point T>
+auto exp(const Interval<T>& x) {
+    using namespace interval_impl;
+    return Interval<T>(std::max(T{0}, below(std::exp(x.lo))), above(std::exp(x.hi)));
+}
+
+template<std::floating_point T>
+auto log(const Interval<T>& x) {
+    using namespace interval_impl;
+    if(x.hi < 0) return Interval<T>::invalid();
+    auto lo = x.lo <= 0 ? -std::numeric_limits<T>::infinity() : below(std::log(x.lo));
+    return Interval<T>(lo, above(std::log(x.hi)));
+}
+
+template<std::floating_point T>
+auto sqrt(const Interval<T>& x) {
+    using namespace interval_impl;
+    if(x.hi < 0) return Interval<T>::invalid();
+    auto lo = x.lo <= 0 ? T{0} : below(std::sqrt(x.lo));
+    return Interval<T>(lo, std::sqrt(x.hi));
+}
+
+template<std::floating_point T>
+auto sin(const Interval<T>& x) {
+    using namespace interval_impl;
+    constexpr auto pi = std::numbers::pi_v<T>;
+    if(not (x.width() < 2 * pi)) return Interval<T>(-1, 1);
+    auto a = std::sin(x.lo);
+    auto b = std::sin(x.hi);
+    auto lo = contains_periodic(x, -pi / 2, 2 * pi) ? T{-1} : std::max(T{-1}, below(std::min(a, b)));
+    auto hi = contains_periodic(x, pi / 2, 2 * pi) ? T{1} : std::min(T{1}, above(std::max(a, b)));
+    return Interval<T>(lo, hi);
+}
+
+template<std::floating_point T>
+auto cos(const Interval<T>& x) {
+    using namespace interval_impl;
+    constexpr auto pi = std::numbers::pi_v<T>;
+    if(not (x.width() < 2 * pi)) return Interval<T>(-1, 1);
+    auto a = std::cos(x.lo);
+    auto b = std::cos(x.hi);
+    auto lo = contains_periodic(x, pi, 2 * pi) ? T{-1} : std::max(T{-1}, below(std::min(a, b)));
+    auto hi = contains_periodic(x, T{0}, 2 * pi) ? T{1} : std::min(T{1}, above(std::max(a, b)));
+    return Interval<T>(lo, hi);
+}
+
+template<std::floating_point T>
+auto tan(const Interval<T>& x) {
+    using namespace interval_impl;
+    constexpr auto pi = std::numbers::pi_v<T>;
+    if(not (x.width() < pi) || contains_periodic(x, pi / 2, pi)) return Interval<T>::whole();
+    return Interval<T>(below(std::tan(x.lo)), above(std::tan(x.hi)));
+}
+
+// Sets the rounding mode the interval operations rely on for its lifetime.
+class RoundUpward {
+public:
+    RoundUpward() : m_previous{std::fegetround()} { std::fesetround(FE_UPWARD); }
+    ~RoundUpward() { std::fesetround(m_previous); }
+
+    RoundUpward(const RoundUpward&) = delete;
+    auto operator=(const RoundUpward&) -> RoundUpward& = delete;
+
+private:
+    int m_previous;
+};
+
+template<std::floating_point T, std::integral U>
+struct math::impl::pow<Interval<T>, U>{
+    static auto func(const Interval<T>& x, U un) -> Interval<T> {
+        using namespace interval_impl;
+        auto n = static_cast<long>(un);
+        if(n < 0) return Interval<T>(1) / math::pow(x, -n);
+        if(n == 0) return Interval<T>(1);
+        if(n % 2 == 1){
+            // Odd powers are monotone
+            auto lo = x.lo < 0 ? -pow_up(-x.lo, n) : pow_down(x.lo, n);
+            auto hi = x.hi < 0 ? -pow_down(-x.hi, n) : pow_up(x.hi, n);
+            return Interval<T>(lo, hi);
+        }
+        // Even powers of |x|
+        if(x.contains(0)) return Interval<T>(0, pow_up(std::max(-x.lo, x.hi), n));
+        auto a = std::min(std::abs(x.lo), std::abs(x.hi));
+        auto b = std::max(std::abs(x.lo), std::abs(x.hi));
+        return Interval<T>(pow_down(a, n), pow_up(b, n));
+    }
+};
+
+template<std::floating_point T>
+struct math::impl::pow<Interval<T>, Interval<T>>{
+    static auto func(Interval<T> x, const Interval<T>& y) -> Interval<T> {
+        using namespace interval_impl;
+        // Real powers are only defined for non-negative bases
+        if(x.hi < 0) return Interval<T>::invalid();
+        x.lo = std::max(x.lo, T{0});
+        if(y.lo == y.hi || y.lo > 0 || y.hi < 0){
+            // Constant exponents, the common case x^(p/q) even after they
+            // are widened to enclose p/q, and exponents of one sign are
+            // monotone in x and in y, the bounds are among the corners.
+            auto a = std::numeric_limits<T>::infinity();
+            auto b = T{0};
+            for(auto base : {x.lo, x.hi}){
+                for(auto e : {y.lo, y.hi}){
+                    auto v = std::pow(base, e);
+                    a = std::min(a, v);
+                    b = std::max(b, v);
+                }
+            }
+            return Interval<T>(std::max(T{0}, below(a)), above(b));
+        }
+        if(x.lo == 0) return Interval<T>(0, std::numeric_limits<T>::infinity());
+        return exp(y * log(x));
+    }
+};
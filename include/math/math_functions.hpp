@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <type_traits>
 #include <concepts>
 
@@ -32,6 +33,14 @@ struct pow<T, U>{
     }
 };
 
+// Overload for floating point exponent
+template<std::floating_point T>
+struct pow<T, T>{
+    static auto func(T t, T u) -> T{
+        return std::pow(t, u);
+    }
+};
+
 template<class T, class U>
 struct gcd{};
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+// Arithmetic modulo word-size primes p < 2^63, products go through 128 bit
+// integers.
+namespace modular{
+
+__extension__ using uint128 = unsigned __int128;
+
+constexpr auto add_mod(std::uint64_t a, std::uint64_t b, std::uint64_t p) -> std::uint64_t {
+    auto r = a + b;
+    return r >= p ? r - p : r;
+}
+
+constexpr auto sub_mod(std::uint64_t a, std::uint64_t b, std::uint64_t p) -> std::uint64_t {
+    return a >= b ? a - b : a + (p - b);
+}
+
+constexpr auto mul_mod(std::uint64_t a, std::uint64_t b, std::uint64_t p) -> std::uint64_t {
+    return static_cast<std::uint64_t>(static_cast<uint128>(a) * b % p);
+}
+
+constexpr auto pow_mod(std::uint64_t a, std::uint64_t n, std::uint64_t p) -> std::uint64_t {
+    std::uint64_t ret = 1 % p;
+    for(; n != 0; n >>= 1){
+        if(n & 1) ret = mul_mod(ret, a, p);
+        a = mul_mod(a, a, p);
+    }
+    return ret;
+}
+
+// The inverse of a modulo the prime p, by Fermat's little theorem.
+constexpr auto inverse_mod(std::uint64_t a, std::uint64_t p) -> std::uint64_t {
+    return pow_mod(a, p - 2, p);
+}
+
+// Montgomery multiplication modulo an odd p < 2^63. Values are kept as
+// x * 2^64 mod p, a product then reduces with two multiplications in place
+// of a 128 bit division. Sums and differences use add_mod and sub_mod.
+struct Montgomery {
+    std::uint64_t p = 1;
+    // -p^-1 mod 2^64
+    std::uint64_t p_inv = 0;
+    // 2^128 mod p, converts into the representation
+    std::uint64_t r2 = 0;
+    // 1 in the representation, 2^64 mod p
+    std::uint64_t one = 0;
+
+    constexpr Montgomery() = default;
+
+    constexpr explicit Montgomery(std::uint64_t _p)
+        : p{_p}
+    {
+        // Newton iteration for p^-1 mod 2^64, each step doubles the bits
+        std::uint64_t inv = p;
+        for(int k = 0; k < 5; k++) inv *= 2 - p * inv;
+        p_inv = -inv;
+        one = static_cast<std::uint64_t>((static_cast<uint128>(1) << 64) % p);
+        r2 = mul_mod(one, one, p);
+    }
+
+    // t * 2^-64 mod p for t < p * 2^64
+    constexpr auto reduce(uint128 t) const -> std::uint64_t {
+        auto m = static_cast<std::uint64_t>(t) * p_inv;
+        auto r = static_cast<std::uint64_t>((t + static_cast<uint128>(m) * p) >> 64);
+        return r >= p ? r - p : r;
+    }
+
+    constexpr auto mul(std::uint64_t a, std::uint64_t b) const -> std::uint64_t {
+        return reduce(static_cast<uint128>(a) * b);
+    }
+
+    constexpr auto to(std::uint64_t a) const -> std::uint64_t { return mul(a, r2); }
+    constexpr auto from(std::uint64_t a) const -> std::uint64_t { return reduce(a); }
+
+    constexpr auto pow(std::uint64_t a, std::uint64_t n) const -> std::uint64_t {
+        auto ret = one;
+        for(; n != 0; n >>= 1){
+            if(n & 1) ret = mul(ret, a);
+            a = mul(a, a);
+        }
+        return ret;
+    }
+};
+
+// Miller-Rabin with a set of bases that is deterministic for all 64 bit n
+constexpr auto is_prime(std::uint64_t n) -> bool {
+    if(n < 2) return false;
+    for(std::uint64_t q : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}){
+        if(n % q == 0) return n == q;
+    }
+    auto d = n - 1;
+    auto s = 0;
+    for(; d % 2 == 0; d /= 2) s++;
+    for(std::uint64_t a : {2, 325, 9375, 28178, 450775, 9780504, 1795265022}){
+        auto x = pow_mod(a % n, d, n);
+        if(x == 0 || x == 1 || x == n - 1) continue;
+        auto composite = true;
+        for(auto r = 1; r < s && composite; r++){
+            x = mul_mod(x, x, n);
+            if(x == n - 1) composite = false;
+        }
+        if(composite) return false;
+    }
+    return true;
+}
+
+// A random prime in [2^62, 2^63)
+template<class Rng>
+auto random_prime(Rng& rng) -> std::uint64_t {
+    auto dist = std::uniform_int_distribution<std::uint64_t>(std::uint64_t{1} << 62, (std::uint64_t{1} << 63) - 1);
+    while(true){
+        auto n = dist(rng) | 1;
+        if(is_prime(n)) return n;
+    }
+}
+
+} // namespace modular
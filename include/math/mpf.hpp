@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <stdexcept>
+#include <string>
+
+#include "gmp.h"
+#include "math_functions.hpp"
+#include "mpi.hpp"
+
+
+namespace multiprecision{
+
+// Binary floating point numbers of a chosen precision, based on GMP's mpf.
+// The result of an operation has the larger precision of its operands, so
+// that values only need the working precision set once at the leaves.
+class MPf final {
+public:
+    [[nodiscard]] MPf() {
+        mpf_init(m_handle);
+    }
+
+    template<std::signed_integral T>
+    [[nodiscard]] MPf(T value) {
+        mpf_init_set_si(m_handle, static_cast<long>(value));
+    }
+
+    template<std::unsigned_integral T>
+    [[nodiscard]] MPf(T value) {
+        mpf_init_set_ui(m_handle, static_cast<unsigned long>(value));
+    }
+
+    [[nodiscard]] MPf(double value, mp_bitcnt_t precision) {
+        mpf_init2(m_handle, precision);
+        mpf_set_d(m_handle, value);
+    }
+
+    [[nodiscard]] MPf(const MPi& value, mp_bitcnt_t precision) {
+        mpf_init2(m_handle, precision);
+        mpf_set_z(m_handle, value.handle());
+    }
+
+    MPf(const MPf& other) {
+        mpf_init2(m_handle, other.precision());
+        mpf_set(m_handle, other.m_handle);
+    }
+
+    MPf& operator=(const MPf& other) {
+        mpf_set_prec(m_handle, other.precision());
+        mpf_set(m_handle, other.m_handle);
+        return *this;
+    }
+
+    MPf(MPf&& other)
+        : MPf{}
+    {
+        mpf_swap(m_handle, other.m_handle);
+    }
+
+    MPf& operator=(MPf&& other) {
+        mpf_swap(m_handle, other.m_handle);
+        return *this;
+    }
+
+    ~MPf() {
+        mpf_clear(m_handle);
+    }
+
+    // Zero with the given precision. Not a constructor, MPf(n) is the integer n.
+    static auto zero(mp_bitcnt_t precision) -> MPf {
+        auto ret = MPf();
+        mpf_set_prec(ret.m_handle, precision);
+        return ret;
+    }
+
+    auto precision() const -> mp_bitcnt_t { return mpf_get_prec(m_handle); }
+
+    // The same value rounded to another precision
+    auto with_precision(mp_bitcnt_t precision) const -> MPf {
+        auto ret = MPf::zero(precision);
+        mpf_set(ret.m_handle, m_handle);
+        return ret;
+    }
+
+    // x = d * 2^exponent with 0.5 <= |d| < 1, or 0 for x = 0
+    auto exponent() const -> long {
+        long e = 0;
+        mpf_get_d_2exp(&e, m_handle);
+        return e;
+    }
+
+    /* ***********************************************
+        Comparision Operators
+    ************************************************** */
+
+    friend auto operator<=>(const MPf& lhs, const MPf& rhs) -> std::strong_ordering {
+        auto c = mpf_cmp(lhs.m_handle, rhs.m_handle);
+        if(c > 0) return std::strong_ordering::greater;
+        else if(c == 0) return std::strong_ordering::equal;
+        else return std::strong_ordering::less;
+    }
+
+    friend auto operator==(const MPf& lhs, const MPf& rhs) -> bool {
+        return mpf_cmp(lhs.m_handle, rhs.m_handle) == 0;
+    }
+
+    /* ***********************************************
+        Arithmetic Operators
+    ************************************************** */
+
+    auto operator-() const -> MPf {
+        auto ret = MPf::zero(precision());
+        mpf_neg(ret.m_handle, m_handle);
+        return ret;
+    }
+
+    auto operator+=(const MPf& other) -> MPf& { return *this = *this + other; }
+    auto operator-=(const MPf& other) -> MPf& { return *this = *this - other; }
+    auto operator*=(const MPf& other) -> MPf& { return *this = *this * other; }
+    auto operator/=(const MPf& other) -> MPf& { return *this = *this / other; }
+
+    friend auto operator+(const MPf& lhs, const MPf& rhs) -> MPf {
+        auto ret = MPf::zero(std::max(lhs.precision(), rhs.precision()));
+        mpf_add(ret.m_handle, lhs.m_handle, rhs.m_handle);
+        return ret;
+    }
+
+    friend auto operator-(const MPf& lhs, const MPf& rhs) -> MPf {
+        auto ret = MPf::zero(std::max(lhs.precision(), rhs.precision()));
+        mpf_sub(ret.m_handle, lhs.m_handle, rhs.m_handle);
+        return ret;
+    }
+
+    friend auto operator*(const MPf& lhs, const MPf& rhs) -> MPf {
+        auto ret = MPf::zero(std::max(lhs.precision(), rhs.precision()));
+        mpf_mul(ret.m_handle, lhs.m_handle, rhs.m_handle);
+        return ret;
+    }
+
+    friend auto operator/(const MPf& lhs, const MPf& rhs) -> MPf {
+        if(mpf_sgn(rhs.m_handle) == 0) throw std::runtime_error("Division by zero");
+        auto ret = MPf::zero(std::max(lhs.precision(), rhs.precision()));
+        mpf_div(ret.m_handle, lhs.m_handle, rhs.m_handle);
+        return ret;
+    }
+
+    // Multiplication by 2^k
+    auto ldexp(long k) const -> MPf {
+        auto ret = MPf::zero(precision());
+        if(k >= 0) mpf_mul_2exp(ret.m_handle, m_handle, static_cast<mp_bitcnt_t>(k));
+        else mpf_div_2exp(ret.m_handle, m_handle, static_cast<mp_bitcnt_t>(-k));
+        return ret;
+    }
+
+    /* ***********************************************
+        Misc
+    ************************************************** */
+
+    auto handle() const -> const mpf_t& { return m_handle; }
+    auto handle() -> mpf_t& { return m_handle; }
+private:
+    mpf_t m_handle = {};
+};
+
+namespace mpf_impl{
+
+// Whether |x| < 2^-bits, i.e. x is negligible at that precision
+inline auto negligible(const MPf& x, mp_bitcnt_t bits) -> bool {
+    return mpf_sgn(x.handle()) == 0 || x.exponent() < -static_cast<long>(bits);
+}
+
+// atan(1/n) = sum (-1)^k / ((2k+1) n^(2k+1))
+inline auto atan_inv(unsigned long n, mp_bitcnt_t precision) -> MPf {
+    auto power = MPf(1).with_precision(precision) / MPf(n);
+    auto n2 = MPf(n * n);
+    auto sum = power;
+    for(unsigned long k = 1; not negligible(power, precision); k++){
+        power = power / n2;
+        auto term = power / MPf(2 * k + 1);
+        sum = k % 2 == 1 ? sum - term : sum + term;
+    }
+    return sum;
+}
+
+// Taylor series of sin (start = 1) or cos (start = 0) for small |x|
+inline auto sin_cos_series(const MPf& x, unsigned long start) -> MPf {
+    auto x2 = x * x;
+    auto term = start == 1 ? x : MPf(1).with_precision(x.precision());
+    auto sum = term;
+    for(unsigned long k = start + 2; not negligible(term, x.precision()); k += 2){
+        term = -(term * x2) / MPf((k - 1) * k);
+        sum += term;
+    }
+    return sum;
+}
+
+} // namespace mpf_impl
+
+// pi by Machin's formula, 16 atan(1/5) - 4 atan(1/239)
+inline auto pi(mp_bitcnt_t precision) -> MPf {
+    using mpf_impl::atan_inv;
+    auto work = precision + 16;
+    auto ret = atan_inv(5, work).ldexp(4) - atan_inv(239, work).ldexp(2);
+    return ret.with_precision(precision);
+}
+
+inline auto sqrt(const MPf& x) -> MPf {
+    if(mpf_sgn(x.handle()) < 0) throw std::runtime_error("Square root of a negative number");
+    auto ret = MPf::zero(x.precision());
+    mpf_sqrt(ret.handle(), x.handle());
+    return ret;
+}
+
+inline auto exp(const MPf& x) -> MPf {
+    // exp(x) = exp(x / 2^s)^(2^s) with |x / 2^s| < 2^-8, every squaring
+    // costs about a bit, so s bits of extra precision are carried along.
+    auto s = std::max(0l, x.exponent() + 8);
+    auto work = x.precision() + static_cast<mp_bitcnt_t>(s) + 16;
+    auto r = x.with_precision(work).ldexp(-s);
+    auto term = MPf(1).with_precision(work);
+    auto sum = term;
+    for(unsigned long k = 1; not mpf_impl::negligible(term, work); k++){
+        term = term * r / MPf(k);
+        sum += term;
+    }
+    for(long k = 0; k < s; k++) sum = sum * sum;
+    return sum.with_precision(x.precision());
+}
+
+inline auto log(const MPf& x) -> MPf {
+    if(mpf_sgn(x.handle()) <= 0) throw std::runtime_error("Logarithm of a non-positive number");
+    // Halley iteration y <- y + 2 (x - e^y) / (x + e^y) from a double estimate
+    auto work = x.precision() + 16;
+    long e = 0;
+    auto d = mpf_get_d_2exp(&e, x.handle());
+    auto y = MPf(std::log(d) + static_cast<double>(e) * std::log(2.0), work);
+    auto xw = x.with_precision(work);
+    for(int k = 0; k < 64; k++){
+        auto ey = exp(y);
+        auto delta = (xw - ey).ldexp(1) / (xw + ey);
+        y += delta;
+        if(mpf_impl::negligible(delta, work - 8)) break;
+    }
+    return y.with_precision(x.precision());
+}
+
+// sin(x) and cos(x) after reducing x modulo 2 pi
+inline auto sin_cos(const MPf& x, bool sine) -> MPf {
+    auto work = x.precision() + static_cast<mp_bitcnt_t>(std::max(0l, x.exponent())) + 32;
+    auto two_pi = pi(work).ldexp(1);
+    auto xw = x.with_precision(work);
+    auto k = xw / two_pi;
+    mpf_floor(k.handle(), (k + MPf(1).ldexp(-1)).handle());
+    auto r = xw - k * two_pi;
+    return mpf_impl::sin_cos_series(r, sine ? 1 : 0).with_precision(x.precision());
+}
+
+inline auto sin(const MPf& x) -> MPf { return sin_cos(x, true); }
+inline auto cos(const MPf& x) -> MPf { return sin_cos(x, false); }
+inline auto tan(const MPf& x) -> MPf { return sin(x) / cos(x); }
+
+// x rounded to nearest with the given number of significant decimal digits,
+// in scientific notation. The rounding is only as good as x itself, callers
+// wanting a correctly rounded result must check the neighbourhood of x.
+inline auto to_string(const MPf& x, std::size_t digits) -> std::string {
+    if(digits == 0) throw std::runtime_error("At least one digit is required");
+    if(mpf_sgn(x.handle()) == 0) return "0";
+    auto work = x.precision() + 32;
+    auto ax = x.with_precision(work);
+    mpf_abs(ax.handle(), ax.handle());
+    // |x| = m * 10^e10 with the mantissa scaled to an integer of `digits` digits
+    auto e10 = static_cast<long>(std::floor(static_cast<double>(x.exponent() - 1) * 0.30102999566398120));
+    auto scaled = [&](long e){
+        auto p = MPf::zero(work);
+        mpf_set_ui(p.handle(), 10);
+        auto k = static_cast<long>(digits) - 1 - e;
+        mpf_pow_ui(p.handle(), p.handle(), static_cast<unsigned long>(k < 0 ? -k : k));
+        auto r = k < 0 ? ax / p : ax * p;
+        r += MPf(1).ldexp(-1);
+        auto ret = MPi();
+        mpz_set_f(ret.handle(), r.handle());
+        return ret;
+    };
+    auto lower = MPi();
+    mpz_ui_pow_ui(lower.handle(), 10, digits - 1);
+    auto upper = lower * MPi(10);
+    auto m = scaled(e10);
+    while(m >= upper){ e10++; m = scaled(e10); }
+    while(m < lower){ e10--; m = scaled(e10); }
+    auto mantissa = to_string(m);
+    auto ret = std::string(mpf_sgn(x.handle()) < 0 ? "-" : "") + mantissa.substr(0, 1);
+    if(digits > 1) ret += "." + mantissa.substr(1);
+    return ret + "e" + std::to_string(e10);
+}
+
+} // namespace multiprecision
+
+template<>
+struct math::impl::sign<multiprecision::MPf>{
+    static auto func(const multiprecision::MPf& x) {
+        return mpf_sgn(x.handle());
+    }
+};
+
+template<>
+struct math::impl::pow<multiprecision::MPf, multiprecision::MPf>{
+    static auto func(const multiprecision::MPf& base, const multiprecision::MPf& exponent) -> multiprecision::MPf {
+        return exp(exponent * log(base));
+    }
+};
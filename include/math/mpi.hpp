@@ -62,9 +62,12 @@ public:
     ************************************************** */
 
     friend std::string to_string(const MPi& value) {
+        // mpz_sizeinbase may overestimate by one, and the sign and the
+        // terminating null need room as well.
         std::string ret;
-        ret.resize(mpz_sizeinbase(value.m_handle, 10)+1);
+        ret.resize(mpz_sizeinbase(value.m_handle, 10)+2);
         mpz_get_str(ret.data(), 10, value.m_handle);
+        ret.resize(std::char_traits<char>::length(ret.c_str()));
         return ret;
     }
 
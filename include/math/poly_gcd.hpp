@@ -0,0 +1,489 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "math_functions.hpp"
+#include "modular.hpp"
+#include "mpi.hpp"
+#include "rational.hpp"
+#include "sparse_poly.hpp"
+
+enum class GcdAlgorithm : std::uint8_t {
+    // The heuristic first, the modular algorithm if it gives up
+    Auto,
+    // Throws if the heuristic gives up
+    Heuristic,
+    Modular
+};
+
+namespace poly_gcd_impl{
+
+using multiprecision::MPi;
+
+// The heuristic gives up once the integers it evaluates to would need more
+// bits than this. They grow by a factor of the degree with every variable,
+// giving up at this size costs a fraction of the modular algorithm.
+constexpr std::size_t heuristic_max_bits = std::size_t{1} << 22;
+constexpr int heuristic_tries = 6;
+
+// The positive gcd of the coefficients
+inline auto content(const SparsePoly<MPi>& p) -> MPi {
+    auto ret = MPi(0);
+    for(std::size_t i = 0; i < p.size(); i++){
+        mpz_gcd(ret.handle(), ret.handle(), p.coefficient(i).handle());
+        if(mpz_cmp_ui(ret.handle(), 1) == 0) break;
+    }
+    return ret;
+}
+
+inline auto divide_coefficients(const SparsePoly<MPi>& p, const MPi& c) -> SparsePoly<MPi> {
+    auto ret = SparsePoly<MPi>(p.layout());
+    ret.reserve(p.size());
+    for(std::size_t i = 0; i < p.size(); i++){
+        auto q = MPi();
+        mpz_divexact(q.handle(), p.coefficient(i).handle(), c.handle());
+        ret.push_back(std::move(q), p.monomial(i));
+    }
+    return ret;
+}
+
+// The largest absolute value of a coefficient
+inline auto max_norm(const SparsePoly<MPi>& p) -> MPi {
+    auto ret = MPi(0);
+    for(std::size_t i = 0; i < p.size(); i++){
+        if(mpz_cmpabs(p.coefficient(i).handle(), ret.handle()) > 0) mpz_abs(ret.handle(), p.coefficient(i).handle());
+    }
+    return ret;
+}
+
+/* ***********************************************
+    Heuristic GCD
+************************************************** */
+
+// p with x_v = xi
+inline auto substitute(const SparsePoly<MPi>& p, std::size_t v, const MPi& xi) -> SparsePoly<MPi> {
+    const auto& layout = p.layout();
+    std::vector<MPi> powers{MPi(1)};
+    for(long j = 0; j < p.degree(v); j++) powers.push_back(powers.back() * xi);
+    auto acc = TermAccumulator<MPi>(layout);
+    std::vector<std::uint64_t> m(layout.words());
+    std::vector<long> e(layout.variables());
+    for(std::size_t i = 0; i < p.size(); i++){
+        layout.unpack(p.monomial(i), e);
+        auto j = static_cast<std::size_t>(e[v]);
+        e[v] = 0;
+        layout.pack(e, m.data());
+        mpz_addmul(acc[m.data()].handle(), p.coefficient(i).handle(), powers[j].handle());
+    }
+    return std::move(acc).finish();
+}
+
+// The polynomial in x_v with coefficients below xi / 2 in absolute value
+// that takes the value g at x_v = xi, read off as the digits of g in the
+// symmetric base xi representation
+inline auto interpolate(const SparsePoly<MPi>& g, std::size_t v, const MPi& xi) -> SparsePoly<MPi> {
+    const auto& layout = g.layout();
+    std::vector<MPi> rest;
+    std::vector<std::vector<long>> exponents;
+    for(std::size_t i = 0; i < g.size(); i++){
+        rest.push_back(g.coefficient(i));
+        exponents.push_back(g.exponents(i));
+    }
+    auto half = MPi();
+    mpz_fdiv_q_2exp(half.handle(), xi.handle(), 1);
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(long j = 0; std::ranges::any_of(rest, [](const MPi& c){ return mpz_sgn(c.handle()) != 0; }); j++){
+        if(j > layout.max_degree()) throw std::runtime_error(fmt::format("Interpolation exceeds the {} bit exponent fields", layout.bits()));
+        for(std::size_t i = 0; i < rest.size(); i++){
+            if(mpz_sgn(rest[i].handle()) == 0) continue;
+            auto digit = MPi();
+            mpz_fdiv_r(digit.handle(), rest[i].handle(), xi.handle());
+            if(mpz_cmp(digit.handle(), half.handle()) > 0) mpz_sub(digit.handle(), digit.handle(), xi.handle());
+            mpz_sub(rest[i].handle(), rest[i].handle(), digit.handle());
+            mpz_divexact(rest[i].handle(), rest[i].handle(), xi.handle());
+            if(mpz_sgn(digit.handle()) == 0) continue;
+            auto e = exponents[i];
+            e[v] = j;
+            terms.emplace_back(std::move(digit), std::move(e));
+        }
+    }
+    return SparsePoly<MPi>::from_terms(layout, std::move(terms));
+}
+
+// Char, Geddes and Gonnet: the gcd of the integers a(xi) and b(xi) for a
+// large enough xi holds the gcd of a and b as its base xi digits. A
+// variable is evaluated at a time down to integers, the candidate built
+// from the digits is accepted once it divides both. Nothing if no
+// candidate did within a few tries or the integers grew too large.
+inline auto heuristic_gcd(const SparsePoly<MPi>& a, const SparsePoly<MPi>& b) -> std::optional<SparsePoly<MPi>> {
+    if(a.is_zero() || b.is_zero()) return {};
+    const auto& layout = a.layout();
+    auto v = layout.variables();
+    for(std::size_t k = 0; k < layout.variables() && v == layout.variables(); k++){
+        if(a.degree(k) > 0 || b.degree(k) > 0) v = k;
+    }
+    auto ca = content(a), cb = content(b);
+    auto c = math::gcd(ca, cb);
+    if(v == layout.variables()) return SparsePoly<MPi>::constant(layout, c);
+
+    auto pa = divide_coefficients(a, ca), pb = divide_coefficients(b, cb);
+    auto degree = static_cast<std::size_t>(std::max(pa.degree(v), pb.degree(v)));
+    auto na = max_norm(pa), nb = max_norm(pb);
+    auto xi = (na < nb ? na : nb) * MPi(2) + MPi(29);
+    for(int t = 0; t < heuristic_tries; t++){
+        if(mpz_sizeinbase(xi.handle(), 2) * degree > heuristic_max_bits) return {};
+        auto g = heuristic_gcd(substitute(pa, v, xi), substitute(pb, v, xi));
+        if(not g) return {};
+        auto h = interpolate(*g, v, xi);
+        if(not h.is_zero()){
+            h = divide_coefficients(h, content(h));
+            if(divide_exact(pa, h) && divide_exact(pb, h)) return h * c;
+        }
+        // Steps by an irrational looking factor, as in Liao and Fateman
+        mpz_mul_ui(xi.handle(), xi.handle(), 73794);
+        mpz_fdiv_q_ui(xi.handle(), xi.handle(), 27011);
+    }
+    return {};
+}
+
+/* ***********************************************
+    Modular GCD
+************************************************** */
+
+using modular::add_mod;
+using modular::sub_mod;
+using modular::mul_mod;
+using modular::inverse_mod;
+
+// A univariate polynomial over Z_p, lowest degree first without trailing
+// zeros
+using Dense = std::vector<std::uint64_t>;
+
+inline void trim(Dense& a) {
+    while(not a.empty() && a.back() == 0) a.pop_back();
+}
+
+inline auto evaluate(const Dense& a, std::uint64_t x, std::uint64_t p) -> std::uint64_t {
+    std::uint64_t ret = 0;
+    for(auto it = a.rbegin(); it != a.rend(); ++it) ret = add_mod(mul_mod(ret, x, p), *it, p);
+    return ret;
+}
+
+inline auto multiply(const Dense& a, const Dense& b, std::uint64_t p) -> Dense {
+    if(a.empty() || b.empty()) return {};
+    Dense ret(a.size() + b.size() - 1, 0);
+    for(std::size_t i = 0; i < a.size(); i++){
+        for(std::size_t j = 0; j < b.size(); j++) ret[i + j] = add_mod(ret[i + j], mul_mod(a[i], b[j], p), p);
+    }
+    return ret;
+}
+
+// Quotient and remainder for b != 0
+inline auto divide(Dense a, const Dense& b, std::uint64_t p) -> std::pair<Dense, Dense> {
+    if(a.size() < b.size()) return {{}, std::move(a)};
+    auto inv = inverse_mod(b.back(), p);
+    Dense q(a.size() - b.size() + 1, 0);
+    for(auto k = q.size(); k-- > 0;){
+        auto t = mul_mod(a[k + b.size() - 1], inv, p);
+        q[k] = t;
+        for(std::size_t j = 0; j < b.size(); j++) a[k + j] = sub_mod(a[k + j], mul_mod(t, b[j], p), p);
+    }
+    trim(a);
+    return {std::move(q), std::move(a)};
+}
+
+// The monic gcd, zero only if both are
+inline auto dense_gcd(Dense a, Dense b, std::uint64_t p) -> Dense {
+    while(not b.empty()){
+        auto r = divide(std::move(a), b, p).second;
+        a = std::move(b);
+        b = std::move(r);
+    }
+    if(a.empty()) return a;
+    auto inv = inverse_mod(a.back(), p);
+    for(auto& x : a) x = mul_mod(x, inv, p);
+    return a;
+}
+
+// A polynomial over Z_p as its terms in decreasing lexicographic order of
+// the exponents
+using Exponents = std::vector<long>;
+using Terms = std::vector<std::pair<Exponents, std::uint64_t>>;
+// The same as polynomials in x_v with coefficients in the other variables,
+// keyed by their monomials with a zero exponent of x_v
+using Grouped = std::map<Exponents, Dense, std::greater<>>;
+
+inline auto group(const Terms& a, std::size_t v) -> Grouped {
+    auto ret = Grouped();
+    for(const auto& [e, c] : a){
+        auto key = e;
+        auto j = static_cast<std::size_t>(key[v]);
+        key[v] = 0;
+        auto& d = ret[key];
+        if(d.size() <= j) d.resize(j + 1, 0);
+        d[j] = c;
+    }
+    return ret;
+}
+
+// The keys only differ in variables before v, so the terms of one key in
+// decreasing powers of x_v are in lexicographic order.
+inline auto ungroup(const Grouped& g, std::size_t v) -> Terms {
+    auto ret = Terms();
+    for(const auto& [key, d] : g){
+        for(auto j = d.size(); j-- > 0;){
+            if(d[j] == 0) continue;
+            auto e = key;
+            e[v] = static_cast<long>(j);
+            ret.emplace_back(std::move(e), d[j]);
+        }
+    }
+    return ret;
+}
+
+inline auto make_monic(Terms a, std::uint64_t p) -> Terms {
+    if(a.empty()) return a;
+    auto inv = inverse_mod(a.front().second, p);
+    for(auto& [e, c] : a) c = mul_mod(c, inv, p);
+    return a;
+}
+
+// The gcd of the coefficients in x_v
+inline auto content(const Grouped& g, std::uint64_t p) -> Dense {
+    auto ret = Dense();
+    for(const auto& [key, d] : g){
+        ret = dense_gcd(std::move(ret), d, p);
+        if(ret.size() == 1) break;
+    }
+    return ret;
+}
+
+inline void divide_content(Grouped& g, const Dense& c, std::uint64_t p) {
+    if(c.size() == 1) return;
+    for(auto& [key, d] : g) d = divide(std::move(d), c, p).first;
+}
+
+inline auto evaluate(const Grouped& g, std::uint64_t x, std::uint64_t p) -> Terms {
+    auto ret = Terms();
+    for(const auto& [key, d] : g){
+        if(auto c = evaluate(d, x, p); c != 0) ret.emplace_back(key, c);
+    }
+    return ret;
+}
+
+inline auto is_constant(const Terms& a) -> bool {
+    return std::ranges::all_of(a.front().first, [](long e){ return e == 0; });
+}
+
+// Brown's dense modular algorithm over Z_p in the variables x_0..x_{n-1}:
+// the primitive parts in x_{n-1} are evaluated at random points, their
+// gcds computed recursively and interpolated in x_{n-1} once there are more
+// points than the degree bound. The images are scaled to the gcd of the
+// leading coefficients so that they agree. An image with a larger leading
+// monomial than the others comes from an unlucky point and is skipped, a
+// smaller one discards the previous points. The result is monic.
+inline auto modular_gcd(const Terms& a, const Terms& b, std::size_t n, std::uint64_t p, std::mt19937_64& rng) -> Terms {
+    if(a.empty()) return make_monic(b, p);
+    if(b.empty()) return make_monic(a, p);
+    auto zero = Exponents(a.front().first.size(), 0);
+    if(n == 0) return {{zero, 1}};
+    auto v = n - 1;
+    auto ga = group(a, v), gb = group(b, v);
+    auto ca = content(ga, p), cb = content(gb, p);
+    auto c = dense_gcd(ca, cb, p);
+    divide_content(ga, ca, p);
+    divide_content(gb, cb, p);
+
+    const auto& lca = ga.begin()->second;
+    const auto& lcb = gb.begin()->second;
+    auto gamma = dense_gcd(lca, lcb, p);
+    auto degree = [](const Grouped& g){
+        std::size_t ret = 0;
+        for(const auto& [key, d] : g) ret = std::max(ret, d.size() - 1);
+        return ret;
+    };
+    auto bound = std::min(degree(ga), degree(gb)) + gamma.size() - 1;
+
+    auto result = Grouped();
+    auto q = Dense{1};
+    auto lm = Exponents();
+    std::size_t points = 0;
+    auto dist = std::uniform_int_distribution<std::uint64_t>(0, p - 1);
+    while(true){
+        auto x = dist(rng);
+        if(evaluate(lca, x, p) == 0 || evaluate(lcb, x, p) == 0) continue;
+        auto g = modular_gcd(evaluate(ga, x, p), evaluate(gb, x, p), v, p, rng);
+        if(is_constant(g)) return ungroup(Grouped{{zero, c}}, v);
+        if(points > 0 && g.front().first > lm) continue;
+        if(points == 0 || g.front().first < lm){
+            result.clear();
+            q = {1};
+            points = 0;
+            lm = g.front().first;
+        }
+
+        // Newton interpolation: result += (s g - result(x)) / q(x) * q
+        auto s = evaluate(gamma, x, p);
+        auto u = inverse_mod(evaluate(q, x, p), p);
+        for(const auto& [e, value] : g) result[e];
+        std::size_t i = 0;
+        for(auto& [key, d] : result){
+            std::uint64_t target = 0;
+            while(i < g.size() && g[i].first > key) i++;
+            if(i < g.size() && g[i].first == key) target = mul_mod(g[i].second, s, p);
+            auto delta = mul_mod(sub_mod(target, evaluate(d, x, p), p), u, p);
+            if(delta == 0) continue;
+            if(d.size() < q.size()) d.resize(q.size(), 0);
+            for(std::size_t j = 0; j < q.size(); j++) d[j] = add_mod(d[j], mul_mod(delta, q[j], p), p);
+        }
+        q = multiply(q, Dense{p - x, 1}, p);
+
+        if(++points > bound){
+            for(auto& [key, d] : result) trim(d);
+            std::erase_if(result, [](const auto& entry){ return entry.second.empty(); });
+            divide_content(result, content(result, p), p);
+            for(auto& [key, d] : result) d = multiply(d, c, p);
+            return make_monic(ungroup(result, v), p);
+        }
+    }
+}
+
+// The gcd of primitive polynomials over Z. Brown's algorithm modulo
+// random 63 bit primes, the images are combined by the Chinese remainder
+// theorem until the symmetric representative stops changing and divides
+// both. Images with larger leading monomials come from unlucky primes.
+inline auto modular_gcd(const SparsePoly<MPi>& a, const SparsePoly<MPi>& b) -> SparsePoly<MPi> {
+    const auto& layout = a.layout();
+    auto n = layout.variables();
+    auto lex_terms = [](const SparsePoly<MPi>& f){
+        std::vector<std::pair<Exponents, MPi>> ret;
+        for(std::size_t i = 0; i < f.size(); i++) ret.emplace_back(f.exponents(i), f.coefficient(i));
+        std::ranges::sort(ret, std::greater<>{}, [](const auto& t) -> const Exponents& { return t.first; });
+        return ret;
+    };
+    auto ta = lex_terms(a), tb = lex_terms(b);
+    auto reduce = [](const std::vector<std::pair<Exponents, MPi>>& t, std::uint64_t p){
+        auto ret = Terms();
+        for(const auto& [e, c] : t){
+            if(auto r = mpz_fdiv_ui(c.handle(), p); r != 0) ret.emplace_back(e, r);
+        }
+        return ret;
+    };
+    auto gamma = math::gcd(ta.front().second, tb.front().second);
+
+    auto rng = std::mt19937_64(0);
+    auto lifted = std::map<Exponents, MPi, std::greater<>>();
+    auto modulus = MPi(1);
+    auto lm = Exponents();
+    auto previous = std::optional<SparsePoly<MPi>>();
+    while(true){
+        auto p = modular::random_prime(rng);
+        if(mpz_fdiv_ui(ta.front().second.handle(), p) == 0 || mpz_fdiv_ui(tb.front().second.handle(), p) == 0) continue;
+        auto g = modular_gcd(reduce(ta, p), reduce(tb, p), n, p, rng);
+        if(is_constant(g)) return SparsePoly<MPi>::constant(layout, MPi(1));
+        if(not lifted.empty() && g.front().first > lm) continue;
+        if(lifted.empty() || g.front().first < lm){
+            lifted.clear();
+            modulus = MPi(1);
+            previous.reset();
+            lm = g.front().first;
+        }
+
+        auto s = mpz_fdiv_ui(gamma.handle(), p);
+        auto u = inverse_mod(mpz_fdiv_ui(modulus.handle(), p), p);
+        for(const auto& [e, value] : g) lifted[e];
+        std::size_t i = 0;
+        for(auto& [e, h] : lifted){
+            std::uint64_t target = 0;
+            while(i < g.size() && g[i].first > e) i++;
+            if(i < g.size() && g[i].first == e) target = mul_mod(g[i].second, s, p);
+            auto delta = mul_mod(sub_mod(target, mpz_fdiv_ui(h.handle(), p), p), u, p);
+            mpz_addmul_ui(h.handle(), modulus.handle(), delta);
+        }
+        mpz_mul_ui(modulus.handle(), modulus.handle(), p);
+
+        auto half = MPi();
+        mpz_fdiv_q_2exp(half.handle(), modulus.handle(), 1);
+        std::vector<std::pair<MPi, std::vector<long>>> terms;
+        for(const auto& [e, h] : lifted){
+            auto c = h;
+            if(mpz_cmp(c.handle(), half.handle()) > 0) mpz_sub(c.handle(), c.handle(), modulus.handle());
+            if(mpz_sgn(c.handle()) != 0) terms.emplace_back(std::move(c), e);
+        }
+        auto candidate = SparsePoly<MPi>::from_terms(layout, std::move(terms));
+        if(previous && *previous == candidate){
+            auto h = divide_coefficients(candidate, content(candidate));
+            if(divide_exact(a, h) && divide_exact(b, h)) return h;
+        }
+        previous = std::move(candidate);
+    }
+}
+
+} // namespace poly_gcd_impl
+
+// The greatest common divisor of two polynomials. Over the integers it is
+// the gcd of the contents times that of the primitive parts, with a
+// positive leading coefficient. Over the rationals it is monic.
+template<class C>
+auto gcd(const SparsePoly<C>& a, const SparsePoly<C>& b, GcdAlgorithm algorithm = GcdAlgorithm::Auto) -> SparsePoly<C> {
+    using multiprecision::MPi;
+    if(not (a.layout() == b.layout())) throw std::runtime_error("Polynomials over different monomial layouts");
+    const auto& layout = a.layout();
+    if constexpr(std::same_as<C, MPi>){
+        using namespace poly_gcd_impl;
+        if(a.is_zero() || b.is_zero()){
+            const auto& g = a.is_zero() ? b : a;
+            return g.is_zero() || g.leading_coefficient() > 0 ? g : -g;
+        }
+        auto ca = content(a), cb = content(b);
+        auto c = math::gcd(ca, cb);
+        auto pa = divide_coefficients(a, ca), pb = divide_coefficients(b, cb);
+        auto g = SparsePoly<MPi>::constant(layout, MPi(1));
+        if(pa.degree() > 0 && pb.degree() > 0){
+            auto h = algorithm == GcdAlgorithm::Modular ? std::nullopt : heuristic_gcd(pa, pb);
+            if(h) g = std::move(*h);
+            else if(algorithm == GcdAlgorithm::Heuristic) throw std::runtime_error("The heuristic gcd gave up");
+            else g = modular_gcd(pa, pb);
+        }
+        if(g.leading_coefficient() < 0) g = -g;
+        return g * c;
+    }
+    else{
+        // Cleared of denominators, the integer gcd made monic
+        auto integral = [&](const SparsePoly<C>& f){
+            auto d = MPi(1);
+            for(std::size_t i = 0; i < f.size(); i++) mpz_lcm(d.handle(), d.handle(), f.coefficient(i).denom().handle());
+            auto ret = SparsePoly<MPi>(layout);
+            for(std::size_t i = 0; i < f.size(); i++){
+                auto c = MPi();
+                mpz_divexact(c.handle(), d.handle(), f.coefficient(i).denom().handle());
+                ret.push_back(c * f.coefficient(i).num(), f.monomial(i));
+            }
+            return ret;
+        };
+        auto g = gcd(integral(a), integral(b), algorithm);
+        auto ret = SparsePoly<C>(layout);
+        if(g.is_zero()) return ret;
+        auto lc = C(g.leading_coefficient());
+        for(std::size_t i = 0; i < g.size(); i++) ret.push_back(C(g.coefficient(i)) / lc, g.monomial(i));
+        return ret;
+    }
+}
+
+template<class C>
+struct math::impl::gcd<SparsePoly<C>, SparsePoly<C>>{
+    static auto func(const SparsePoly<C>& a, const SparsePoly<C>& b) -> SparsePoly<C> {
+        return ::gcd(a, b);
+    }
+};
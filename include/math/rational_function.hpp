@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "math_functions.hpp"
+#include "poly_gcd.hpp"
+#include "sparse_poly.hpp"
+
+// A quotient of two polynomials over the field F, FieldOfFractions<MPi>,
+// without common factors and with a monic denominator (leading coefficient
+// one in the monomial order).
+//
+// The denominator is kept as powers of monic, pairwise coprime factors. It
+// is only split as far as sums and products need: a factor meeting another
+// one with a non-trivial gcd is replaced by the gcd and the two cofactors,
+// there is no factorization. A sum thereby multiplies each numerator by the
+// factors missing from its denominator only, and the cancellation takes
+// gcds with single factors instead of with the whole denominator. The
+// expanded denominator is computed on first use.
+template<class F>
+class RationalFunction {
+public:
+    using Poly = SparsePoly<F>;
+
+    struct Factor {
+        Poly base;
+        long multiplicity;
+    };
+
+    explicit RationalFunction(Poly _numerator)
+        : m_numerator{std::move(_numerator)}
+    {}
+
+    RationalFunction(Poly _numerator, const Poly& _denominator)
+        : m_numerator{std::move(_numerator)}
+    {
+        if(_denominator.is_zero()) throw std::runtime_error("Division by the zero polynomial");
+        m_numerator = m_numerator * (F(1) / _denominator.leading_coefficient());
+        std::vector<Shared> factors;
+        if(_denominator.degree() > 0) factors.push_back({monic(_denominator), 1, 0});
+        cancel(m_numerator, factors);
+        m_factors = finish(std::move(factors));
+    }
+
+    auto numerator() const -> const Poly& { return m_numerator; }
+    auto factors() const -> const std::vector<Factor>& { return m_factors; }
+    auto is_zero() const { return m_numerator.is_zero(); }
+
+    // The product of the factors, computed once
+    auto denominator() const -> const Poly& {
+        if(not m_denominator){
+            auto d = Poly::constant(m_numerator.layout(), F(1));
+            for(const auto& f : m_factors) d = d * math::pow(f.base, f.multiplicity);
+            m_denominator = std::move(d);
+        }
+        return *m_denominator;
+    }
+
+    auto reciprocal() const -> RationalFunction {
+        if(is_zero()) throw std::runtime_error("Division by the zero rational function");
+        auto ret = RationalFunction(denominator() * (F(1) / m_numerator.leading_coefficient()));
+        if(m_numerator.degree() > 0) ret.m_factors.push_back({monic(m_numerator), 1});
+        return ret;
+    }
+
+    /* ***********************************************
+        Arithmetic
+    ************************************************** */
+
+    auto operator-() const -> RationalFunction {
+        auto ret = *this;
+        ret.m_numerator = -ret.m_numerator;
+        return ret;
+    }
+
+    friend auto operator+(const RationalFunction& a, const RationalFunction& b) -> RationalFunction {
+        check_layouts(a, b);
+        if(a.is_zero()) return b;
+        if(b.is_zero()) return a;
+        auto base = merge(a.m_factors, b.m_factors);
+        auto na = a.m_numerator, nb = b.m_numerator;
+        for(auto& s : base){
+            auto m = std::max(s.left, s.right);
+            if(s.left < m) na = na * math::pow(s.base, m - s.left);
+            if(s.right < m) nb = nb * math::pow(s.base, m - s.right);
+            s.left = m;
+        }
+        auto ret = RationalFunction(na + nb);
+        cancel(ret.m_numerator, base);
+        ret.m_factors = finish(std::move(base));
+        return ret;
+    }
+
+    friend auto operator-(const RationalFunction& a, const RationalFunction& b) -> RationalFunction { return a + (-b); }
+
+    // Each numerator is cancelled against the other denominator first, the
+    // product is then without common factors.
+    friend auto operator*(const RationalFunction& a, const RationalFunction& b) -> RationalFunction {
+        check_layouts(a, b);
+        if(a.is_zero() || b.is_zero()) return RationalFunction(Poly(a.m_numerator.layout()));
+        auto na = a.m_numerator, nb = b.m_numerator;
+        auto fa = shared(a.m_factors), fb = shared(b.m_factors);
+        cancel(na, fb);
+        cancel(nb, fa);
+        auto base = merge(finish(std::move(fa)), finish(std::move(fb)));
+        for(auto& s : base) s.left += s.right;
+        auto ret = RationalFunction(na * nb);
+        ret.m_factors = finish(std::move(base));
+        return ret;
+    }
+
+    friend auto operator/(const RationalFunction& a, const RationalFunction& b) -> RationalFunction { return a * b.reciprocal(); }
+
+    auto operator+=(const RationalFunction& other) -> RationalFunction& { return *this = *this + other; }
+    auto operator-=(const RationalFunction& other) -> RationalFunction& { return *this = *this - other; }
+    auto operator*=(const RationalFunction& other) -> RationalFunction& { return *this = *this * other; }
+    auto operator/=(const RationalFunction& other) -> RationalFunction& { return *this = *this / other; }
+
+    // The representation is canonical once the denominator is expanded
+    friend auto operator==(const RationalFunction& a, const RationalFunction& b) -> bool {
+        return a.m_numerator == b.m_numerator && a.denominator() == b.denominator();
+    }
+
+    // The power with the multiplicities of the factors scaled
+    auto pow(long n) const -> RationalFunction {
+        if(n < 0) return reciprocal().pow(-n);
+        auto ret = RationalFunction(math::pow(m_numerator, n));
+        if(n == 0) return ret;
+        ret.m_factors = m_factors;
+        for(auto& f : ret.m_factors) f.multiplicity *= n;
+        return ret;
+    }
+
+private:
+    // A factor during a merge, with its multiplicities in the left and the
+    // right denominator
+    struct Shared {
+        Poly base;
+        long left;
+        long right;
+    };
+
+    Poly m_numerator;
+    std::vector<Factor> m_factors;
+    mutable std::optional<Poly> m_denominator;
+
+    static void check_layouts(const RationalFunction& a, const RationalFunction& b) {
+        if(not (a.m_numerator.layout() == b.m_numerator.layout())) throw std::runtime_error("Rational functions over different monomial layouts");
+    }
+
+    static auto monic(const Poly& p) -> Poly {
+        return p * (F(1) / p.leading_coefficient());
+    }
+
+    static auto shared(const std::vector<Factor>& factors) -> std::vector<Shared> {
+        std::vector<Shared> ret;
+        for(const auto& f : factors) ret.push_back({f.base, f.multiplicity, 0});
+        return ret;
+    }
+
+    // The factors with a left multiplicity
+    static auto finish(std::vector<Shared> base) -> std::vector<Factor> {
+        std::vector<Factor> ret;
+        for(auto& s : base){
+            if(s.left != 0) ret.push_back({std::move(s.base), s.left});
+        }
+        return ret;
+    }
+
+    // Adds a factor to a coprime base. One sharing a gcd g with a factor b
+    // of the base is split, b^e f^k = g^(e+k) (b/g)^e (f/g)^k, and the three
+    // parts are inserted in turn as they may still share factors with each
+    // other.
+    static void insert(std::vector<Shared>& base, Shared factor) {
+        std::vector<Shared> pending;
+        pending.push_back(std::move(factor));
+        while(not pending.empty()){
+            auto next = std::move(pending.back());
+            pending.pop_back();
+            if(next.base.degree() <= 0) continue;
+            auto coprime = true;
+            for(std::size_t i = 0; i < base.size() && coprime; i++){
+                auto& b = base[i];
+                if(b.base == next.base){
+                    b.left += next.left;
+                    b.right += next.right;
+                    coprime = false;
+                    continue;
+                }
+                auto g = gcd(b.base, next.base);
+                if(g.degree() <= 0) continue;
+                auto old = std::move(b);
+                base.erase(base.begin() + static_cast<std::ptrdiff_t>(i));
+                pending.push_back({*divide_exact(old.base, g), old.left, old.right});
+                pending.push_back({*divide_exact(next.base, g), next.left, next.right});
+                pending.push_back({std::move(g), old.left + next.left, old.right + next.right});
+                coprime = false;
+            }
+            if(coprime) base.push_back(std::move(next));
+        }
+    }
+
+    // A common coprime base of two, with the multiplicities in each
+    static auto merge(const std::vector<Factor>& left, const std::vector<Factor>& right) -> std::vector<Shared> {
+        auto ret = shared(left);
+        for(const auto& f : right) insert(ret, {f.base, 0, f.multiplicity});
+        return ret;
+    }
+
+    // Divides out the common factors of the numerator and the left
+    // multiplicities. A factor only partly dividing the numerator is split.
+    static void cancel(Poly& numerator, std::vector<Shared>& base) {
+        if(numerator.is_zero()){
+            base.clear();
+            return;
+        }
+        for(std::size_t i = 0; i < base.size();){
+            if(base[i].left == 0){
+                i++;
+                continue;
+            }
+            auto g = gcd(numerator, base[i].base);
+            if(g.degree() <= 0){
+                i++;
+                continue;
+            }
+            if(g == base[i].base){
+                numerator = *divide_exact(numerator, g);
+                base[i].left--;
+                continue;
+            }
+            auto f = std::move(base[i]);
+            base.erase(base.begin() + static_cast<std::ptrdiff_t>(i));
+            auto cofactor = *divide_exact(f.base, g);
+            insert(base, {std::move(g), f.left, f.right});
+            insert(base, {std::move(cofactor), f.left, f.right});
+            i = 0;
+        }
+    }
+};
+
+template<class F, std::integral U>
+struct math::impl::pow<RationalFunction<F>, U>{
+    static auto func(const RationalFunction<F>& base, U n) -> RationalFunction<F> {
+        return base.pow(static_cast<long>(n));
+    }
+};
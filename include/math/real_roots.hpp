@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "factor.hpp"
+#include "mpi.hpp"
+#include "rational.hpp"
+#include "upoly.hpp"
+
+struct RealRootOptions {
+    // Intervals are refined to a width of at most 2^-precision, they are
+    // left as isolated if not set
+    std::optional<long> precision;
+};
+
+// An open interval holding exactly one real root of a polynomial, or the
+// root itself if lower == upper
+struct IsolatingInterval {
+    FieldOfFractions<multiprecision::MPi> lower;
+    FieldOfFractions<multiprecision::MPi> upper;
+
+    auto is_exact() const -> bool { return lower == upper; }
+};
+
+namespace real_roots_impl{
+
+using multiprecision::MPi;
+using Rational = FieldOfFractions<MPi>;
+using Poly = UPoly<MPi>;
+
+// Sign changes in the coefficients, zeros skipped. By Descartes' rule it
+// bounds the number of positive roots and has their parity.
+inline auto variations(const Poly& p) -> std::size_t {
+    std::size_t ret = 0;
+    auto last = 0;
+    for(const auto& c : p.coefficients()){
+        auto s = mpz_sgn(c.handle());
+        if(s == 0) continue;
+        if(last != 0 && s != last) ret++;
+        last = s;
+    }
+    return ret;
+}
+
+// log2 |c| for c != 0
+inline auto log2_abs(const MPi& c) -> double {
+    long e = 0;
+    auto d = mpz_get_d_2exp(&e, c.handle());
+    return std::log2(std::abs(d)) + static_cast<double>(e);
+}
+
+// log2 of an upper bound on the positive roots of p, nothing if no
+// coefficient has the sign opposite to the leading one. By the local max
+// quadratic bound of Akritas, Strzeboński and Vigklas: each such
+// coefficient is paired with the coefficient of the leading sign and
+// higher degree that gives the smallest bound, where the t-th use of a
+// coefficient counts with the weight 2^-t. The weights of a coefficient
+// sum to less than one, which makes it a bound.
+inline auto positive_root_bound(std::span<const MPi> p) -> std::optional<double> {
+    auto n = p.size() - 1;
+    auto sign = mpz_sgn(p[n].handle());
+    // The degrees and log2 |c| of the coefficients of the leading sign
+    // seen so far, and their uses
+    std::vector<std::pair<std::size_t, double>> positive;
+    std::vector<double> uses;
+    std::optional<double> ret;
+    for(auto i = p.size(); i-- > 0;){
+        auto s = mpz_sgn(p[i].handle());
+        if(s == 0) continue;
+        auto l = log2_abs(p[i]);
+        if(s == sign){
+            positive.emplace_back(i, l);
+            uses.push_back(1.0);
+            continue;
+        }
+        auto best = std::size_t(0);
+        auto b = std::numeric_limits<double>::infinity();
+        for(std::size_t k = 0; k < positive.size(); k++){
+            auto [j, lj] = positive[k];
+            auto x = (uses[k] + l - lj) / static_cast<double>(j - i);
+            if(x < b){
+                b = x;
+                best = k;
+            }
+        }
+        uses[best] += 1.0;
+        ret = ret ? std::max(*ret, b) : b;
+    }
+    return ret;
+}
+
+inline auto power_of_two(long e) -> Rational {
+    auto x = MPi(1);
+    mpz_mul_2exp(x.handle(), x.handle(), static_cast<mp_bitcnt_t>(std::abs(e)));
+    return e >= 0 ? Rational(x) : Rational(MPi(1), x);
+}
+
+// The integer part of 2^-log_bound, 0 if below one. 20 bits of the
+// fraction count, less a margin far above the rounding errors of the
+// logarithms.
+inline auto lower_bound_shift(double log_bound) -> MPi {
+    auto t = -log_bound - 1e-6;
+    auto ret = MPi(0);
+    if(t < 0) return ret;
+    auto e = std::floor(t);
+    mpz_set_d(ret.handle(), std::floor(std::exp2(t - e + 20)));
+    auto k = static_cast<long>(e) - 20;
+    if(k >= 0) mpz_mul_2exp(ret.handle(), ret.handle(), static_cast<mp_bitcnt_t>(k));
+    else mpz_fdiv_q_2exp(ret.handle(), ret.handle(), static_cast<mp_bitcnt_t>(-k));
+    return ret;
+}
+
+// p / x for p(0) = 0
+inline auto divided_by_x(const Poly& p) -> Poly {
+    return Poly(std::vector<MPi>(p.coefficients().begin() + 1, p.coefficients().end()));
+}
+
+// x^deg p(1/x)
+inline auto reversed(const Poly& p) -> Poly {
+    auto c = p.coefficients();
+    return Poly(std::vector<MPi>(c.rbegin(), c.rend()));
+}
+
+// f(-x)
+inline auto reflected(const Poly& f) -> Poly {
+    auto c = std::vector<MPi>(f.coefficients().begin(), f.coefficients().end());
+    for(std::size_t k = 1; k < c.size(); k += 2) c[k] = -c[k];
+    return Poly(std::move(c));
+}
+
+// The primitive part of f / gcd(f, f') with a positive leading
+// coefficient, f of degree at least one
+inline auto square_free_part(const Poly& f) -> Poly {
+    auto g = factor_impl::to_upoly(gcd(factor_impl::to_sparse(f), factor_impl::to_sparse(f.derivative())));
+    auto ret = f;
+    if(g.degree() > 0) ret = *divide_exact(f, g);
+    auto content = MPi(0);
+    for(const auto& c : ret.coefficients()) mpz_gcd(content.handle(), content.handle(), c.handle());
+    if(ret.leading_coefficient() < 0) content = -content;
+    std::vector<MPi> c(ret.coefficients().begin(), ret.coefficients().end());
+    for(auto& x : c) mpz_divexact(x.handle(), x.handle(), content.handle());
+    return Poly(std::move(c));
+}
+
+// A polynomial whose positive roots are those of f in the image of (0, inf)
+// under x -> (a x + b) / (c x + d), with a, b, c, d >= 0 and a d != b c,
+// and which does not vanish at 0
+struct Node {
+    Poly p;
+    MPi a;
+    MPi b;
+    MPi c;
+    MPi d;
+};
+
+// The roots of a square-free f with f(0) != 0 in (0, inf), by the
+// continued fraction method of Vincent, Collins and Akritas. A polynomial
+// with no sign change has no positive root and one with a single change
+// exactly one. Otherwise the polynomial is moved past a lower bound on its
+// roots and split into the parts for (1, inf), p(x + 1), and for (0, 1),
+// (x + 1)^n p(1 / (x + 1)). By Budan's theorem the second has no roots if
+// the first has as many sign changes as p, less one for a root at 1.
+inline auto isolate_positive(const Poly& f) -> std::vector<IsolatingInterval> {
+    std::vector<IsolatingInterval> ret;
+    auto bound = positive_root_bound(f.coefficients());
+    if(not bound) return ret;
+    // Closes the interval of the largest root
+    auto upper = power_of_two(static_cast<long>(std::ceil(*bound)) + 1);
+    auto exact = [&](const MPi& num, const MPi& denom){
+        auto x = Rational(num, denom);
+        ret.push_back({x, x});
+    };
+    auto isolated = [&](const Node& node){
+        auto x = Rational(node.b, node.d);
+        auto y = mpz_sgn(node.c.handle()) == 0 ? upper : Rational(node.a, node.c);
+        if(y < x) std::swap(x, y);
+        ret.push_back({std::move(x), std::move(y)});
+    };
+
+    std::vector<Node> stack;
+    stack.push_back({f, MPi(1), MPi(0), MPi(0), MPi(1)});
+    while(not stack.empty()){
+        auto node = std::move(stack.back());
+        stack.pop_back();
+        auto v = variations(node.p);
+        if(v == 0) continue;
+        if(v == 1){
+            isolated(node);
+            continue;
+        }
+
+        // Shift by the integer part of the lower bound, the inverse of the
+        // bound for the reversed polynomial
+        if(auto low = positive_root_bound(reversed(node.p).coefficients())){
+            auto s = lower_bound_shift(*low);
+            if(mpz_sgn(s.handle()) > 0){
+                node.p = taylor_shift(node.p, s);
+                node.b += node.a * s;
+                node.d += node.c * s;
+                if(mpz_sgn(node.p[0].handle()) == 0){
+                    exact(node.b, node.d);
+                    node.p = divided_by_x(node.p);
+                }
+                v = variations(node.p);
+                if(v == 0) continue;
+                if(v == 1){
+                    isolated(node);
+                    continue;
+                }
+            }
+        }
+
+        const auto& [p, a, b, c, d] = node;
+        auto right = taylor_shift(p, MPi(1));
+        auto at_one = mpz_sgn(right[0].handle()) == 0;
+        if(at_one){
+            exact(a + b, c + d);
+            right = divided_by_x(right);
+        }
+        if(variations(right) + (at_one ? 1 : 0) < v){
+            auto left = taylor_shift(reversed(p), MPi(1));
+            if(at_one) left = divided_by_x(left);
+            stack.push_back({std::move(left), b, a + b, d, c + d});
+        }
+        stack.push_back({std::move(right), a, a + b, c, c + d});
+    }
+    return ret;
+}
+
+// The sign of f at x, from the numerator of q^n f(p / q) by Horner's rule
+inline auto sign_at(const Poly& f, const Rational& x) -> int {
+    auto num = x.num(), denom = x.denom();
+    auto acc = MPi(0), q = MPi(1);
+    for(auto k = f.size(); k-- > 0;){
+        acc *= num;
+        mpz_addmul(acc.handle(), f[k].handle(), q.handle());
+        q *= denom;
+    }
+    return mpz_sgn(acc.handle());
+}
+
+} // namespace real_roots_impl
+
+// Narrows an isolating interval of a simple root of f by bisection until
+// it is no wider than 2^-precision, or the root is found exactly. The
+// endpoints may be roots of f themselves, the sign of f just inside is
+// then that of f' at the endpoint.
+inline auto refine(const UPoly<multiprecision::MPi>& f, IsolatingInterval interval, long precision) -> IsolatingInterval {
+    using namespace real_roots_impl;
+    if(interval.is_exact()) return interval;
+    auto& [lower, upper] = interval;
+    auto df = f.derivative();
+    auto low = sign_at(f, lower);
+    if(low == 0) low = sign_at(df, lower);
+    auto high = sign_at(f, upper);
+    if(high == 0) high = -sign_at(df, upper);
+    if(low == 0 || high == 0 || low == high) throw std::runtime_error("The interval does not isolate a simple root");
+    auto width = power_of_two(-precision);
+    while(upper - lower > width){
+        auto middle = (lower + upper) / Rational(2);
+        auto s = sign_at(f, middle);
+        if(s == 0) return {middle, middle};
+        if(s == low) lower = std::move(middle);
+        else upper = std::move(middle);
+    }
+    return interval;
+}
+
+// Isolating intervals of the distinct real roots of f != 0 in increasing
+// order. They are found for the square-free part of f, positive and
+// negative roots separately by the continued fraction method, whose
+// transformations are Taylor shifts. Long shifts are done by products
+// with powers of x + s, so that they take the asymptotically fast
+// multiplications of UPoly. The intervals are refined by bisection if
+// the options ask for a precision.
+inline auto real_roots(const UPoly<multiprecision::MPi>& f, RealRootOptions options = {}) -> std::vector<IsolatingInterval> {
+    using namespace real_roots_impl;
+    if(f.is_zero()) throw std::runtime_error("The real roots of the zero polynomial");
+    std::vector<IsolatingInterval> ret;
+    if(f.degree() < 1) return ret;
+    auto g = square_free_part(f);
+    if(mpz_sgn(g[0].handle()) == 0){
+        ret.push_back({Rational(0), Rational(0)});
+        g = divided_by_x(g);
+    }
+    if(g.degree() > 0){
+        for(auto& root : isolate_positive(g)) ret.push_back(std::move(root));
+        for(auto& [lower, upper] : isolate_positive(reflected(g))) ret.push_back({Rational(0) - upper, Rational(0) - lower});
+    }
+    // An exact root r comes before an interval (r, s) starting at it
+    std::ranges::sort(ret, [](const auto& x, const auto& y){
+        if(x.lower == y.lower) return x.upper < y.upper;
+        return x.lower < y.lower;
+    });
+    if(options.precision){
+        for(auto& root : ret) root = refine(g.degree() > 0 ? g : f, std::move(root), *options.precision);
+    }
+    return ret;
+}
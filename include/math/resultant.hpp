@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "modular.hpp"
+#include "mpi.hpp"
+#include "poly_gcd.hpp"
+#include "sparse_poly.hpp"
+#include "upoly.hpp"
+
+struct ResultantOptions {
+    // 0 selects std::thread::hardware_concurrency()
+    unsigned threads = 0;
+};
+
+namespace resultant_impl{
+
+using multiprecision::MPi;
+using poly_gcd_impl::Dense;
+using poly_gcd_impl::Exponents;
+using poly_gcd_impl::Terms;
+using poly_gcd_impl::Grouped;
+using modular::sub_mod;
+using modular::mul_mod;
+using modular::pow_mod;
+using modular::inverse_mod;
+
+// a / b for b known to divide a
+template<class C>
+auto quotient(const C& a, const C& b) -> C {
+    if constexpr(upoly_impl::is_mpi<C>){
+        auto ret = MPi();
+        mpz_divexact(ret.handle(), a.handle(), b.handle());
+        return ret;
+    }
+    else return a / b;
+}
+
+template<class C>
+auto power(const C& a, long e) -> C {
+    auto ret = C(1);
+    for(long k = 0; k < e; k++) ret *= a;
+    return ret;
+}
+
+// lc(b)^(deg a - deg b + 1) a mod b, for deg a >= deg b. Every step
+// scales the remainder by lc(b), so no division is needed.
+template<class C>
+auto pseudo_remainder(const UPoly<C>& a, const UPoly<C>& b) -> UPoly<C> {
+    auto r = std::vector<C>(a.coefficients().begin(), a.coefficients().end());
+    auto n = static_cast<std::size_t>(b.degree());
+    const auto& lc = b.leading_coefficient();
+    for(auto k = r.size(); k-- > n;){
+        auto top = r[k];
+        for(std::size_t i = 0; i < k; i++) r[i] *= lc;
+        for(std::size_t j = 0; j < n; j++) r[k - n + j] -= top * b[j];
+        r[k] = C(0);
+    }
+    return UPoly<C>(std::move(r));
+}
+
+// The state of a subresultant PRS: the last two members and the factors
+// g, h that the next pseudo-remainder is divided by.
+template<class C>
+struct Subresultants {
+    UPoly<C> a;
+    UPoly<C> b;
+    C g = C(1);
+    C h = C(1);
+
+    // Replaces (a, b) by (b, next member), false without changes once the
+    // pseudo-remainder is zero
+    auto step() -> bool {
+        auto delta = a.degree() - b.degree();
+        auto r = pseudo_remainder(a, b);
+        if(r.is_zero()) return false;
+        a = std::move(b);
+        b = divide_coefficients(r, g * power(h, delta));
+        g = a.leading_coefficient();
+        if(delta == 0) return true;
+        h = quotient(power(g, delta), power(h, delta - 1));
+        return true;
+    }
+
+    static auto divide_coefficients(const UPoly<C>& p, const C& c) -> UPoly<C> {
+        std::vector<C> ret;
+        for(const auto& x : p.coefficients()) ret.push_back(quotient(x, c));
+        return UPoly<C>(std::move(ret));
+    }
+};
+
+/* ***********************************************
+    Modular evaluation and interpolation
+************************************************** */
+
+// The resultant of polynomials over Z_p, by the Euclidean algorithm and
+// res(a, b) = (-1)^(deg a deg b) lc(b)^(deg a - deg r) res(b, r) for
+// r = a mod b
+inline auto resultant(Dense a, Dense b, std::uint64_t p) -> std::uint64_t {
+    if(a.empty() || b.empty()) return 0;
+    std::uint64_t ret = 1;
+    while(b.size() > 1){
+        auto r = poly_gcd_impl::divide(a, b, p).second;
+        if(r.empty()) return 0;
+        auto da = a.size() - 1, db = b.size() - 1, dr = r.size() - 1;
+        if(da % 2 == 1 && db % 2 == 1) ret = sub_mod(0, ret, p);
+        ret = mul_mod(ret, pow_mod(b.back(), da - dr, p), p);
+        a = std::move(b);
+        b = std::move(r);
+    }
+    return mul_mod(ret, pow_mod(b.back(), a.size() - 1, p), p);
+}
+
+// The terms of a modulo p
+inline auto reduce(const SparsePoly<MPi>& a, std::uint64_t p) -> Terms {
+    auto ret = Terms();
+    for(std::size_t i = 0; i < a.size(); i++){
+        if(auto c = mpz_fdiv_ui(a.coefficient(i).handle(), p); c != 0) ret.emplace_back(a.exponents(i), c);
+    }
+    return ret;
+}
+
+inline auto degree(const Terms& a, std::size_t v) -> long {
+    long ret = -1;
+    for(const auto& [e, c] : a) ret = std::max(ret, e[v]);
+    return ret;
+}
+
+// Replaces nonzero values in Montgomery form by their inverses, with a
+// single inversion
+inline void invert(std::vector<std::uint64_t>& values, const modular::Montgomery& mont) {
+    if(values.empty()) return;
+    std::vector<std::uint64_t> prefix(values.size());
+    prefix[0] = values[0];
+    for(std::size_t i = 1; i < values.size(); i++) prefix[i] = mont.mul(prefix[i - 1], values[i]);
+    // The plain inverse of a R is a^-1 R^-1, converting twice gives a^-1 R
+    auto u = mont.to(mont.to(inverse_mod(prefix.back(), mont.p)));
+    for(auto i = values.size(); i-- > 1;){
+        auto v = values[i];
+        values[i] = mont.mul(u, prefix[i - 1]);
+        u = mont.mul(u, v);
+    }
+    values[0] = u;
+}
+
+// The resultants in x of polynomials in x and the variables not yet
+// evaluated, of degrees n and m in x. The bounds are the degrees of the
+// resultant in each variable.
+struct Problem {
+    std::size_t x;
+    long n;
+    long m;
+    std::vector<long> bounds;
+    std::uint64_t p;
+
+    // a and b with the variable y evaluated at the first bound + 1 points
+    // that keep their degrees in x, and those points
+    auto evaluations(const Terms& a, const Terms& b, std::size_t y) const -> std::tuple<std::vector<Terms>, std::vector<Terms>, std::vector<std::uint64_t>> {
+        auto ga = poly_gcd_impl::group(a, y), gb = poly_gcd_impl::group(b, y);
+        std::vector<Terms> ea, eb;
+        std::vector<std::uint64_t> points;
+        for(std::uint64_t xi = 1; points.size() <= static_cast<std::size_t>(bounds[y]); xi++){
+            if(xi == p) throw std::runtime_error("Too few evaluation points modulo a prime");
+            auto va = poly_gcd_impl::evaluate(ga, xi, p), vb = poly_gcd_impl::evaluate(gb, xi, p);
+            if(degree(va, x) != n || degree(vb, x) != m) continue;
+            ea.push_back(std::move(va));
+            eb.push_back(std::move(vb));
+            points.push_back(xi);
+        }
+        return {std::move(ea), std::move(eb), std::move(points)};
+    }
+
+    // Evaluates the variables from the last of vars on, then interpolates
+    auto run(const Terms& a, const Terms& b, std::vector<std::size_t> vars) const -> Terms {
+        if(vars.empty()) return univariate(a, b);
+        auto y = vars.back();
+        vars.pop_back();
+        auto [ea, eb, points] = evaluations(a, b, y);
+        std::vector<Terms> values;
+        for(std::size_t i = 0; i < points.size(); i++) values.push_back(run(ea[i], eb[i], vars));
+        return interpolate(points, values, y);
+    }
+
+    auto univariate(const Terms& a, const Terms& b) const -> Terms {
+        auto dense = [&](const Terms& f){
+            auto ret = Dense(static_cast<std::size_t>(degree(f, x)) + 1, 0);
+            for(const auto& [e, c] : f) ret[static_cast<std::size_t>(e[x])] = c;
+            return ret;
+        };
+        auto r = resultant(dense(a), dense(b), p);
+        if(r == 0) return {};
+        return {{Exponents(a.front().first.size(), 0), r}};
+    }
+
+    // The polynomial in y through the values at the points, by Newton's
+    // divided differences for every monomial in the other variables
+    auto interpolate(const std::vector<std::uint64_t>& points, const std::vector<Terms>& values, std::size_t y) const -> Terms {
+        auto k = points.size();
+        // Constants in Montgomery form, their products with plain values
+        // are plain
+        auto mont = modular::Montgomery(p);
+        std::vector<std::vector<std::uint64_t>> inverse(k);
+        for(std::size_t j = 1; j < k; j++){
+            for(std::size_t i = j; i < k; i++) inverse[j].push_back(mont.to(sub_mod(points[i], points[i - j], p)));
+            invert(inverse[j], mont);
+        }
+        std::vector<std::uint64_t> shifts;
+        for(auto xi : points) shifts.push_back(mont.to(xi));
+        std::map<Exponents, std::vector<std::uint64_t>> samples;
+        for(std::size_t i = 0; i < k; i++){
+            for(const auto& [e, c] : values[i]){
+                auto& s = samples[e];
+                s.resize(k, 0);
+                s[i] = c;
+            }
+        }
+        auto ret = Terms();
+        for(auto& [key, f] : samples){
+            for(std::size_t j = 1; j < k; j++){
+                for(auto i = k - 1; i >= j; i--) f[i] = mont.mul(sub_mod(f[i], f[i - 1], p), inverse[j][i - j]);
+            }
+            auto poly = Dense{f[k - 1]};
+            for(auto j = k - 1; j-- > 0;){
+                // poly * (y - points[j]) + f[j]
+                poly.insert(poly.begin(), 0);
+                for(std::size_t i = 0; i + 1 < poly.size(); i++) poly[i] = sub_mod(poly[i], mont.mul(poly[i + 1], shifts[j]), p);
+                poly[0] = modular::add_mod(poly[0], f[j], p);
+            }
+            for(std::size_t d = 0; d < poly.size(); d++){
+                if(poly[d] == 0) continue;
+                auto e = key;
+                e[y] = static_cast<long>(d);
+                ret.emplace_back(std::move(e), poly[d]);
+            }
+        }
+        return ret;
+    }
+};
+
+// Bits of the sum of the absolute values of the coefficients
+inline auto norm_bits(const SparsePoly<MPi>& a) -> std::size_t {
+    auto sum = MPi(0);
+    for(std::size_t i = 0; i < a.size(); i++){
+        auto c = a.coefficient(i);
+        mpz_abs(c.handle(), c.handle());
+        mpz_add(sum.handle(), sum.handle(), c.handle());
+    }
+    return mpz_sizeinbase(sum.handle(), 2);
+}
+
+// The terms of a whose exponent of x is k, with it set to zero
+inline auto coefficient(const SparsePoly<MPi>& a, std::size_t x, long k) -> SparsePoly<MPi> {
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(std::size_t i = 0; i < a.size(); i++){
+        auto e = a.exponents(i);
+        if(e[x] != k) continue;
+        e[x] = 0;
+        terms.emplace_back(a.coefficient(i), std::move(e));
+    }
+    return SparsePoly<MPi>::from_terms(a.layout(), std::move(terms));
+}
+
+} // namespace resultant_impl
+
+/* ***********************************************
+    Univariate
+************************************************** */
+
+// The subresultant polynomial remainder sequence of Collins and Brown and
+// Traub: a, b and then pseudo-remainders divided by the factors that are
+// known to divide them, which keeps the coefficients to the size of the
+// subresultant determinants. Up to the last non-zero member, which is the
+// gcd up to a factor in C. Needs deg a >= deg b.
+template<class C>
+auto subresultant_prs(const UPoly<C>& a, const UPoly<C>& b) -> std::vector<UPoly<C>> {
+    if(a.degree() < b.degree()) throw std::runtime_error("The subresultant PRS needs deg a >= deg b");
+    std::vector<UPoly<C>> ret{a, b};
+    if(b.is_zero()){
+        ret.pop_back();
+        return ret;
+    }
+    auto s = resultant_impl::Subresultants<C>{a, b};
+    while(s.b.degree() > 0 && s.step()) ret.push_back(s.b);
+    return ret;
+}
+
+// The resultant, the determinant of the Sylvester matrix, from the
+// subresultant PRS (Cohen, algorithm 3.3.7). Over the integers the
+// contents are taken out first. Zero for a zero argument, and 1 for two
+// constants.
+template<class C>
+auto resultant(const UPoly<C>& a, const UPoly<C>& b) -> C {
+    using namespace resultant_impl;
+    if(a.is_zero() || b.is_zero()) return C(0);
+    if(a.degree() < b.degree()){
+        auto ret = resultant(b, a);
+        return a.degree() % 2 == 1 && b.degree() % 2 == 1 ? C(0) - ret : ret;
+    }
+    if(b.degree() == 0) return power(b.leading_coefficient(), a.degree());
+
+    auto s = Subresultants<C>{a, b};
+    auto t = C(1);
+    if constexpr(upoly_impl::is_mpi<C>){
+        auto content = [](const UPoly<C>& p){
+            auto ret = MPi(0);
+            for(const auto& c : p.coefficients()) mpz_gcd(ret.handle(), ret.handle(), c.handle());
+            return ret;
+        };
+        auto ca = content(a), cb = content(b);
+        s.a = Subresultants<C>::divide_coefficients(a, ca);
+        s.b = Subresultants<C>::divide_coefficients(b, cb);
+        t = power(ca, b.degree()) * power(cb, a.degree());
+    }
+    auto negate = false;
+    while(s.b.degree() > 0){
+        if(s.a.degree() % 2 == 1 && s.b.degree() % 2 == 1) negate = not negate;
+        if(not s.step()) return C(0);
+    }
+    auto n = s.a.degree();
+    auto h = quotient(power(s.b.leading_coefficient(), n), power(s.h, n - 1));
+    auto ret = t * h;
+    return negate ? C(0) - ret : ret;
+}
+
+// (-1)^(n(n-1)/2) res(a, a') / lc(a) for a of degree n >= 1
+template<class C>
+auto discriminant(const UPoly<C>& a) -> C {
+    if(a.degree() < 1) throw std::runtime_error("The discriminant needs a polynomial of positive degree");
+    auto n = a.degree();
+    auto ret = resultant_impl::quotient(resultant(a, a.derivative()), a.leading_coefficient());
+    return n * (n - 1) / 2 % 2 == 1 ? C(0) - ret : ret;
+}
+
+/* ***********************************************
+    Multivariate
+************************************************** */
+
+// The resultant of a and b in the variable x, a polynomial in the others.
+// It is computed modulo enough primes to recover coefficients up to the
+// bound |a|_1^deg b |b|_1^deg a, and modulo each prime by evaluating the
+// other variables at points that keep the degrees in x and interpolating,
+// as many points as the degree bound n deg_y b + m deg_y a of the
+// resultant in each variable y plus one. Primes and the points of the last
+// variable are spread over threads. Primes and points at which a leading
+// coefficient in x vanishes are skipped, so the result does not depend on
+// either choice.
+inline auto resultant(const SparsePoly<multiprecision::MPi>& a, const SparsePoly<multiprecision::MPi>& b, std::size_t x, ResultantOptions options = {}) -> SparsePoly<multiprecision::MPi> {
+    using namespace resultant_impl;
+    if(not (a.layout() == b.layout())) throw std::runtime_error("Polynomials over different monomial layouts");
+    const auto& layout = a.layout();
+    if(x >= layout.variables()) throw std::runtime_error(fmt::format("No variable {} in polynomials of {} variables", x, layout.variables()));
+    if(a.is_zero() || b.is_zero()) return SparsePoly<MPi>(layout);
+    auto n = a.degree(x), m = b.degree(x);
+    if(n == 0 || m == 0){
+        // The Sylvester matrix is diagonal
+        auto ret = SparsePoly<MPi>::constant(layout, MPi(1));
+        for(long k = 0; k < m; k++) ret *= a;
+        for(long k = 0; k < n; k++) ret *= b;
+        return ret;
+    }
+
+    auto nv = layout.variables();
+    auto problem = Problem{x, n, m, std::vector<long>(nv, 0), 0};
+    std::vector<std::size_t> vars;
+    for(std::size_t y = 0; y < nv; y++){
+        if(y == x) continue;
+        problem.bounds[y] = n * std::max(b.degree(y), 0l) + m * std::max(a.degree(y), 0l);
+        if(problem.bounds[y] > 0) vars.push_back(y);
+    }
+
+    // Primes whose product exceeds twice the coefficient bound
+    auto bits = static_cast<std::size_t>(m) * norm_bits(a) + static_cast<std::size_t>(n) * norm_bits(b) + 2;
+    auto lca = coefficient(a, x, n), lcb = coefficient(b, x, m);
+    auto rng = std::mt19937_64(0);
+    std::vector<std::uint64_t> primes;
+    for(std::size_t covered = 0; covered < bits;){
+        auto p = modular::random_prime(rng);
+        if(reduce(lca, p).empty() || reduce(lcb, p).empty()) continue;
+        primes.push_back(p);
+        covered += 62;
+    }
+
+    // The jobs are the primes, or the points of the last variable for each
+    struct Image {
+        Problem problem;
+        std::vector<Terms> a;
+        std::vector<Terms> b;
+        std::vector<std::uint64_t> points;
+        std::vector<Terms> values;
+    };
+    std::vector<Image> images;
+    std::vector<std::pair<std::size_t, std::size_t>> jobs;
+    auto last = vars.empty() ? std::optional<std::size_t>() : std::optional(vars.back());
+    if(last) vars.pop_back();
+    for(auto p : primes){
+        auto image = Image{problem, {}, {}, {}, {}};
+        image.problem.p = p;
+        auto ra = reduce(a, p), rb = reduce(b, p);
+        if(last) std::tie(image.a, image.b, image.points) = image.problem.evaluations(ra, rb, *last);
+        else{
+            image.a.push_back(std::move(ra));
+            image.b.push_back(std::move(rb));
+        }
+        image.values.resize(image.a.size());
+        for(std::size_t i = 0; i < image.a.size(); i++) jobs.emplace_back(images.size(), i);
+        images.push_back(std::move(image));
+    }
+    auto threads = options.threads != 0 ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, jobs.size()));
+    std::atomic<std::size_t> next_job = 0;
+    auto worker = [&]{
+        for(auto k = next_job++; k < jobs.size(); k = next_job++){
+            auto [i, j] = jobs[k];
+            auto& image = images[i];
+            image.values[j] = image.problem.run(image.a[j], image.b[j], vars);
+        }
+    };
+    std::vector<std::jthread> pool;
+    for(unsigned t = 1; t < threads; t++){
+        pool.emplace_back(worker);
+    }
+    worker();
+    pool.clear();
+
+    // Chinese remaindering to the symmetric representatives
+    std::map<Exponents, MPi> lifted;
+    auto modulus = MPi(1);
+    for(auto& image : images){
+        auto p = image.problem.p;
+        auto terms = last ? image.problem.interpolate(image.points, image.values, *last) : std::move(image.values.front());
+        auto residues = std::map<Exponents, std::uint64_t>(terms.begin(), terms.end());
+        for(const auto& [e, c] : residues) lifted.try_emplace(e, MPi(0));
+        auto u = inverse_mod(mpz_fdiv_ui(modulus.handle(), p), p);
+        for(auto& [e, h] : lifted){
+            auto it = residues.find(e);
+            auto target = it == residues.end() ? 0 : it->second;
+            auto delta = mul_mod(sub_mod(target, mpz_fdiv_ui(h.handle(), p), p), u, p);
+            mpz_addmul_ui(h.handle(), modulus.handle(), delta);
+        }
+        mpz_mul_ui(modulus.handle(), modulus.handle(), p);
+    }
+    auto half = MPi();
+    mpz_fdiv_q_2exp(half.handle(), modulus.handle(), 1);
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(auto& [e, h] : lifted){
+        if(mpz_cmp(h.handle(), half.handle()) > 0) mpz_sub(h.handle(), h.handle(), modulus.handle());
+        if(mpz_sgn(h.handle()) != 0) terms.emplace_back(std::move(h), e);
+    }
+    return SparsePoly<MPi>::from_terms(layout, std::move(terms));
+}
+
+// (-1)^(n(n-1)/2) res(a, da/dx) / lc(a) in the variable x, of degree n >= 1
+// in it, the leading coefficient being a polynomial in the others
+inline auto discriminant(const SparsePoly<multiprecision::MPi>& a, std::size_t x, ResultantOptions options = {}) -> SparsePoly<multiprecision::MPi> {
+    using namespace resultant_impl;
+    auto n = a.degree(x);
+    if(n < 1) throw std::runtime_error("The discriminant needs a polynomial of positive degree");
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(std::size_t i = 0; i < a.size(); i++){
+        auto e = a.exponents(i);
+        if(e[x] == 0) continue;
+        auto c = a.coefficient(i) * MPi(e[x]);
+        e[x]--;
+        terms.emplace_back(std::move(c), std::move(e));
+    }
+    auto derivative = SparsePoly<MPi>::from_terms(a.layout(), std::move(terms));
+    auto ret = divide_exact(resultant(a, derivative, x, options), coefficient(a, x, n));
+    if(not ret) throw std::runtime_error("The leading coefficient does not divide the resultant");
+    return n * (n - 1) / 2 % 2 == 1 ? -*ret : *ret;
+}
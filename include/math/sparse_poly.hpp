@@ -0,0 +1,904 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "math_functions.hpp"
+#include "mpi.hpp"
+#include "rational.hpp"
+
+enum class MonomialOrder : std::uint8_t {
+    Lex,
+    Grlex,
+    Grevlex
+};
+
+// Exponent vectors packed into 64 bit words, such that comparing the words
+// lexicographically compares the monomials in the chosen order:
+//     Lex      fields e_1, ..., e_n
+//     Grlex    fields deg, e_1, ..., e_n
+//     Grevlex  fields deg, S_{n-1}, ..., S_1 with S_k = e_1 + ... + e_k
+// All fields are linear in the exponents, so monomials multiply by adding
+// words and divide by subtracting them. The top bit of every field is kept
+// clear as a guard, it catches overflows and makes a field-wise comparison
+// a single subtraction per word.
+class MonomialLayout {
+public:
+    MonomialLayout(std::size_t _variables = 0, MonomialOrder _order = MonomialOrder::Lex, unsigned _bits = 16)
+        : m_variables{_variables}, m_order{_order}, m_bits{_bits}
+    {
+        if(m_bits != 8 && m_bits != 16 && m_bits != 32){
+            throw std::runtime_error(fmt::format("Unsupported exponent width of {} bits", m_bits));
+        }
+        m_fields = m_order == MonomialOrder::Grlex ? m_variables + 1 : m_variables;
+        m_per_word = 64 / m_bits;
+        m_words = std::max<std::size_t>(1, (m_fields + m_per_word - 1) / m_per_word);
+        auto field_guard = std::uint64_t{1} << (m_bits - 1);
+        for(std::size_t k = 0; k < m_per_word; k++) m_guard |= field_guard << (k * m_bits);
+    }
+
+    auto variables() const { return m_variables; }
+    auto order() const { return m_order; }
+    auto bits() const { return m_bits; }
+    auto words() const { return m_words; }
+    auto max_degree() const -> long { return (long{1} << (m_bits - 1)) - 1; }
+
+    friend auto operator==(const MonomialLayout& lhs, const MonomialLayout& rhs) -> bool {
+        return lhs.m_variables == rhs.m_variables && lhs.m_order == rhs.m_order && lhs.m_bits == rhs.m_bits;
+    }
+
+    void pack(std::span<const long> e, std::uint64_t* out) const {
+        std::fill_n(out, m_words, 0);
+        long degree = 0;
+        for(auto x : e){
+            if(x < 0) throw std::runtime_error("Negative exponent in a polynomial");
+            degree += x;
+        }
+        if(degree > max_degree()){
+            throw std::runtime_error(fmt::format("Degree {} exceeds the {} bit exponent fields", degree, m_bits));
+        }
+        switch(m_order){
+        case MonomialOrder::Lex:
+            for(std::size_t k = 0; k < m_variables; k++) set_field(out, k, e[k]);
+            break;
+        case MonomialOrder::Grlex:
+            set_field(out, 0, degree);
+            for(std::size_t k = 0; k < m_variables; k++) set_field(out, k + 1, e[k]);
+            break;
+        case MonomialOrder::Grevlex: {
+            auto s = degree;
+            for(std::size_t k = 0; k < m_variables; k++){
+                set_field(out, k, s);
+                s -= e[m_variables - 1 - k];
+            }
+            break;
+        }
+        }
+    }
+
+    void unpack(const std::uint64_t* m, std::span<long> e) const {
+        switch(m_order){
+        case MonomialOrder::Lex:
+            for(std::size_t k = 0; k < m_variables; k++) e[k] = field(m, k);
+            break;
+        case MonomialOrder::Grlex:
+            for(std::size_t k = 0; k < m_variables; k++) e[k] = field(m, k + 1);
+            break;
+        case MonomialOrder::Grevlex:
+            for(std::size_t k = 0; k < m_variables; k++){
+                auto next = k + 1 < m_variables ? field(m, k + 1) : 0;
+                e[m_variables - 1 - k] = field(m, k) - next;
+            }
+            break;
+        }
+    }
+
+    auto unpack(const std::uint64_t* m) const -> std::vector<long> {
+        std::vector<long> ret(m_variables);
+        unpack(m, ret);
+        return ret;
+    }
+
+    auto degree(const std::uint64_t* m) const -> long {
+        if(m_variables == 0) return 0;
+        if(m_order != MonomialOrder::Lex) return field(m, 0);
+        long ret = 0;
+        for(std::size_t k = 0; k < m_variables; k++) ret += field(m, k);
+        return ret;
+    }
+
+    auto degree(const std::uint64_t* m, std::size_t variable) const -> long {
+        switch(m_order){
+        case MonomialOrder::Lex: return field(m, variable);
+        case MonomialOrder::Grlex: return field(m, variable + 1);
+        case MonomialOrder::Grevlex: {
+            auto k = m_variables - 1 - variable;
+            return field(m, k) - (k + 1 < m_variables ? field(m, k + 1) : 0);
+        }
+        }
+        return 0;
+    }
+
+    auto compare(const std::uint64_t* a, const std::uint64_t* b) const -> std::strong_ordering {
+        for(std::size_t k = 0; k < m_words; k++){
+            if(a[k] != b[k]) return a[k] <=> b[k];
+        }
+        return std::strong_ordering::equal;
+    }
+
+    auto equal(const std::uint64_t* a, const std::uint64_t* b) const -> bool {
+        return std::equal(a, a + m_words, b);
+    }
+
+    // out = a * b, returns false if an exponent overflowed
+    auto multiply(const std::uint64_t* a, const std::uint64_t* b, std::uint64_t* out) const -> bool {
+        std::uint64_t overflow = 0;
+        for(std::size_t k = 0; k < m_words; k++){
+            out[k] = a[k] + b[k];
+            overflow |= out[k];
+        }
+        return (overflow & m_guard) == 0;
+    }
+
+    // out = a^k, returns false if an exponent overflowed
+    auto power(const std::uint64_t* a, long k, std::uint64_t* out) const -> bool {
+        if(k < 0 || degree(a) * k > max_degree()) return false;
+        for(std::size_t i = 0; i < m_words; i++) out[i] = a[i] * static_cast<std::uint64_t>(k);
+        return true;
+    }
+
+    // Whether b divides a
+    auto divides(const std::uint64_t* b, const std::uint64_t* a) const -> bool {
+        if(m_order == MonomialOrder::Grevlex){
+            for(std::size_t k = 0; k < m_variables; k++){
+                if(degree(b, k) > degree(a, k)) return false;
+            }
+            return true;
+        }
+        // A field of a - b borrows from its guard bit iff it is negative
+        for(std::size_t k = 0; k < m_words; k++){
+            if((((a[k] | m_guard) - b[k]) & m_guard) != m_guard) return false;
+        }
+        return true;
+    }
+
+    // out = a / b, b has to divide a
+    void divide(const std::uint64_t* a, const std::uint64_t* b, std::uint64_t* out) const {
+        for(std::size_t k = 0; k < m_words; k++) out[k] = a[k] - b[k];
+    }
+
+private:
+    auto shift(std::size_t k) const { return static_cast<unsigned>(m_bits * (m_per_word - 1 - k % m_per_word)); }
+    auto mask() const { return (std::uint64_t{1} << m_bits) - 1; }
+
+    auto field(const std::uint64_t* m, std::size_t k) const -> long {
+        return static_cast<long>((m[k / m_per_word] >> shift(k)) & mask());
+    }
+
+    void set_field(std::uint64_t* m, std::size_t k, long v) const {
+        m[k / m_per_word] |= static_cast<std::uint64_t>(v) << shift(k);
+    }
+
+    std::size_t m_variables;
+    MonomialOrder m_order;
+    unsigned m_bits;
+    std::size_t m_fields = 0;
+    std::size_t m_per_word = 0;
+    std::size_t m_words = 0;
+    std::uint64_t m_guard = 0;
+};
+
+namespace sparse_poly_impl{
+
+// Whether b divides a in the coefficient ring
+template<class C>
+auto coefficient_divides(const C& b, const C& a) -> bool {
+    if constexpr(std::same_as<C, multiprecision::MPi>) return mpz_divisible_p(a.handle(), b.handle()) != 0;
+    else return b != 0;
+}
+
+// acc += a * b and acc -= a * b, without a temporary for MPi
+template<class C>
+void add_product(C& acc, const C& a, const C& b) {
+    if constexpr(std::same_as<C, multiprecision::MPi>) mpz_addmul(acc.handle(), a.handle(), b.handle());
+    else acc += a * b;
+}
+
+template<class C>
+void sub_product(C& acc, const C& a, const C& b) {
+    if constexpr(std::same_as<C, multiprecision::MPi>) mpz_submul(acc.handle(), a.handle(), b.handle());
+    else acc -= a * b;
+}
+
+} // namespace sparse_poly_impl
+
+struct MultiplyOptions {
+    // 0 selects std::thread::hardware_concurrency()
+    unsigned threads = 0;
+    // Number of term pairs each thread has to be given at least
+    std::size_t pairs_per_thread = std::size_t{1} << 16;
+    // Largest dense array used for the Kronecker substitution, 0 disables it
+    std::size_t dense_limit = std::size_t{1} << 22;
+};
+
+// A polynomial in layout.variables() variables over the coefficient ring C,
+// MPi or FieldOfFractions<MPi>. Terms are kept sorted in decreasing
+// monomial order with non-zero coefficients, so the leading term comes
+// first and equal polynomials have equal representations.
+template<class C>
+class SparsePoly {
+public:
+    using Coefficient = C;
+
+    explicit SparsePoly(MonomialLayout _layout = {})
+        : m_layout{_layout}
+    {}
+
+    static auto constant(MonomialLayout layout, C c) -> SparsePoly {
+        auto ret = SparsePoly(layout);
+        if(c != 0){
+            std::vector<std::uint64_t> m(layout.words(), 0);
+            ret.push_back(std::move(c), m.data());
+        }
+        return ret;
+    }
+
+    static auto variable(MonomialLayout layout, std::size_t k) -> SparsePoly {
+        std::vector<long> e(layout.variables(), 0);
+        e.at(k) = 1;
+        return monomial(layout, C(1), e);
+    }
+
+    static auto monomial(MonomialLayout layout, C c, std::span<const long> e) -> SparsePoly {
+        auto ret = SparsePoly(layout);
+        if(c != 0){
+            std::vector<std::uint64_t> m(layout.words());
+            layout.pack(e, m.data());
+            ret.push_back(std::move(c), m.data());
+        }
+        return ret;
+    }
+
+    // Collects terms given in any order, combining equal monomials
+    static auto from_terms(MonomialLayout layout, std::vector<std::pair<C, std::vector<long>>> terms) -> SparsePoly {
+        auto w = layout.words();
+        std::vector<std::uint64_t> packed(terms.size() * w);
+        std::vector<std::size_t> index(terms.size());
+        for(std::size_t i = 0; i < terms.size(); i++){
+            layout.pack(terms[i].second, packed.data() + i * w);
+            index[i] = i;
+        }
+        std::ranges::sort(index, [&](std::size_t i, std::size_t j){
+            return layout.compare(packed.data() + i * w, packed.data() + j * w) > 0;
+        });
+        auto ret = SparsePoly(layout);
+        for(std::size_t k = 0; k < index.size();){
+            auto c = terms[index[k]].first;
+            auto m = packed.data() + index[k] * w;
+            for(k++; k < index.size() && layout.equal(m, packed.data() + index[k] * w); k++){
+                c += terms[index[k]].first;
+            }
+            if(c != 0) ret.push_back(std::move(c), m);
+        }
+        return ret;
+    }
+
+    auto layout() const -> const MonomialLayout& { return m_layout; }
+    auto size() const { return m_coeffs.size(); }
+    auto is_zero() const { return m_coeffs.empty(); }
+
+    auto coefficient(std::size_t i) const -> const C& { return m_coeffs[i]; }
+    auto monomial(std::size_t i) const -> const std::uint64_t* { return m_monomials.data() + i * m_layout.words(); }
+    auto exponents(std::size_t i) const { return m_layout.unpack(monomial(i)); }
+
+    auto leading_coefficient() const -> const C& { return m_coeffs.front(); }
+    auto leading_monomial() const { return monomial(0); }
+
+    // Total degree, -1 for the zero polynomial
+    auto degree() const -> long {
+        long ret = -1;
+        for(std::size_t i = 0; i < size(); i++) ret = std::max(ret, m_layout.degree(monomial(i)));
+        return ret;
+    }
+
+    auto degree(std::size_t variable) const -> long {
+        long ret = -1;
+        for(std::size_t i = 0; i < size(); i++) ret = std::max(ret, m_layout.degree(monomial(i), variable));
+        return ret;
+    }
+
+    // Appends a term below all present ones, the caller keeps the order
+    void push_back(C c, const std::uint64_t* m) {
+        m_coeffs.push_back(std::move(c));
+        m_monomials.insert(m_monomials.end(), m, m + m_layout.words());
+    }
+
+    void reserve(std::size_t n) {
+        m_coeffs.reserve(n);
+        m_monomials.reserve(n * m_layout.words());
+    }
+
+    /* ***********************************************
+        Arithmetic
+    ************************************************** */
+
+    auto operator-() const -> SparsePoly {
+        auto ret = *this;
+        for(auto& c : ret.m_coeffs) c = C(0) - c;
+        return ret;
+    }
+
+    friend auto operator+(const SparsePoly& a, const SparsePoly& b) -> SparsePoly { return merge(a, b, false); }
+    friend auto operator-(const SparsePoly& a, const SparsePoly& b) -> SparsePoly { return merge(a, b, true); }
+
+    friend auto operator*(const SparsePoly& a, const C& c) -> SparsePoly {
+        if(c == 0) return SparsePoly(a.m_layout);
+        auto ret = a;
+        for(auto& x : ret.m_coeffs) x *= c;
+        return ret;
+    }
+
+    friend auto operator*(const C& c, const SparsePoly& a) -> SparsePoly { return a * c; }
+
+    friend auto operator*(const SparsePoly& a, const SparsePoly& b) -> SparsePoly { return multiply(a, b); }
+
+    // The product on several threads. Dense operands, whose product fills a
+    // good part of the box spanned by the degrees, are multiplied in an
+    // array indexed by Kronecker substitution, with the threads owning
+    // blocks of it. Otherwise the output is cut into monomial ranges at
+    // sampled products and every thread runs the heap multiplication on
+    // its range. Both ways every coefficient is summed in the same order
+    // whatever the number of threads, the result never depends on it.
+    friend auto multiply(const SparsePoly& a, const SparsePoly& b, MultiplyOptions options = {}) -> SparsePoly {
+        check_layouts(a, b);
+        if(a.size() > b.size()) return multiply(b, a, options);
+        if(a.is_zero() || b.is_zero()) return SparsePoly(a.m_layout);
+        if(a.degree() + b.degree() > a.m_layout.max_degree()){
+            throw std::runtime_error(fmt::format("Product exceeds the {} bit exponent fields", a.m_layout.bits()));
+        }
+        auto pairs = a.size() * b.size();
+        auto threads = options.threads != 0 ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+        threads = static_cast<unsigned>(std::clamp<std::size_t>(pairs / std::max<std::size_t>(options.pairs_per_thread, 1), 1, threads));
+
+        auto box = kronecker_box(a, b, std::min(options.dense_limit, pairs));
+        if(not box.empty()) return multiply_dense(a, b, box, threads);
+        if(threads == 1) return multiply_heap(a, b);
+        return multiply_parallel(a, b, threads);
+    }
+
+    auto operator+=(const SparsePoly& other) -> SparsePoly& { return *this = *this + other; }
+    auto operator-=(const SparsePoly& other) -> SparsePoly& { return *this = *this - other; }
+    auto operator*=(const SparsePoly& other) -> SparsePoly& { return *this = *this * other; }
+
+    friend auto operator==(const SparsePoly& a, const SparsePoly& b) -> bool {
+        return a.m_layout == b.m_layout && a.m_monomials == b.m_monomials
+            && std::ranges::equal(a.m_coeffs, b.m_coeffs, [](const C& x, const C& y){ return (x <=> y) == 0; });
+    }
+
+    // Multivariate division with remainder by a single divisor: a = q*b + r
+    // where no term of r is divisible by the leading term of b. Over the
+    // integers a term is only divisible if its coefficient is as well.
+    //
+    // The terms of a - q*b are generated in decreasing order by a heap
+    // holding one stream q_k * (b - lt(b)) per quotient term, as in the
+    // multiplication. Every term leaving it either yields the next quotient
+    // term, which opens a new stream, or goes to the remainder.
+    friend auto divide(const SparsePoly& a, const SparsePoly& b) -> std::pair<SparsePoly, SparsePoly> {
+        using sparse_poly_impl::coefficient_divides;
+        check_layouts(a, b);
+        if(b.is_zero()) throw std::runtime_error("Division by the zero polynomial");
+        const auto& layout = a.m_layout;
+        auto w = layout.words();
+        auto q = SparsePoly(layout);
+        auto r = SparsePoly(layout);
+
+        std::vector<std::uint64_t> keys;
+        std::vector<std::size_t> next;
+        std::vector<std::size_t> heap;
+        auto key = [&](std::size_t k){ return keys.data() + k * w; };
+        auto less = [&](std::size_t i, std::size_t j){ return layout.compare(key(i), key(j)) < 0; };
+        auto insert = [&](std::size_t k){
+            if(not layout.multiply(q.monomial(k), b.monomial(next[k]), key(k))){
+                throw std::runtime_error(fmt::format("Quotient exceeds the {} bit exponent fields", layout.bits()));
+            }
+            heap.push_back(k);
+            std::ranges::push_heap(heap, less);
+        };
+
+        std::size_t i = 0;
+        std::vector<std::uint64_t> current(w), m(w);
+        while(i < a.size() || not heap.empty()){
+            auto from_a = heap.empty() || (i < a.size() && layout.compare(a.monomial(i), key(heap.front())) >= 0);
+            std::copy_n(from_a ? a.monomial(i) : key(heap.front()), w, current.data());
+            auto c = C(0);
+            if(i < a.size() && layout.equal(a.monomial(i), current.data())) c = a.m_coeffs[i++];
+            while(not heap.empty() && layout.equal(key(heap.front()), current.data())){
+                std::ranges::pop_heap(heap, less);
+                auto k = heap.back();
+                heap.pop_back();
+                sparse_poly_impl::sub_product(c, q.m_coeffs[k], b.m_coeffs[next[k]]);
+                if(++next[k] < b.size()) insert(k);
+            }
+            if(c == 0) continue;
+            if(layout.divides(b.leading_monomial(), current.data()) && coefficient_divides(b.leading_coefficient(), c)){
+                layout.divide(current.data(), b.leading_monomial(), m.data());
+                q.push_back(c / b.leading_coefficient(), m.data());
+                if(b.size() > 1){
+                    next.push_back(1);
+                    keys.resize(q.size() * w);
+                    insert(q.size() - 1);
+                }
+            }
+            else{
+                r.push_back(std::move(c), current.data());
+            }
+        }
+        return {std::move(q), std::move(r)};
+    }
+
+    // a / b if b divides a, nothing otherwise
+    friend auto divide_exact(const SparsePoly& a, const SparsePoly& b) -> std::optional<SparsePoly> {
+        auto [q, r] = divide(a, b);
+        if(not r.is_zero()) return {};
+        return std::move(q);
+    }
+
+    // The value at a point, powers of each variable are computed once
+    auto evaluate(std::span<const C> point) const -> C {
+        if(point.size() != m_layout.variables()){
+            throw std::runtime_error(fmt::format("Expected {} values, got {}", m_layout.variables(), point.size()));
+        }
+        std::vector<std::vector<C>> powers(point.size());
+        for(std::size_t k = 0; k < point.size(); k++){
+            auto d = degree(k);
+            powers[k].push_back(C(1));
+            for(long j = 1; j <= d; j++) powers[k].push_back(powers[k].back() * point[k]);
+        }
+        auto ret = C(0);
+        std::vector<long> e(m_layout.variables());
+        for(std::size_t i = 0; i < size(); i++){
+            m_layout.unpack(monomial(i), e);
+            auto t = m_coeffs[i];
+            for(std::size_t k = 0; k < e.size(); k++){
+                if(e[k] != 0) t *= powers[k][static_cast<std::size_t>(e[k])];
+            }
+            ret += t;
+        }
+        return ret;
+    }
+
+private:
+    static void check_layouts(const SparsePoly& a, const SparsePoly& b) {
+        if(not (a.m_layout == b.m_layout)) throw std::runtime_error("Polynomials over different monomial layouts");
+    }
+
+    // Johnson's algorithm: the products a_i * b_j are generated in
+    // decreasing order from a heap holding one candidate per term of a,
+    // equal monomials are combined as they leave the heap.
+    static auto multiply_heap(const SparsePoly& a, const SparsePoly& b) -> SparsePoly {
+        const auto& layout = a.m_layout;
+        auto ret = SparsePoly(layout);
+
+        auto w = layout.words();
+        std::vector<std::uint64_t> keys(a.size() * w);
+        std::vector<std::size_t> next(a.size(), 0);
+        std::vector<std::size_t> heap;
+        auto key = [&](std::size_t i){ return keys.data() + i * w; };
+        auto less = [&](std::size_t i, std::size_t j){ return layout.compare(key(i), key(j)) < 0; };
+        auto insert = [&](std::size_t i){
+            layout.multiply(a.monomial(i), b.monomial(next[i]), key(i));
+            heap.push_back(i);
+            std::ranges::push_heap(heap, less);
+        };
+
+        insert(0);
+        std::vector<std::uint64_t> current(w);
+        while(not heap.empty()){
+            std::copy_n(key(heap.front()), w, current.data());
+            auto c = C(0);
+            while(not heap.empty() && layout.equal(key(heap.front()), current.data())){
+                std::ranges::pop_heap(heap, less);
+                auto i = heap.back();
+                heap.pop_back();
+                sparse_poly_impl::add_product(c, a.m_coeffs[i], b.m_coeffs[next[i]]);
+                // Row i+1 starts once row i has produced its first product,
+                // this keeps the heap no larger than the number of live rows.
+                if(next[i] == 0 && i + 1 < a.size()) insert(i + 1);
+                if(++next[i] < b.size()) insert(i);
+            }
+            if(c != 0) ret.push_back(std::move(c), current.data());
+        }
+        return ret;
+    }
+
+    // The terms of a * b with monomials m in lower <= m < upper, a missing
+    // bound is unbounded. Row i covers a_i * b_j for j in [start_i, end_i),
+    // all rows are in the heap from the start as the ranges of successive
+    // rows are not ordered.
+    static auto multiply_range(const SparsePoly& a, const SparsePoly& b, const std::uint64_t* upper, const std::uint64_t* lower) -> SparsePoly {
+        const auto& layout = a.m_layout;
+        auto w = layout.words();
+        std::vector<std::uint64_t> keys(a.size() * w);
+        std::vector<std::size_t> next(a.size()), end(a.size());
+        auto key = [&](std::size_t i){ return keys.data() + i * w; };
+        // The first j with a_i * b_j < bound, the products decrease with j
+        auto first_below = [&](std::size_t i, const std::uint64_t* bound){
+            if(bound == nullptr) return b.size();
+            std::size_t lo = 0, hi = b.size();
+            while(lo < hi){
+                auto mid = (lo + hi) / 2;
+                layout.multiply(a.monomial(i), b.monomial(mid), key(i));
+                if(layout.compare(key(i), bound) >= 0) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        };
+
+        std::vector<std::size_t> heap;
+        auto less = [&](std::size_t i, std::size_t j){ return layout.compare(key(i), key(j)) < 0; };
+        auto insert = [&](std::size_t i){
+            layout.multiply(a.monomial(i), b.monomial(next[i]), key(i));
+            heap.push_back(i);
+            std::ranges::push_heap(heap, less);
+        };
+        for(std::size_t i = 0; i < a.size(); i++){
+            next[i] = upper == nullptr ? 0 : first_below(i, upper);
+            end[i] = first_below(i, lower);
+            if(next[i] < end[i]) insert(i);
+        }
+
+        auto ret = SparsePoly(layout);
+        std::vector<std::uint64_t> current(w);
+        while(not heap.empty()){
+            std::copy_n(key(heap.front()), w, current.data());
+            auto c = C(0);
+            while(not heap.empty() && layout.equal(key(heap.front()), current.data())){
+                std::ranges::pop_heap(heap, less);
+                auto i = heap.back();
+                heap.pop_back();
+                sparse_poly_impl::add_product(c, a.m_coeffs[i], b.m_coeffs[next[i]]);
+                if(++next[i] < end[i]) insert(i);
+            }
+            if(c != 0) ret.push_back(std::move(c), current.data());
+        }
+        return ret;
+    }
+
+    static auto multiply_parallel(const SparsePoly& a, const SparsePoly& b, unsigned threads) -> SparsePoly {
+        const auto& layout = a.m_layout;
+        auto w = layout.words();
+        // Cut points at quantiles of a sample of the products, a fixed seed
+        // keeps the partition and with it the timing reproducible.
+        auto samples = std::size_t{32} * threads;
+        std::vector<std::uint64_t> sample(samples * w);
+        auto rng = std::mt19937_64(0);
+        for(std::size_t k = 0; k < samples; k++){
+            layout.multiply(a.monomial(rng() % a.size()), b.monomial(rng() % b.size()), sample.data() + k * w);
+        }
+        std::vector<std::size_t> order(samples);
+        for(std::size_t k = 0; k < samples; k++) order[k] = k;
+        std::ranges::sort(order, [&](std::size_t i, std::size_t j){
+            return layout.compare(sample.data() + i * w, sample.data() + j * w) > 0;
+        });
+        std::vector<const std::uint64_t*> cuts;
+        for(unsigned t = 1; t < threads; t++){
+            auto m = sample.data() + order[t * samples / threads] * w;
+            if(cuts.empty() || layout.compare(cuts.back(), m) > 0) cuts.push_back(m);
+        }
+
+        auto ranges = cuts.size() + 1;
+        std::vector<SparsePoly> parts(ranges);
+        auto worker = [&](std::size_t t){
+            for(; t < ranges; t += threads){
+                auto upper = t == 0 ? nullptr : cuts[t - 1];
+                auto lower = t + 1 == ranges ? nullptr : cuts[t];
+                parts[t] = multiply_range(a, b, upper, lower);
+            }
+        };
+        std::vector<std::jthread> pool;
+        for(unsigned t = 1; t < threads; t++){
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        pool.clear();
+
+        auto ret = SparsePoly(layout);
+        std::size_t total = 0;
+        for(const auto& part : parts) total += part.size();
+        ret.reserve(total);
+        for(auto& part : parts){
+            std::ranges::move(part.m_coeffs, std::back_inserter(ret.m_coeffs));
+            ret.m_monomials.insert(ret.m_monomials.end(), part.m_monomials.begin(), part.m_monomials.end());
+        }
+        return ret;
+    }
+
+    // The extent D_k = deg_k(a) + deg_k(b) + 1 of the product in every
+    // variable, or nothing if the box holds more than limit monomials
+    static auto kronecker_box(const SparsePoly& a, const SparsePoly& b, std::size_t limit) -> std::vector<std::size_t> {
+        auto n = a.m_layout.variables();
+        std::vector<std::size_t> box(n);
+        std::size_t size = 1;
+        for(std::size_t k = 0; k < n; k++){
+            box[k] = static_cast<std::size_t>(a.degree(k) + b.degree(k) + 1);
+            if(box[k] > limit / size) return {};
+            size *= box[k];
+        }
+        return box;
+    }
+
+    // x_k -> t^(D_{k+1} * ... * D_n) maps the product to a univariate one
+    // without carries, whose coefficients are accumulated in an array.
+    // As the first variable is the most significant digit the array is in
+    // lex order, other orders are sorted once at the end.
+    static auto multiply_dense(const SparsePoly& a, const SparsePoly& b, const std::vector<std::size_t>& box, unsigned threads) -> SparsePoly {
+        const auto& layout = a.m_layout;
+        auto n = layout.variables();
+        std::vector<std::size_t> stride(n);
+        std::size_t size = 1;
+        for(std::size_t k = n; k-- > 0;){
+            stride[k] = size;
+            size *= box[k];
+        }
+        std::vector<long> e(n);
+        auto index = [&](const SparsePoly& p, std::size_t i){
+            layout.unpack(p.monomial(i), e);
+            std::size_t ret = 0;
+            for(std::size_t k = 0; k < n; k++) ret += static_cast<std::size_t>(e[k]) * stride[k];
+            return ret;
+        };
+        std::vector<std::size_t> ka(a.size());
+        for(std::size_t i = 0; i < a.size(); i++) ka[i] = index(a, i);
+        // The terms of b by increasing index, so that the ones landing in
+        // a block are a contiguous run
+        std::vector<std::pair<std::size_t, std::size_t>> kb(b.size());
+        for(std::size_t j = 0; j < b.size(); j++) kb[j] = {index(b, j), j};
+        std::ranges::sort(kb);
+
+        std::vector<C> dense(size, C(0));
+        auto blocks = std::min<std::size_t>(size, std::size_t{8} * threads);
+        std::atomic<std::size_t> next_block = 0;
+        auto worker = [&]{
+            for(auto block = next_block++; block < blocks; block = next_block++){
+                auto lo = size * block / blocks;
+                auto hi = size * (block + 1) / blocks;
+                for(std::size_t i = 0; i < a.size(); i++){
+                    if(ka[i] >= hi) continue;
+                    auto from = lo > ka[i] ? lo - ka[i] : 0;
+                    auto it = std::ranges::lower_bound(kb, std::pair{from, std::size_t{0}});
+                    for(; it != kb.end() && ka[i] + it->first < hi; ++it){
+                        sparse_poly_impl::add_product(dense[ka[i] + it->first], a.m_coeffs[i], b.m_coeffs[it->second]);
+                    }
+                }
+            }
+        };
+        std::vector<std::jthread> pool;
+        for(unsigned t = 1; t < threads; t++){
+            pool.emplace_back(worker);
+        }
+        worker();
+        pool.clear();
+
+        auto ret = SparsePoly(layout);
+        std::vector<std::uint64_t> m(layout.words());
+        for(auto k = size; k-- > 0;){
+            if(dense[k] == 0) continue;
+            for(std::size_t v = 0; v < n; v++) e[v] = static_cast<long>(k / stride[v] % box[v]);
+            layout.pack(e, m.data());
+            ret.push_back(std::move(dense[k]), m.data());
+        }
+        if(layout.order() != MonomialOrder::Lex) ret.sort_terms();
+        return ret;
+    }
+
+    // Restores decreasing monomial order after the terms were appended in
+    // another one
+    void sort_terms() {
+        auto w = m_layout.words();
+        std::vector<std::size_t> index(size());
+        for(std::size_t i = 0; i < size(); i++) index[i] = i;
+        std::ranges::sort(index, [&](std::size_t i, std::size_t j){
+            return m_layout.compare(monomial(i), monomial(j)) > 0;
+        });
+        auto ret = SparsePoly(m_layout);
+        ret.reserve(size());
+        for(auto i : index) ret.push_back(std::move(m_coeffs[i]), m_monomials.data() + i * w);
+        *this = std::move(ret);
+    }
+
+    static auto merge(const SparsePoly& a, const SparsePoly& b, bool subtract) -> SparsePoly {
+        check_layouts(a, b);
+        const auto& layout = a.m_layout;
+        auto ret = SparsePoly(layout);
+        ret.reserve(a.size() + b.size());
+        std::size_t i = 0, j = 0;
+        while(i < a.size() || j < b.size()){
+            auto c = i == a.size() ? std::strong_ordering::less
+                : j == b.size() ? std::strong_ordering::greater
+                : layout.compare(a.monomial(i), b.monomial(j));
+            if(c > 0){
+                ret.push_back(a.m_coeffs[i], a.monomial(i));
+                i++;
+            }
+            else if(c < 0){
+                ret.push_back(subtract ? C(0) - b.m_coeffs[j] : b.m_coeffs[j], b.monomial(j));
+                j++;
+            }
+            else{
+                auto s = subtract ? a.m_coeffs[i] - b.m_coeffs[j] : a.m_coeffs[i] + b.m_coeffs[j];
+                if(s != 0) ret.push_back(std::move(s), a.monomial(i));
+                i++;
+                j++;
+            }
+        }
+        return ret;
+    }
+
+    MonomialLayout m_layout;
+    std::vector<C> m_coeffs;
+    std::vector<std::uint64_t> m_monomials;
+};
+
+template<class C, std::integral U>
+struct math::impl::pow<SparsePoly<C>, U>{
+    static auto func(SparsePoly<C> base, U n) -> SparsePoly<C> {
+        if(n < 0) throw std::runtime_error("Negative power of a polynomial");
+        auto ret = SparsePoly<C>::constant(base.layout(), C(1));
+        for(; n != 0; n /= 2){
+            if(n % 2 == 1) ret *= base;
+            if(n > 1) base *= base;
+        }
+        return ret;
+    }
+};
+
+// Collects terms arriving in any order in an open addressing hash table
+// keyed by the packed monomial. Equal monomials are combined on arrival,
+// the terms are sorted once when the polynomial is finished.
+template<class C>
+class TermAccumulator {
+public:
+    explicit TermAccumulator(MonomialLayout _layout)
+        : m_layout{_layout}, m_table(64, 0)
+    {}
+
+    // The coefficient of monomial m, created as zero on first use
+    auto operator[](const std::uint64_t* m) -> C& {
+        auto w = m_layout.words();
+        if(2 * (m_coeffs.size() + 1) > m_table.size()) grow();
+        auto mask = m_table.size() - 1;
+        for(auto h = hash(m) & mask;; h = (h + 1) & mask){
+            if(m_table[h] == 0){
+                m_coeffs.push_back(C(0));
+                m_monomials.insert(m_monomials.end(), m, m + w);
+                m_table[h] = m_coeffs.size();
+                return m_coeffs.back();
+            }
+            auto i = m_table[h] - 1;
+            if(m_layout.equal(m_monomials.data() + i * w, m)) return m_coeffs[i];
+        }
+    }
+
+    void add(const C& c, const std::uint64_t* m) { (*this)[m] += c; }
+
+    void add(const SparsePoly<C>& p) {
+        for(std::size_t i = 0; i < p.size(); i++) add(p.coefficient(i), p.monomial(i));
+    }
+
+    auto finish() && -> SparsePoly<C> {
+        auto w = m_layout.words();
+        std::vector<std::size_t> index;
+        for(std::size_t i = 0; i < m_coeffs.size(); i++){
+            if(m_coeffs[i] != 0) index.push_back(i);
+        }
+        std::ranges::sort(index, [&](std::size_t i, std::size_t j){
+            return m_layout.compare(m_monomials.data() + i * w, m_monomials.data() + j * w) > 0;
+        });
+        auto ret = SparsePoly<C>(m_layout);
+        ret.reserve(index.size());
+        for(auto i : index) ret.push_back(std::move(m_coeffs[i]), m_monomials.data() + i * w);
+        return ret;
+    }
+
+private:
+    auto hash(const std::uint64_t* m) const -> std::size_t {
+        std::uint64_t h = 0;
+        for(std::size_t k = 0; k < m_layout.words(); k++){
+            h = (h ^ m[k]) * 0x9e3779b97f4a7c15;
+            h ^= h >> 32;
+        }
+        return static_cast<std::size_t>(h);
+    }
+
+    void grow() {
+        auto w = m_layout.words();
+        m_table.assign(2 * m_table.size(), 0);
+        auto mask = m_table.size() - 1;
+        for(std::size_t i = 0; i < m_coeffs.size(); i++){
+            auto h = hash(m_monomials.data() + i * w) & mask;
+            while(m_table[h] != 0) h = (h + 1) & mask;
+            m_table[h] = i + 1;
+        }
+    }
+
+    MonomialLayout m_layout;
+    // Index + 1 into the term arrays, 0 marks an empty slot
+    std::vector<std::size_t> m_table;
+    std::vector<C> m_coeffs;
+    std::vector<std::uint64_t> m_monomials;
+};
+
+// p^n by the multinomial theorem: the terms
+//     n! / (a_1! ... a_k!) * t_1^a_1 * ... * t_k^a_k,  a_1 + ... + a_k = n
+// are generated directly from the k terms of p, with the powers of the
+// terms computed once, and collected in a hash table.
+template<class C>
+auto multinomial_power(const SparsePoly<C>& p, long n) -> SparsePoly<C> {
+    const auto& layout = p.layout();
+    if(n < 0) throw std::runtime_error("Negative power of a polynomial");
+    if(n == 0) return SparsePoly<C>::constant(layout, C(1));
+    if(p.size() <= 1) return math::pow(p, n);
+    if(p.degree() * n > layout.max_degree()){
+        throw std::runtime_error(fmt::format("Power exceeds the {} bit exponent fields", layout.bits()));
+    }
+    auto k = p.size();
+    auto w = layout.words();
+    auto un = static_cast<std::size_t>(n);
+
+    // coeff_pow[i][a] = c_i^a and mono_pow[i][a] = m_i^a
+    std::vector<std::vector<C>> coeff_pow(k);
+    std::vector<std::uint64_t> mono_pow(k * (un + 1) * w);
+    for(std::size_t i = 0; i < k; i++){
+        coeff_pow[i].push_back(C(1));
+        for(std::size_t a = 1; a <= un; a++) coeff_pow[i].push_back(coeff_pow[i].back() * p.coefficient(i));
+        for(std::size_t a = 0; a <= un; a++) layout.power(p.monomial(i), static_cast<long>(a), mono_pow.data() + (i * (un + 1) + a) * w);
+    }
+
+    auto acc = TermAccumulator<C>(layout);
+    // The positive exponents are chosen term by term, terms left out have
+    // exponent 0 and cost nothing. The partial coefficient and monomial
+    // after d chosen terms are kept per level, so the work is bounded by
+    // the output terms times n.
+    auto depth = std::min(k, un) + 1;
+    std::vector<C> coeff(depth, C(1));
+    std::vector<std::uint64_t> mono(depth * w, 0);
+    auto recurse = [&](auto& self, std::size_t d, std::size_t i, std::size_t remaining) -> void {
+        auto* current = mono.data() + d * w;
+        if(remaining == 0){
+            acc[current] += coeff[d];
+            return;
+        }
+        auto* next = mono.data() + (d + 1) * w;
+        for(auto j = i; j < k; j++){
+            // The last term takes what remains
+            auto last = j + 1 == k;
+            auto first = last ? remaining : 1;
+            // remaining choose a, updated along the loop rather than read
+            // from a table of all binomials up to n with O(n^2) entries
+            auto binomial = multiprecision::MPi(1);
+            for(auto a = first; a <= remaining; a++){
+                if(not last){
+                    mpz_mul_ui(binomial.handle(), binomial.handle(), remaining - a + 1);
+                    mpz_divexact_ui(binomial.handle(), binomial.handle(), a);
+                }
+                coeff[d + 1] = coeff[d] * C(binomial) * coeff_pow[j][a];
+                layout.multiply(current, mono_pow.data() + (j * (un + 1) + a) * w, next);
+                self(self, d + 1, j + 1, remaining - a);
+            }
+        }
+    };
+    recurse(recurse, 0, 0, un);
+    return std::move(acc).finish();
+}
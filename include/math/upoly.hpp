@@ -0,0 +1,847 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "math_functions.hpp"
+#include "modular.hpp"
+#include "mpi.hpp"
+#include "rational.hpp"
+
+enum class UPolyMultiply : std::uint8_t {
+    // Chosen from the lengths and, for MPi, the coefficient sizes
+    Auto,
+    Schoolbook,
+    Karatsuba,
+    Toom3,
+    // Multi-prime number theoretic transform, MPi only
+    NTT,
+    // One GMP integer product by Kronecker substitution, MPi only
+    Kronecker
+};
+
+namespace upoly_impl{
+
+using multiprecision::MPi;
+
+// Below this length of the shorter operand schoolbook multiplication is
+// fastest, up to the next Karatsuba, then Toom-3. Integer coefficients
+// leave schoolbook at kronecker_threshold for a single GMP product.
+constexpr std::size_t karatsuba_threshold = 32;
+constexpr std::size_t toom3_threshold = 128;
+constexpr std::size_t kronecker_threshold = 16;
+// Long products of small coefficients use the transform, as long as no
+// more than ntt_max_primes primes are needed. Its reconstruction costs the
+// square of the number of primes per coefficient, with more GMP wins.
+constexpr std::size_t ntt_threshold = 512;
+constexpr std::size_t ntt_max_primes = 16;
+// Quotients shorter than this are computed by schoolbook division
+constexpr std::size_t newton_threshold = 64;
+// Taylor shifts of shorter polynomials use Horner's scheme
+constexpr std::size_t taylor_threshold = 128;
+
+template<class C>
+constexpr bool is_mpi = std::same_as<C, MPi>;
+
+template<class C>
+auto is_zero(const C& c) -> bool {
+    if constexpr(is_mpi<C>) return mpz_sgn(c.handle()) == 0;
+    else return c == 0;
+}
+
+template<class C>
+void add_product(C& acc, const C& a, const C& b) {
+    if constexpr(is_mpi<C>) mpz_addmul(acc.handle(), a.handle(), b.handle());
+    else acc += a * b;
+}
+
+// c / d for a small d known to divide c
+template<class C>
+void divide_exact(C& c, unsigned long d) {
+    if constexpr(is_mpi<C>) mpz_divexact_ui(c.handle(), c.handle(), d);
+    else c /= C(static_cast<long>(d));
+}
+
+template<class C>
+auto is_unit(const C& c) -> bool {
+    if constexpr(is_mpi<C>) return mpz_cmpabs_ui(c.handle(), 1) == 0;
+    else return c != 0;
+}
+
+// Coefficient vectors, lowest degree first. The helpers take spans so that
+// the recursive algorithms work on parts of their operands without copies.
+template<class C>
+using Coeffs = std::vector<C>;
+
+template<class C>
+auto add(std::span<const C> a, std::span<const C> b) -> Coeffs<C> {
+    if(a.size() < b.size()) std::swap(a, b);
+    auto ret = Coeffs<C>(a.begin(), a.end());
+    for(std::size_t i = 0; i < b.size(); i++) ret[i] += b[i];
+    return ret;
+}
+
+template<class C>
+auto sub(std::span<const C> a, std::span<const C> b) -> Coeffs<C> {
+    auto ret = Coeffs<C>(a.begin(), a.end());
+    if(ret.size() < b.size()) ret.resize(b.size(), C(0));
+    for(std::size_t i = 0; i < b.size(); i++) ret[i] -= b[i];
+    return ret;
+}
+
+// ret[offset + i] += a[i], growing ret as needed
+template<class C>
+void add_at(Coeffs<C>& ret, std::span<const C> a, std::size_t offset) {
+    if(ret.size() < offset + a.size()) ret.resize(offset + a.size(), C(0));
+    for(std::size_t i = 0; i < a.size(); i++) ret[offset + i] += a[i];
+}
+
+template<class C>
+void trim(Coeffs<C>& a) {
+    while(not a.empty() && is_zero(a.back())) a.pop_back();
+}
+
+template<class C>
+auto schoolbook(std::span<const C> a, std::span<const C> b) -> Coeffs<C> {
+    if(a.empty() || b.empty()) return {};
+    auto ret = Coeffs<C>(a.size() + b.size() - 1, C(0));
+    for(std::size_t i = 0; i < a.size(); i++){
+        if(is_zero(a[i])) continue;
+        for(std::size_t j = 0; j < b.size(); j++) add_product(ret[i + j], a[i], b[j]);
+    }
+    return ret;
+}
+
+/* ***********************************************
+    Multi-prime number theoretic transform
+************************************************** */
+
+// A prime p = c * 2^40 + 1 in [2^61, 2^62) with roots of unity of every
+// order 2^k up to 2^40, stored in Montgomery form.
+struct NttPrime {
+    static constexpr std::size_t max_level = 40;
+
+    modular::Montgomery m;
+    std::array<std::uint64_t, max_level + 1> roots = {};
+    std::array<std::uint64_t, max_level + 1> inverse_roots = {};
+};
+
+inline auto make_ntt_prime(std::uint64_t p) -> NttPrime {
+    auto ret = NttPrime{modular::Montgomery(p)};
+    // x^((p - 1) / 2^40) has order exactly 2^40 for a quadratic non-residue x
+    std::uint64_t x = 2;
+    while(modular::pow_mod(x, (p - 1) / 2, p) != p - 1) x++;
+    auto w = modular::pow_mod(x, (p - 1) >> NttPrime::max_level, p);
+    ret.roots[NttPrime::max_level] = ret.m.to(w);
+    ret.inverse_roots[NttPrime::max_level] = ret.m.to(modular::inverse_mod(w, p));
+    for(auto k = NttPrime::max_level; k > 0; k--){
+        ret.roots[k - 1] = ret.m.mul(ret.roots[k], ret.roots[k]);
+        ret.inverse_roots[k - 1] = ret.m.mul(ret.inverse_roots[k], ret.inverse_roots[k]);
+    }
+    return ret;
+}
+
+// The first count transform primes, found once and shared by all threads
+inline auto ntt_primes(std::size_t count) -> std::vector<NttPrime> {
+    static std::mutex mutex;
+    static std::vector<NttPrime> primes;
+    static std::uint64_t c = std::uint64_t{1} << 22;
+    auto lock = std::scoped_lock(mutex);
+    while(primes.size() < count){
+        if(--c < (std::uint64_t{1} << 21)) throw std::runtime_error("Out of transform primes");
+        auto p = (c << NttPrime::max_level) + 1;
+        if(modular::is_prime(p)) primes.push_back(make_ntt_prime(p));
+    }
+    return {primes.begin(), primes.begin() + static_cast<std::ptrdiff_t>(count)};
+}
+
+// Twiddle factors of all levels of a transform of length n, the powers
+// w^j, j < h, of the root w of order 2h are stored from index h on.
+inline auto twiddles(const NttPrime& prime, std::size_t n, bool inverse) -> std::vector<std::uint64_t> {
+    std::vector<std::uint64_t> ret(std::max<std::size_t>(n, 2));
+    for(std::size_t half = 1, level = 1; half < n; half *= 2, level++){
+        auto w = inverse ? prime.inverse_roots[level] : prime.roots[level];
+        ret[half] = prime.m.one;
+        for(std::size_t j = 1; j < half; j++) ret[half + j] = prime.m.mul(ret[half + j - 1], w);
+    }
+    return ret;
+}
+
+// In-place radix-2 transform of a power of two length in Montgomery form.
+// The forward transform is decimation in frequency and leaves its result
+// in bit reversed order, which the decimation in time inverse takes as
+// its input, so that no permutation is needed for a convolution. The
+// inverse leaves out the division by the length.
+inline void transform(std::vector<std::uint64_t>& a, const modular::Montgomery& m, const std::vector<std::uint64_t>& twiddle, bool inverse) {
+    auto n = a.size();
+    auto butterflies = [&](std::size_t half){
+        const auto* w = twiddle.data() + half;
+        for(std::size_t i = 0; i < n; i += 2 * half){
+            auto* x = a.data() + i;
+            auto* y = x + half;
+            for(std::size_t j = 0; j < half; j++){
+                if(inverse){
+                    auto v = m.mul(y[j], w[j]);
+                    y[j] = modular::sub_mod(x[j], v, m.p);
+                    x[j] = modular::add_mod(x[j], v, m.p);
+                }
+                else{
+                    auto u = x[j];
+                    x[j] = modular::add_mod(u, y[j], m.p);
+                    y[j] = m.mul(modular::sub_mod(u, y[j], m.p), w[j]);
+                }
+            }
+        }
+    };
+    if(inverse) for(std::size_t half = 1; half < n; half *= 2) butterflies(half);
+    else for(auto half = n / 2; half >= 1; half /= 2) butterflies(half);
+}
+
+// The residues of a in Montgomery form, zero padded to length n
+inline auto residues(std::span<const MPi> a, const NttPrime& prime, std::size_t n) -> std::vector<std::uint64_t> {
+    std::vector<std::uint64_t> ret(n, 0);
+    for(std::size_t i = 0; i < a.size(); i++) ret[i] = prime.m.to(mpz_fdiv_ui(a[i].handle(), prime.m.p));
+    return ret;
+}
+
+// Bits of the largest absolute value
+inline auto max_bits(std::span<const MPi> a) -> std::size_t {
+    std::size_t ret = 0;
+    for(const auto& c : a) ret = std::max(ret, mpz_sizeinbase(c.handle(), 2));
+    return ret;
+}
+
+// Number of primes whose product exceeds 2^(bits + 1), enough to recover
+// values of up to bits bits with their sign. Every prime has 61 bits.
+inline auto primes_for(std::size_t bits) -> std::size_t {
+    return (bits + 1) / 61 + 1;
+}
+
+// Recovers the symmetric representatives of values from their residues
+// modulo the primes (normal form, one row per prime) by Garner's algorithm
+// in mixed radix, which stays in word arithmetic until the final value.
+inline auto reconstruct(const std::vector<NttPrime>& primes, const std::vector<std::vector<std::uint64_t>>& rows, std::size_t n) -> std::vector<MPi> {
+    auto k = primes.size();
+    // inverses[i][j] = p_j^-1 mod p_i in Montgomery form, for j < i
+    std::vector<std::vector<std::uint64_t>> inverses(k);
+    for(std::size_t i = 0; i < k; i++){
+        const auto& m = primes[i].m;
+        for(std::size_t j = 0; j < i; j++) inverses[i].push_back(m.to(modular::inverse_mod(primes[j].m.p % m.p, m.p)));
+    }
+    auto modulus = MPi(1);
+    for(const auto& prime : primes) mpz_mul_ui(modulus.handle(), modulus.handle(), prime.m.p);
+    auto half = MPi();
+    mpz_fdiv_q_2exp(half.handle(), modulus.handle(), 1);
+
+    std::vector<MPi> ret(n);
+    std::vector<std::uint64_t> digits(k);
+    for(std::size_t t = 0; t < n; t++){
+        for(std::size_t i = 0; i < k; i++){
+            const auto& m = primes[i].m;
+            auto x = rows[i][t];
+            for(std::size_t j = 0; j < i; j++){
+                x = m.mul(modular::sub_mod(x, digits[j] % m.p, m.p), inverses[i][j]);
+            }
+            digits[i] = x;
+        }
+        auto& r = ret[t];
+        // Most values fit a word long before the bound does. Their mixed
+        // radix digits above the first are all 0 or, for small negative
+        // values M - c, all p_i - 1.
+        auto p0 = primes[0].m.p;
+        if(k == 1){
+            mpz_set_si(r.handle(), digits[0] > p0 / 2 ? -static_cast<long>(p0 - digits[0]) : static_cast<long>(digits[0]));
+            continue;
+        }
+        auto small = true, small_negative = true;
+        for(std::size_t i = 1; i < k; i++){
+            small = small && digits[i] == 0;
+            small_negative = small_negative && digits[i] == primes[i].m.p - 1;
+        }
+        if(small || small_negative){
+            mpz_set_si(r.handle(), small ? static_cast<long>(digits[0]) : -static_cast<long>(p0 - digits[0]));
+            continue;
+        }
+        mpz_set_ui(r.handle(), digits[k - 1]);
+        for(auto i = k - 1; i-- > 0;){
+            mpz_mul_ui(r.handle(), r.handle(), primes[i].m.p);
+            mpz_add_ui(r.handle(), r.handle(), digits[i]);
+        }
+        if(mpz_cmp(r.handle(), half.handle()) > 0) mpz_sub(r.handle(), r.handle(), modulus.handle());
+    }
+    return ret;
+}
+
+// Runs job(i) for the primes i < count, spread over threads for long
+// transforms
+template<class F>
+void for_each_prime(std::size_t count, std::size_t n, F job) {
+    auto threads = n < (std::size_t{1} << 15) ? 1 : std::min<std::size_t>(count, std::max(std::thread::hardware_concurrency(), 1u));
+    auto worker = [&](std::size_t t){
+        for(auto i = t; i < count; i += threads) job(i);
+    };
+    std::vector<std::jthread> pool;
+    for(std::size_t t = 1; t < threads; t++){
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+}
+
+// The values of a transform after the inverse, divided by the length and
+// back in normal form in the same multiplication
+inline void finish_inverse(std::vector<std::uint64_t>& a, const NttPrime& prime) {
+    const auto& m = prime.m;
+    auto scale = modular::inverse_mod(a.size() % m.p, m.p);
+    transform(a, m, twiddles(prime, a.size(), true), true);
+    for(auto& x : a) x = m.mul(x, scale);
+}
+
+// a * b with every product coefficient recovered from its residues modulo
+// enough primes. The transforms of a square are shared.
+inline auto ntt_multiply(std::span<const MPi> a, std::span<const MPi> b) -> Coeffs<MPi> {
+    if(a.empty() || b.empty()) return {};
+    auto square = a.data() == b.data() && a.size() == b.size();
+    auto length = a.size() + b.size() - 1;
+    auto n = std::bit_ceil(length);
+    auto bits = max_bits(a) + max_bits(b) + static_cast<std::size_t>(std::bit_width(std::min(a.size(), b.size())));
+    auto primes = ntt_primes(primes_for(bits));
+    std::vector<std::vector<std::uint64_t>> rows(primes.size());
+    for_each_prime(primes.size(), n, [&](std::size_t i){
+        const auto& prime = primes[i];
+        const auto& m = prime.m;
+        auto forward = twiddles(prime, n, false);
+        auto fa = residues(a, prime, n);
+        transform(fa, m, forward, false);
+        if(square){
+            for(auto& x : fa) x = m.mul(x, x);
+        }
+        else{
+            auto fb = residues(b, prime, n);
+            transform(fb, m, forward, false);
+            for(std::size_t j = 0; j < n; j++) fa[j] = m.mul(fa[j], fb[j]);
+        }
+        finish_inverse(fa, prime);
+        rows[i] = std::move(fa);
+    });
+    return reconstruct(primes, rows, length);
+}
+
+// a^e by raising the transform of a pointwise, the product of the primes
+// bounds |a|_1^e. Nothing if that needs too many primes.
+inline auto ntt_power(std::span<const MPi> a, unsigned long e) -> std::optional<Coeffs<MPi>> {
+    auto norm = MPi(0), t = MPi();
+    for(const auto& c : a){
+        mpz_abs(t.handle(), c.handle());
+        mpz_add(norm.handle(), norm.handle(), t.handle());
+    }
+    auto bits = mpz_sizeinbase(norm.handle(), 2) * e;
+    if(primes_for(bits) > ntt_max_primes) return {};
+    auto length = (a.size() - 1) * e + 1;
+    auto n = std::bit_ceil(length);
+    auto primes = ntt_primes(primes_for(bits));
+    std::vector<std::vector<std::uint64_t>> rows(primes.size());
+    for_each_prime(primes.size(), n, [&](std::size_t i){
+        const auto& prime = primes[i];
+        auto fa = residues(a, prime, n);
+        transform(fa, prime.m, twiddles(prime, n, false), false);
+        for(auto& x : fa) x = prime.m.pow(x, e);
+        finish_inverse(fa, prime);
+        rows[i] = std::move(fa);
+    });
+    return reconstruct(primes, rows, length);
+}
+
+/* ***********************************************
+    Kronecker substitution
+************************************************** */
+
+// a(2^(GMP_NUMB_BITS w)) for slots of w limbs wide enough for every coefficient
+inline auto pack(std::span<const MPi> a, std::size_t w) -> MPi {
+    std::vector<mp_limb_t> positive(a.size() * w, 0), negative(a.size() * w, 0);
+    for(std::size_t i = 0; i < a.size(); i++){
+        auto size = mpz_size(a[i].handle());
+        auto& target = mpz_sgn(a[i].handle()) < 0 ? negative : positive;
+        std::copy_n(mpz_limbs_read(a[i].handle()), size, target.data() + i * w);
+    }
+    auto ret = MPi(), tmp = MPi();
+    mpz_import(ret.handle(), positive.size(), -1, sizeof(mp_limb_t), 0, 0, positive.data());
+    mpz_import(tmp.handle(), negative.size(), -1, sizeof(mp_limb_t), 0, 0, negative.data());
+    mpz_sub(ret.handle(), ret.handle(), tmp.handle());
+    return ret;
+}
+
+// The n signed digits of x in base 2^(GMP_NUMB_BITS w), each of absolute value less
+// than half the base. A digit at or above that borrows from the next.
+inline auto unpack(const MPi& x, std::size_t w, std::size_t n) -> Coeffs<MPi> {
+    auto limbs = mpz_limbs_read(x.handle());
+    auto size = mpz_size(x.handle());
+    auto negative = mpz_sgn(x.handle()) < 0;
+    auto half = MPi(), base = MPi();
+    mpz_setbit(half.handle(), GMP_NUMB_BITS * w - 1);
+    mpz_setbit(base.handle(), GMP_NUMB_BITS * w);
+    Coeffs<MPi> ret(n);
+    unsigned long carry = 0;
+    for(std::size_t i = 0; i < n; i++){
+        auto& c = ret[i];
+        auto begin = std::min(i * w, size);
+        auto count = std::min((i + 1) * w, size) - begin;
+        mpz_import(c.handle(), count, -1, sizeof(mp_limb_t), 0, 0, limbs + begin);
+        mpz_add_ui(c.handle(), c.handle(), carry);
+        carry = mpz_cmp(c.handle(), half.handle()) >= 0;
+        if(carry) mpz_sub(c.handle(), c.handle(), base.handle());
+        if(negative) mpz_neg(c.handle(), c.handle());
+    }
+    return ret;
+}
+
+// a * b as the product of the integers a(2^k) b(2^k), by GMP
+inline auto kronecker_multiply(std::span<const MPi> a, std::span<const MPi> b) -> Coeffs<MPi> {
+    if(a.empty() || b.empty()) return {};
+    auto bits = max_bits(a) + max_bits(b) + static_cast<std::size_t>(std::bit_width(std::min(a.size(), b.size()))) + 1;
+    auto w = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    auto x = pack(a, w);
+    if(a.data() == b.data() && a.size() == b.size()) mpz_mul(x.handle(), x.handle(), x.handle());
+    else mpz_mul(x.handle(), x.handle(), pack(b, w).handle());
+    return unpack(x, w, a.size() + b.size() - 1);
+}
+
+/* ***********************************************
+    Dispatch, Karatsuba and Toom-3
+************************************************** */
+
+template<class C>
+auto multiply(std::span<const C> a, std::span<const C> b, UPolyMultiply algorithm) -> Coeffs<C>;
+
+// Operands of very different lengths are cut into pieces of the shorter
+// length, each piece product is balanced.
+template<class C>
+auto multiply_unbalanced(std::span<const C> a, std::span<const C> b, UPolyMultiply algorithm) -> Coeffs<C> {
+    auto ret = Coeffs<C>();
+    for(std::size_t offset = 0; offset < b.size(); offset += a.size()){
+        auto piece = b.subspan(offset, std::min(a.size(), b.size() - offset));
+        add_at<C>(ret, multiply(a, piece, algorithm), offset);
+    }
+    return ret;
+}
+
+// a = a0 + a1 x^h, b = b0 + b1 x^h and
+//     a * b = z0 + ((a0 + a1)(b0 + b1) - z0 - z2) x^h + z2 x^2h
+// with z0 = a0 b0, z2 = a1 b1, three half size products instead of four.
+template<class C>
+auto karatsuba(std::span<const C> a, std::span<const C> b, UPolyMultiply algorithm) -> Coeffs<C> {
+    auto h = (b.size() + 1) / 2;
+    auto a0 = a.first(std::min(h, a.size())), a1 = a.subspan(a0.size());
+    auto b0 = b.first(h), b1 = b.subspan(h);
+    auto z0 = multiply(a0, b0, algorithm);
+    auto z2 = multiply(a1, b1, algorithm);
+    auto sa = add(a0, a1), sb = add(b0, b1);
+    auto z1 = sub<C>(sub<C>(multiply<C>(sa, sb, algorithm), z0), z2);
+    auto ret = std::move(z0);
+    add_at<C>(ret, z1, h);
+    add_at<C>(ret, z2, 2 * h);
+    return ret;
+}
+
+// Toom-3 with Bodrato's evaluation at 0, 1, -1, -2, infinity and his
+// interpolation sequence, five third size products.
+template<class C>
+auto toom3(std::span<const C> a, std::span<const C> b, UPolyMultiply algorithm) -> Coeffs<C> {
+    auto h = (b.size() + 2) / 3;
+    auto split = [&](std::span<const C> p){
+        auto p0 = p.first(std::min(h, p.size()));
+        auto p1 = p.subspan(p0.size(), std::min(h, p.size() - p0.size()));
+        auto p2 = p.subspan(p0.size() + p1.size());
+        return std::array{p0, p1, p2};
+    };
+    // Values at 0, 1, -1, -2 and infinity
+    auto evaluate = [&](std::span<const C> p){
+        auto [p0, p1, p2] = split(p);
+        auto t = add(p0, p2);
+        auto v1 = add<C>(t, p1);
+        auto vm1 = sub<C>(t, p1);
+        // p(-2) = 2 (p(-1) + p2) - p0
+        auto vm2 = add<C>(vm1, p2);
+        for(auto& c : vm2) c *= C(2);
+        vm2 = sub<C>(vm2, p0);
+        return std::array{Coeffs<C>(p0.begin(), p0.end()), std::move(v1), std::move(vm1), std::move(vm2), Coeffs<C>(p2.begin(), p2.end())};
+    };
+    auto va = evaluate(a), vb = evaluate(b);
+    std::array<Coeffs<C>, 5> r;
+    for(std::size_t k = 0; k < 5; k++) r[k] = multiply<C>(va[k], vb[k], algorithm);
+    auto& [r0, r1, rm1, rm2, rinf] = r;
+
+    auto divided = [](Coeffs<C> p, unsigned long d){
+        for(auto& c : p) divide_exact(c, d);
+        return p;
+    };
+    auto s3 = divided(sub<C>(rm2, r1), 3);
+    auto s1 = divided(sub<C>(r1, rm1), 2);
+    auto s2 = sub<C>(rm1, r0);
+    s3 = divided(sub<C>(s2, s3), 2);
+    auto twice_inf = rinf;
+    for(auto& c : twice_inf) c *= C(2);
+    s3 = add<C>(s3, twice_inf);
+    s2 = sub<C>(add<C>(s2, s1), rinf);
+    s1 = sub<C>(s1, s3);
+
+    auto ret = std::move(r0);
+    add_at<C>(ret, s1, h);
+    add_at<C>(ret, s2, 2 * h);
+    add_at<C>(ret, s3, 3 * h);
+    add_at<C>(ret, rinf, 4 * h);
+    return ret;
+}
+
+template<class C>
+auto choose(std::span<const C> a, std::span<const C> b) -> UPolyMultiply {
+    auto n = a.size();
+    if constexpr(is_mpi<C>){
+        if(n < kronecker_threshold) return UPolyMultiply::Schoolbook;
+        auto bits = max_bits(a) + max_bits(b) + static_cast<std::size_t>(std::bit_width(n));
+        if(n >= ntt_threshold && primes_for(bits) <= ntt_max_primes) return UPolyMultiply::NTT;
+        return UPolyMultiply::Kronecker;
+    }
+    if(n < karatsuba_threshold) return UPolyMultiply::Schoolbook;
+    return n < toom3_threshold ? UPolyMultiply::Karatsuba : UPolyMultiply::Toom3;
+}
+
+// The product of two coefficient vectors. A forced algorithm is used at
+// every level of the recursion down to schoolbook sizes, Auto chooses
+// again for every subproduct.
+template<class C>
+auto multiply(std::span<const C> a, std::span<const C> b, UPolyMultiply algorithm) -> Coeffs<C> {
+    if(a.size() > b.size()) std::swap(a, b);
+    if(a.empty()) return {};
+    auto chosen = algorithm == UPolyMultiply::Auto ? choose(a, b) : algorithm;
+    if(a.size() < karatsuba_threshold && (chosen == UPolyMultiply::Karatsuba || chosen == UPolyMultiply::Toom3)) chosen = UPolyMultiply::Schoolbook;
+
+    switch(chosen){
+    case UPolyMultiply::NTT:
+        if constexpr(is_mpi<C>) return ntt_multiply(a, b);
+        else throw std::runtime_error("The transform multiplication needs integer coefficients");
+    case UPolyMultiply::Kronecker:
+        if constexpr(is_mpi<C>) return kronecker_multiply(a, b);
+        else throw std::runtime_error("Kronecker substitution needs integer coefficients");
+    case UPolyMultiply::Karatsuba:
+        if(b.size() > 2 * a.size()) return multiply_unbalanced(a, b, algorithm);
+        return karatsuba(a, b, algorithm);
+    case UPolyMultiply::Toom3:
+        if(b.size() > 2 * a.size()) return multiply_unbalanced(a, b, algorithm);
+        // Toom-3 needs all three parts of the shorter operand
+        if(3 * a.size() <= 2 * b.size() + 2) return karatsuba(a, b, algorithm);
+        return toom3(a, b, algorithm);
+    default:
+        return schoolbook(a, b);
+    }
+}
+
+/* ***********************************************
+    Taylor shifts
+************************************************** */
+
+// p(x + s) in place by Horner's scheme, n (n - 1) / 2 multiply-adds, which
+// are additions for s = 1
+template<class C>
+void taylor_shift_horner(Coeffs<C>& p, const C& s) {
+    auto unit = false;
+    if constexpr(is_mpi<C>) unit = mpz_cmp_ui(s.handle(), 1) == 0;
+    for(std::size_t i = 0; i + 1 < p.size(); i++){
+        for(auto j = p.size() - 1; j-- > i;){
+            if(unit) p[j] += p[j + 1];
+            else add_product(p[j], p[j + 1], s);
+        }
+    }
+}
+
+// (x + s)^h, the coefficient of x^(i - 1) from that of x^i as
+// binomial(h, i - 1) = binomial(h, i) i / (h - i + 1)
+template<class C>
+auto binomial_power(const C& s, std::size_t h) -> Coeffs<C> {
+    auto ret = Coeffs<C>(h + 1, C(0));
+    ret[h] = C(1);
+    for(auto i = h; i > 0; i--){
+        ret[i - 1] = ret[i] * s * C(static_cast<long>(i));
+        divide_exact(ret[i - 1], h - i + 1);
+    }
+    return ret;
+}
+
+// p(x + s) = p0(x + s) + (x + s)^h p1(x + s) for p = p0 + x^h p1, which
+// costs O(M(n) log n) with M(n) the cost of a product of length n (von zur
+// Gathen and Gerhard). The lower half is the longer one, so that the
+// powers needed are those for the lengths of the upper halves.
+template<class C>
+auto taylor_shift(std::span<const C> p, const C& s) -> Coeffs<C> {
+    if(p.size() < taylor_threshold){
+        auto ret = Coeffs<C>(p.begin(), p.end());
+        taylor_shift_horner(ret, s);
+        return ret;
+    }
+    auto h = (p.size() + 1) / 2;
+    auto ret = taylor_shift(p.first(h), s);
+    auto high = taylor_shift(p.subspan(h), s);
+    add_at<C>(ret, multiply<C>(binomial_power(s, h), high, UPolyMultiply::Auto), 0);
+    return ret;
+}
+
+} // namespace upoly_impl
+
+// A dense univariate polynomial over C, MPi or FieldOfFractions<MPi>. The
+// coefficients are stored lowest degree first without trailing zeros, so
+// the zero polynomial is empty and equal polynomials compare equal.
+template<class C>
+class UPoly {
+public:
+    using Coefficient = C;
+
+    UPoly() = default;
+
+    explicit UPoly(std::vector<C> _coeffs)
+        : m_coeffs{std::move(_coeffs)}
+    {
+        upoly_impl::trim(m_coeffs);
+    }
+
+    static auto constant(C c) -> UPoly { return UPoly(std::vector<C>{std::move(c)}); }
+
+    // c x^k
+    static auto monomial(C c, std::size_t k) -> UPoly {
+        std::vector<C> coeffs(k + 1, C(0));
+        coeffs[k] = std::move(c);
+        return UPoly(std::move(coeffs));
+    }
+
+    // Degree, -1 for the zero polynomial
+    auto degree() const -> long { return static_cast<long>(m_coeffs.size()) - 1; }
+    auto size() const { return m_coeffs.size(); }
+    auto is_zero() const { return m_coeffs.empty(); }
+
+    auto operator[](std::size_t k) const -> const C& { return m_coeffs[k]; }
+    auto coefficients() const -> std::span<const C> { return m_coeffs; }
+    auto leading_coefficient() const -> const C& { return m_coeffs.back(); }
+
+    // The value at x by Horner's rule
+    auto evaluate(const C& x) const -> C {
+        auto ret = C(0);
+        for(auto k = m_coeffs.size(); k-- > 0;){
+            ret *= x;
+            ret += m_coeffs[k];
+        }
+        return ret;
+    }
+
+    auto derivative() const -> UPoly {
+        if(m_coeffs.size() <= 1) return {};
+        std::vector<C> ret(m_coeffs.size() - 1);
+        for(std::size_t k = 1; k < m_coeffs.size(); k++) ret[k - 1] = m_coeffs[k] * C(static_cast<long>(k));
+        return UPoly(std::move(ret));
+    }
+
+    /* ***********************************************
+        Arithmetic
+    ************************************************** */
+
+    auto operator-() const -> UPoly {
+        auto ret = *this;
+        for(auto& c : ret.m_coeffs) c = C(0) - c;
+        return ret;
+    }
+
+    friend auto operator+(const UPoly& a, const UPoly& b) -> UPoly {
+        return UPoly(upoly_impl::add<C>(a.m_coeffs, b.m_coeffs));
+    }
+
+    friend auto operator-(const UPoly& a, const UPoly& b) -> UPoly {
+        return UPoly(upoly_impl::sub<C>(a.m_coeffs, b.m_coeffs));
+    }
+
+    friend auto operator*(const UPoly& a, const C& c) -> UPoly {
+        auto ret = a;
+        for(auto& x : ret.m_coeffs) x *= c;
+        upoly_impl::trim(ret.m_coeffs);
+        return ret;
+    }
+
+    friend auto operator*(const C& c, const UPoly& a) -> UPoly { return a * c; }
+
+    friend auto operator*(const UPoly& a, const UPoly& b) -> UPoly { return multiply(a, b); }
+
+    friend auto multiply(const UPoly& a, const UPoly& b, UPolyMultiply algorithm = UPolyMultiply::Auto) -> UPoly {
+        return UPoly(upoly_impl::multiply<C>(a.m_coeffs, b.m_coeffs, algorithm));
+    }
+
+    auto operator+=(const UPoly& other) -> UPoly& { return *this = *this + other; }
+    auto operator-=(const UPoly& other) -> UPoly& { return *this = *this - other; }
+    auto operator*=(const UPoly& other) -> UPoly& { return *this = *this * other; }
+
+    friend auto operator==(const UPoly& a, const UPoly& b) -> bool {
+        return std::ranges::equal(a.m_coeffs, b.m_coeffs, [](const C& x, const C& y){ return (x <=> y) == 0; });
+    }
+
+    // f^-1 mod x^n by Newton's iteration g <- g + g (1 - f g), which doubles
+    // the number of correct coefficients per step. f(0) must be a unit.
+    friend auto inverse_series(const UPoly& f, std::size_t n) -> UPoly {
+        return newton_inverse(f, n, 0);
+    }
+
+    // a = q b + r with deg r < deg b, the leading coefficient of b must be a
+    // unit. Long quotients are computed from reversed polynomials, where
+    // rev(q) = rev(a) rev(b)^-1 mod x^(deg a - deg b + 1) with the series
+    // inverse by Newton's iteration, at the cost of a few multiplications.
+    // Over the rationals the series inverse has huge denominators and long
+    // division is faster, so only integer coefficients take this path.
+    //
+    // Over the integers the series inverse grows by a few bits per term even
+    // if q does not, so it is computed modulo 2^N and q is taken from the
+    // symmetric residues. N starts a bit above the size of a and doubles
+    // until the remainder comes out of lower degree than b, which can only
+    // happen for the true quotient.
+    friend auto divide(const UPoly& a, const UPoly& b) -> std::pair<UPoly, UPoly> {
+        if(b.is_zero()) throw std::runtime_error("Division by the zero polynomial");
+        if(not upoly_impl::is_unit(b.leading_coefficient())){
+            throw std::runtime_error("Division by a polynomial whose leading coefficient is not a unit");
+        }
+        if(a.degree() < b.degree()) return {UPoly(), a};
+        auto k = static_cast<std::size_t>(a.degree() - b.degree() + 1);
+        if(not upoly_impl::is_mpi<C> || k < upoly_impl::newton_threshold || b.size() < upoly_impl::newton_threshold){
+            auto [q, r] = divide_schoolbook(a, b);
+            return {std::move(*q), std::move(r)};
+        }
+        std::size_t bits = 0;
+        if constexpr(upoly_impl::is_mpi<C>) bits = upoly_impl::max_bits(a.coefficients()) + 64;
+        auto ra = a.reversed().truncated(k);
+        auto rb = b.reversed();
+        while(true){
+            auto q = (ra * newton_inverse(rb, k, bits)).truncated(k);
+            q.reduce(bits);
+            q.m_coeffs.resize(k, C(0));
+            std::ranges::reverse(q.m_coeffs);
+            upoly_impl::trim(q.m_coeffs);
+            auto r = a - q * b;
+            if(r.degree() < b.degree()) return {std::move(q), std::move(r)};
+            bits *= 2;
+        }
+    }
+
+    // a / b if b divides a, nothing otherwise. Any non-zero leading
+    // coefficient of b is allowed.
+    friend auto divide_exact(const UPoly& a, const UPoly& b) -> std::optional<UPoly> {
+        if(b.is_zero()) throw std::runtime_error("Division by the zero polynomial");
+        if(upoly_impl::is_unit(b.leading_coefficient())){
+            auto [q, r] = divide(a, b);
+            if(not r.is_zero()) return {};
+            return std::move(q);
+        }
+        auto [q, r] = divide_schoolbook(a, b);
+        if(not q || not r.is_zero()) return {};
+        return std::move(*q);
+    }
+
+private:
+    // inverse_series, over the integers modulo 2^bits unless bits is 0
+    static auto newton_inverse(const UPoly& f, std::size_t n, std::size_t bits) -> UPoly {
+        if(f.is_zero() || not upoly_impl::is_unit(f.m_coeffs[0])){
+            throw std::runtime_error("Series inverse of a polynomial whose constant term is not a unit");
+        }
+        auto g = constant(C(1) / f.m_coeffs[0]);
+        for(std::size_t k = 1; k < n;){
+            k = std::min(2 * k, n);
+            auto e = constant(C(1)) - (f.truncated(k) * g).truncated(k);
+            e.reduce(bits);
+            g = g + (g * e).truncated(k);
+            g.reduce(bits);
+        }
+        return g.truncated(n);
+    }
+
+    // Coefficients to their symmetric residues modulo 2^bits, if bits != 0
+    void reduce(std::size_t bits) {
+        if constexpr(upoly_impl::is_mpi<C>){
+            if(bits == 0) return;
+            for(auto& c : m_coeffs){
+                mpz_fdiv_r_2exp(c.handle(), c.handle(), bits);
+                if(mpz_tstbit(c.handle(), bits - 1)){
+                    mpz_cdiv_r_2exp(c.handle(), c.handle(), bits);
+                }
+            }
+            upoly_impl::trim(m_coeffs);
+        }
+    }
+
+    // The terms of degree < n
+    auto truncated(std::size_t n) const -> UPoly {
+        if(n >= m_coeffs.size()) return *this;
+        return UPoly(std::vector<C>(m_coeffs.begin(), m_coeffs.begin() + static_cast<std::ptrdiff_t>(n)));
+    }
+
+    // x^deg p(1/x), the coefficients in reverse
+    auto reversed() const -> UPoly {
+        return UPoly(std::vector<C>(m_coeffs.rbegin(), m_coeffs.rend()));
+    }
+
+    // Long division, no quotient if some leading coefficient of a remainder
+    // is not divisible by the one of b.
+    static auto divide_schoolbook(const UPoly& a, const UPoly& b) -> std::pair<std::optional<UPoly>, UPoly> {
+        auto r = a.m_coeffs;
+        if(r.size() < b.size()) return {UPoly(), a};
+        std::vector<C> q(r.size() - b.size() + 1, C(0));
+        const auto& lc = b.leading_coefficient();
+        for(auto k = q.size(); k-- > 0;){
+            auto& top = r[k + b.size() - 1];
+            if(upoly_impl::is_zero(top)) continue;
+            if constexpr(upoly_impl::is_mpi<C>){
+                if(not mpz_divisible_p(top.handle(), lc.handle())) return {std::nullopt, a};
+                mpz_divexact(q[k].handle(), top.handle(), lc.handle());
+            }
+            else q[k] = top / lc;
+            for(std::size_t j = 0; j < b.size(); j++) r[k + j] -= q[k] * b.m_coeffs[j];
+        }
+        return {UPoly(std::move(q)), UPoly(std::move(r))};
+    }
+
+    std::vector<C> m_coeffs;
+};
+
+// p(x + s). Short polynomials are shifted by Horner's scheme, long ones in
+// halves joined by products with powers of x + s, see upoly_impl.
+template<class C>
+auto taylor_shift(const UPoly<C>& p, const C& s) -> UPoly<C> {
+    return UPoly<C>(upoly_impl::taylor_shift<C>(p.coefficients(), s));
+}
+
+// Powers of integer polynomials are raised pointwise in the transform
+// domain when that is possible, otherwise by repeated squaring.
+template<class C, std::integral U>
+struct math::impl::pow<UPoly<C>, U>{
+    static auto func(const UPoly<C>& base, U e) -> UPoly<C> {
+        if(e < 0) throw std::runtime_error("Negative power of a polynomial");
+        if(e == 0) return UPoly<C>::constant(C(1));
+        if(base.size() <= 1) return UPoly<C>::constant(base.is_zero() ? C(0) : math::pow(base[0], e));
+        if constexpr(upoly_impl::is_mpi<C>){
+            auto n = static_cast<unsigned long>(e);
+            if((base.size() - 1) * n + 1 >= upoly_impl::ntt_threshold){
+                if(auto ret = upoly_impl::ntt_power(base.coefficients(), n)) return UPoly<C>(std::move(*ret));
+            }
+        }
+        auto ret = UPoly<C>::constant(C(1));
+        auto square = base;
+        for(auto n = e;; n /= 2){
+            if(n % 2 == 1) ret *= square;
+            if(n / 2 == 0) break;
+            square *= square;
+        }
+        return ret;
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+#include "math/mpf.hpp"
+#include "evaluate.hpp"
+
+namespace symb{
+
+using multiprecision::MPf;
+
+inline auto call_builtin(Builtin f, const MPf& x) -> MPf {
+    switch(f){
+    case Builtin::Sin: return sin(x);
+    case Builtin::Cos: return cos(x);
+    case Builtin::Tan: return tan(x);
+    case Builtin::Exp: return exp(x);
+    case Builtin::Log: return log(x);
+    case Builtin::Sqrt: return sqrt(x);
+    }
+    throw std::runtime_error("Unknown builtin function");
+}
+
+struct PreciseResult {
+    MPf value;
+    // Precision of the last evaluation
+    mp_bitcnt_t working_precision;
+    // Estimated number of correct leading bits. Cancellation in additions
+    // and subtractions shows up as the difference to working_precision.
+    mp_bitcnt_t accurate_bits;
+};
+
+struct PrecisionOptions {
+    // Bits carried beyond the target to absorb rounding errors
+    mp_bitcnt_t guard_bits = 32;
+    // Upper limit for the working precision, an expression that is exactly
+    // zero cancels completely at every precision and would never converge.
+    mp_bitcnt_t max_precision = 1 << 16;
+    // A result that cancels completely is taken to be exactly zero once it
+    // still does at this precision. No finite precision can tell a zero
+    // from a small enough value, this bounds the search.
+    mp_bitcnt_t zero_precision = 1 << 12;
+};
+
+// Evaluates the first output of p once, all operations at the given precision.
+auto evaluate_mpf(const Program& p, std::span<const impl::ExpressionBase::Number_t> vars, mp_bitcnt_t precision) -> PreciseResult;
+
+// Evaluates the first output of p to a relative accuracy of 2^-bits. The
+// working precision is raised by the accuracy lost to cancellation in a
+// first pass, then the result is accepted once two evaluations at different precisions
+// agree to the target (Ziv's strategy), otherwise the precision is doubled.
+// Throws if max_precision is reached first.
+auto evaluate_precise(
+    const Program& p,
+    std::span<const impl::ExpressionBase::Number_t> vars,
+    mp_bitcnt_t bits,
+    PrecisionOptions options = {}
+) -> PreciseResult;
+
+// The first output of p correctly rounded to the given number of significant
+// decimal digits, in scientific notation. Values exactly halfway between
+// two decimals can't be told apart from their neighbours and are rounded as
+// the final approximation falls.
+auto evaluate_digits(
+    const Program& p,
+    std::span<const impl::ExpressionBase::Number_t> vars,
+    std::size_t digits,
+    PrecisionOptions options = {}
+) -> std::string;
+
+} // namespace symb
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cse.hpp"
+#include "evaluate.hpp"
+#include "symbolic.hpp"
+
+namespace symb{
+namespace codegen{
+
+enum class Language {
+    C,
+    Cpp
+};
+
+struct Options {
+    std::string function_name = "evaluate";
+    Language language = Language::C;
+    // Additionally emit <function_name>_batch, which evaluates the
+    // expressions over arrays in a loop the compiler can vectorize.
+    bool batch = false;
+    // Form of polynomial subexpressions, see CompileOptions
+    PolynomialForm polynomial = PolynomialForm::Horner;
+};
+
+// Emits a self-contained C or C++ function computing exprs at the point
+// given by vars:
+//     void <function_name>(const double* in, double* out)
+// in[i] is the value of vars[i] and out[j] receives exprs[j]. Subexpressions
+// shared between the outputs are computed once.
+auto emit_c(const std::vector<Symbolic>& exprs, const std::vector<std::string>& vars, Options options = {}) -> std::string;
+
+// The same for the outputs of a cse, the temporaries are computed first
+auto emit_c(const CseResult& cse, const std::vector<std::string>& vars, Options options = {}) -> std::string;
+
+} // namespace codegen
+} // namespace symb
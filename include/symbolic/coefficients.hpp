@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Coefficients of an expression taken as a sum of terms in powers of its
+// symbols, as expand leaves it. A term's degree in x is the integer
+// exponent of its factor x, zero without one. Other occurrences of x, as
+// in sin(x) or (1 + x)^2, are part of the coefficient.
+//
+// The index is built in one pass over the terms: every factor that is an
+// integer power of a symbol puts its term into the bucket of that symbol
+// and degree, along with the position of the factor to leave out. Queries
+// only visit the terms of their bucket. A second pass gives each symbol
+// the bucket of terms without a power of it, so that the const queries
+// never write and may run concurrently.
+class CoefficientIndex {
+public:
+    explicit CoefficientIndex(Symbolic _expr);
+
+    // The coefficient of x^k, x has to be a symbol
+    auto coeff(const Symbolic& x, long k) const -> Symbolic;
+
+    // The largest degree in x, zero for an expression without terms
+    auto degree(const Symbolic& x) const -> long;
+
+    // The sum of coeff(x, k) x^k over the degrees present
+    auto collect(const Symbolic& x) const -> Symbolic;
+
+    auto expr() const -> const Symbolic& { return m_expr; }
+
+private:
+    // A term and the position of the power of the symbol among its factors
+    struct Entry {
+        std::uint32_t term;
+        std::uint32_t factor;
+    };
+
+    struct Buckets {
+        std::unordered_map<long, std::vector<Entry>> degrees;
+        std::size_t size = 0;
+        std::vector<Entry> constant;
+    };
+
+    auto terms() const -> std::span<const impl::ExprPtr>;
+    auto bucket(const Symbolic& x, long k) const -> std::span<const Entry>;
+
+    Symbolic m_expr;
+    std::unordered_map<std::string, Buckets> m_symbols;
+};
+
+// Single queries, each builds an index
+auto coeff(const Symbolic& expr, const Symbolic& x, long k) -> Symbolic;
+auto degree(const Symbolic& expr, const Symbolic& x) -> long;
+auto collect(const Symbolic& expr, const Symbolic& x) -> Symbolic;
+
+} // namespace symb
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <compare>
+#include <cstddef>
+#include <cstdint>
 #include <ranges>
+#include <span>
 
 
 #include "expression.hpp"
@@ -15,6 +18,20 @@ template<std::ranges::range A, std::ranges::range B>
 
 [[nodiscard]] std::strong_ordering cmp_expression(const ExprPtr& lhs, const ExprPtr& rhs);
 
+// A hash of the structure of an expression, equal for expressions that
+// compare equal. hash_node combines the hashes of the children of e, for
+// callers that visit the tree bottom-up anyway.
+[[nodiscard]] std::size_t hash_expression(const ExprPtr& e);
+[[nodiscard]] std::size_t hash_node(const ExprPtr& e, std::span<const std::size_t> children);
+
+// Scrambles the bits of h, the splitmix64 finalizer. Used to combine hashes.
+[[nodiscard]] constexpr auto mix(std::uint64_t h) -> std::uint64_t {
+    h += 0x9e3779b97f4a7c15;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+    return h ^ (h >> 31);
+}
+
 [[nodiscard]] constexpr auto cmp_kind(Kind a, Kind b) -> std::strong_ordering {
     return static_cast<int>(a) <=> static_cast<int>(b);
 }
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "evaluate.hpp"
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Temporaries in the order they can be computed, each definition only
+// refers to earlier temporaries, and the outputs in terms of them.
+// Substituting the temporaries back in reverse order gives the inputs.
+struct CseResult {
+    std::vector<std::pair<Symbolic, Symbolic>> temporaries;
+    std::vector<Symbolic> outputs;
+};
+
+struct CseOptions {
+    // Temporaries are named prefix0, prefix1, ..., skipping names that
+    // occur in the inputs
+    std::string prefix = "t";
+};
+
+// Common subexpression elimination over several expressions together.
+//
+// Structurally equal subtrees are merged into one node of a graph by their
+// hash, so a subtree repeated inside a repeated subtree is counted once.
+// Sums and products sharing two or more operands, as a+b+c and a+b+d, are
+// rewritten to use a new node for the shared part, a+b, which then counts
+// as repeated. Every node used more than once becomes a temporary, except
+// numbers, symbols and negated symbols.
+auto cse(const std::vector<Symbolic>& exprs, CseOptions options = {}) -> CseResult;
+
+// Compiles the outputs of a cse, computing every temporary once.
+auto compile(const CseResult& cse, std::vector<std::string> variables, CompileOptions options = {}) -> Program;
+
+} // namespace symb
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "math/math_functions.hpp"
+#include "expression.hpp"
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Elementary functions the evaluators know how to compute.
+enum class Builtin : std::uint8_t {
+    Sin,
+    Cos,
+    Tan,
+    Exp,
+    Log,
+    Sqrt
+};
+
+enum class OpCode : std::uint8_t {
+    Constant,   // constants[a]
+    Variable,   // variables[a]
+    Add,        // r[a] + r[b]
+    Sub,        // r[a] - r[b]
+    Mul,        // r[a] * r[b]
+    Div,        // r[a] / r[b]
+    Neg,        // -r[a]
+    PowInt,     // r[a] ^ n, n >= 2
+    Pow,        // r[a] ^ r[b]
+    Call        // fn(r[a])
+};
+
+// One instruction of a compiled program. The result of instruction i is
+// stored in register i, so the code is in SSA form and topologically sorted.
+struct Instruction {
+    OpCode op;
+    Builtin fn = Builtin::Sin;
+    std::uint32_t a = 0;
+    std::uint32_t b = 0;
+    long n = 0;
+};
+
+// An expression (or several expressions sharing subexpressions) lowered
+// into a flat list of instructions.
+struct Program {
+    using Number_t = impl::ExpressionBase::Number_t;
+
+    std::vector<Instruction> code;
+    std::vector<Number_t> constants;
+    // constants rounded to the nearest double, used by the floating point evaluators
+    std::vector<double> constant_values;
+    std::vector<std::string> variables;
+    std::vector<std::uint32_t> outputs;
+
+    auto registers() const -> std::size_t { return code.size(); }
+};
+
+// How sums of monomials are lowered. Every atom, a symbol or any other
+// subexpression which is not a sum or product, counts as a variable.
+enum class PolynomialForm : std::uint8_t {
+    // Term by term as written
+    Expanded,
+    // Nested multiplications, the atom occurring in most terms is factored
+    // out first
+    Horner,
+    // Horner, except that dense polynomials in the factored atom combine
+    // pairs of coefficients with x, x^2, x^4, ..., which gives independent
+    // instructions for pipelined and vectorized execution
+    Estrin
+};
+
+struct CompileOptions {
+    PolynomialForm polynomial = PolynomialForm::Horner;
+};
+
+struct BatchOptions {
+    // 0 selects std::thread::hardware_concurrency()
+    unsigned threads = 0;
+    // Number of points evaluated together, 0 picks it from the register count
+    std::size_t chunk_size = 0;
+};
+
+// Aligned to a cache line so that threads updating their own counters
+// do not invalidate each others lines.
+struct alignas(64) ThreadStats {
+    std::size_t points = 0;
+    std::size_t chunks = 0;
+    std::size_t stolen_chunks = 0;
+    double seconds = 0;
+
+    auto throughput() const -> double {
+        return seconds > 0 ? static_cast<double>(points) / seconds : 0;
+    }
+};
+
+struct BatchStats {
+    std::size_t chunk_size = 0;
+    std::vector<ThreadStats> threads;
+};
+
+auto builtin_name(Builtin f) -> std::string;
+auto find_builtin(const std::string& name) -> std::optional<Builtin>;
+
+inline double call_builtin(Builtin f, double x) {
+    switch(f){
+    case Builtin::Sin: return std::sin(x);
+    case Builtin::Cos: return std::cos(x);
+    case Builtin::Tan: return std::tan(x);
+    case Builtin::Exp: return std::exp(x);
+    case Builtin::Log: return std::log(x);
+    case Builtin::Sqrt: return std::sqrt(x);
+    }
+    return std::nan("");
+}
+
+// f applied to a symbolic argument, as the function call of the same name
+inline auto call_builtin(Builtin f, const Symbolic& x) -> Symbolic {
+    return func(builtin_name(f))(x);
+}
+
+// The small integer v as a T, with Symbolic numbers made by num
+template<class T>
+T builtin_constant(int v) {
+    if constexpr(std::same_as<T, Symbolic>) return num(v);
+    else return T(v);
+}
+
+// Derivative of f at x, where fx = f(x) has already been computed. This is
+// the only table of derivative rules: over Symbolic it gives the rule diff
+// applies through the chain rule, over numbers the one the evaluators use.
+template<class T>
+T builtin_derivative(Builtin f, const T& x, const T& fx) {
+    switch(f){
+    case Builtin::Sin: return call_builtin(Builtin::Cos, x);
+    case Builtin::Cos: return -call_builtin(Builtin::Sin, x);
+    case Builtin::Tan: return builtin_constant<T>(1) + fx * fx;
+    case Builtin::Exp: return fx;
+    case Builtin::Log: return builtin_constant<T>(1) / x;
+    case Builtin::Sqrt: return builtin_constant<T>(1) / (builtin_constant<T>(2) * fx);
+    }
+    throw std::runtime_error(fmt::format("Unknown builtin: {}", static_cast<int>(f)));
+}
+
+namespace impl{
+
+auto to_double(const ExpressionBase::Number_t& v) -> double;
+
+auto compile(std::span<const ExprPtr> exprs, std::vector<std::string> variables, CompileOptions options = {}) -> Program;
+
+// The result of instruction i of p, for any type providing the field
+// operations, math::pow and an overload of call_builtin.
+template<class T>
+auto step(const Program& p, std::size_t i, std::span<const T> constants, std::span<const T> vars, std::span<const T> regs) -> T {
+    const auto& ins = p.code[i];
+    switch(ins.op){
+    case OpCode::Constant: return constants[ins.a];
+    case OpCode::Variable: return vars[ins.a];
+    case OpCode::Add: return regs[ins.a] + regs[ins.b];
+    case OpCode::Sub: return regs[ins.a] - regs[ins.b];
+    case OpCode::Mul: return regs[ins.a] * regs[ins.b];
+    case OpCode::Div: return regs[ins.a] / regs[ins.b];
+    case OpCode::Neg: return -regs[ins.a];
+    case OpCode::PowInt: return math::pow(regs[ins.a], ins.n);
+    case OpCode::Pow: return math::pow(regs[ins.a], regs[ins.b]);
+    case OpCode::Call: return call_builtin(ins.fn, regs[ins.a]);
+    }
+    return T{};
+}
+
+// Runs a program over all of its instructions. The constants have to be
+// converted to T by the caller, since only it knows how to do so exactly.
+template<class T>
+void execute(const Program& p, std::span<const T> constants, std::span<const T> vars, std::span<T> regs) {
+    for(std::size_t i = 0; i < p.code.size(); i++){
+        regs[i] = step<T>(p, i, constants, vars, regs);
+    }
+}
+
+} // namespace impl
+
+auto compile(const Symbolic& expr, std::vector<std::string> variables, CompileOptions options = {}) -> Program;
+auto compile(const std::vector<Symbolic>& exprs, std::vector<std::string> variables, CompileOptions options = {}) -> Program;
+
+// Evaluates the first output of p at a single point.
+auto evaluate(const Program& p, std::span<const double> vars) -> double;
+
+// Evaluates every output of p at n points. inputs holds one column of n
+// values per program variable, outputs one column per program output.
+auto evaluate_batch(
+    const Program& p,
+    std::span<const std::span<const double>> inputs,
+    std::span<const std::span<double>> outputs,
+    BatchOptions options = {}
+) -> BatchStats;
+
+} // namespace symb
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Multiplies out all products and non-negative integer powers of sums.
+// Anything else (symbols, functions, fractional or negative powers) is an
+// atom, whose arguments are expanded in turn. The result is a polynomial
+// in these atoms, built as a whole: powers of sums use the multinomial
+// theorem, products of sums a heap merge, and terms are collected in a
+// hash table keyed by their exponents, without intermediate trees.
+auto expand(const Symbolic& expr) -> Symbolic;
+
+} // namespace symb
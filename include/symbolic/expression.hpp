@@ -319,6 +319,20 @@ struct Undefined : public ExpressionBase{
 };
 
 
+// A node of the same kind (and name) as e with the given children.
+inline auto with_children(const ExprPtr& e, std::vector<ExprPtr> children) -> ExprPtr {
+    ExprPtr ret;
+    switch(e->kind()){
+    case Kind::SumOp: ret = make_expression<Sum>(std::vector<ExprPtr>{}); break;
+    case Kind::ProdOp: ret = make_expression<Product>(std::vector<ExprPtr>{}); break;
+    case Kind::PowOp: ret = make_expression<Power>(nullptr, nullptr); break;
+    case Kind::Function: ret = make_expression<Function>(get_as<Function>(e)->name, std::vector<ExprPtr>{}); break;
+    default: return e->copy();
+    }
+    ret->children = std::move(children);
+    return ret;
+}
+
 // Unpacks an expression val into a pair c, t such that:
 // c is a number
 // c*t == val
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "math/dual.hpp"
+#include "evaluate.hpp"
+
+namespace symb{
+
+// Builtins over dual numbers apply the chain rule with the derivative rules
+// from builtin_derivative. Nested duals recurse into these overloads again.
+template<class T>
+auto call_builtin(Builtin f, const Dual<T>& x) -> Dual<T> {
+    auto fx = call_builtin(f, x.value);
+    auto dfx = builtin_derivative(f, x.value, fx);
+    return Dual<T>(std::move(fx), dfx * x.derivative);
+}
+
+template<class T, std::size_t N>
+auto call_builtin(Builtin f, const VectorDual<T, N>& x) -> VectorDual<T, N> {
+    auto fx = call_builtin(f, x.value);
+    auto dfx = builtin_derivative(f, x.value, fx);
+    return x.apply(std::move(fx), dfx);
+}
+
+// Evaluates the first output of p over any of the dual number types. The
+// constants enter as plain values without infinitesimal part.
+template<class D>
+auto evaluate_forward(const Program& p, std::span<const D> x) -> D {
+    if(x.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} variables, got {}", p.variables.size(), x.size()
+        ));
+    }
+    std::vector<D> constants(p.constant_values.begin(), p.constant_values.end());
+    std::vector<D> regs(p.registers());
+    impl::execute<D>(p, constants, x, regs);
+    return regs[p.outputs.at(0)];
+}
+
+// f(x) and the derivative of f at x in direction v
+auto directional_derivative(const Program& p, std::span<const double> x, std::span<const double> v) -> Dual<double>;
+
+// Derivatives of f at x in N directions at once, directions[k] is a vector
+// of the same length as x.
+template<std::size_t N>
+auto directional_derivatives(const Program& p, std::span<const double> x, const std::array<std::span<const double>, N>& directions) -> VectorDual<double, N> {
+    for(const auto& v : directions){
+        if(v.size() != x.size()){
+            throw std::runtime_error("Direction and point must have the same dimension");
+        }
+    }
+    std::vector<VectorDual<double, N>> args;
+    for(std::size_t i = 0; i < x.size(); i++){
+        auto& arg = args.emplace_back(x[i]);
+        for(std::size_t k = 0; k < N; k++) arg.derivatives[k] = directions[k][i];
+    }
+    return evaluate_forward<VectorDual<double, N>>(p, args);
+}
+
+// Writes H(x)*v to hv, where H is the Hessian of f. A single forward sweep
+// over dual numbers seeded along v is followed by the reverse sweep of the
+// gradient, so the cost does not grow with the number of variables.
+// Returns f(x).
+auto hessian_vector_product(const Program& p, std::span<const double> x, std::span<const double> v, std::span<double> hv) -> double;
+
+} // namespace symb
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "evaluate.hpp"
+
+namespace symb{
+
+namespace impl{
+
+// The reverse sweep for the first output of p, given the registers v of a
+// forward sweep. adj takes one adjoint per register and the gradient is
+// written to gradient. Over Dual<double> with the forward sweep seeded along
+// a direction, the derivative parts of the gradient are the Hessian times
+// that direction.
+template<class T>
+void reverse_sweep(const Program& p, std::span<const T> v, std::span<T> adj, std::span<T> gradient) {
+    using std::log;
+    std::fill(adj.begin(), adj.end(), T{});
+    std::fill(gradient.begin(), gradient.end(), T{});
+    adj[p.outputs[0]] = T(1);
+    for(auto i = p.outputs[0] + 1; i-- > 0;){
+        const auto& ins = p.code[i];
+        auto d = adj[i];
+        // Registers that do not contribute to the output are skipped entirely.
+        if(d == T{}) continue;
+        switch(ins.op){
+        case OpCode::Constant: break;
+        case OpCode::Variable: gradient[ins.a] += d; break;
+        case OpCode::Add:
+            adj[ins.a] += d;
+            adj[ins.b] += d;
+            break;
+        case OpCode::Sub:
+            adj[ins.a] += d;
+            adj[ins.b] -= d;
+            break;
+        case OpCode::Mul:
+            adj[ins.a] += d * v[ins.b];
+            adj[ins.b] += d * v[ins.a];
+            break;
+        case OpCode::Div:
+            adj[ins.a] += d / v[ins.b];
+            adj[ins.b] -= d * v[i] / v[ins.b];
+            break;
+        case OpCode::Neg: adj[ins.a] -= d; break;
+        case OpCode::PowInt:
+            adj[ins.a] += d * T(ins.n) * math::pow(v[ins.a], ins.n - 1);
+            break;
+        case OpCode::Pow:
+            adj[ins.a] += d * v[ins.b] * math::pow(v[ins.a], v[ins.b] - T(1));
+            if(p.code[ins.b].op != OpCode::Constant){
+                adj[ins.b] += d * v[i] * log(v[ins.a]);
+            }
+            break;
+        case OpCode::Call:
+            adj[ins.a] += d * builtin_derivative(ins.fn, v[ins.a], v[i]);
+            break;
+        }
+    }
+}
+
+} // namespace impl
+
+// Computes the first output of a program together with its gradient with
+// respect to all program variables. The forward sweep keeps every register,
+// the reverse sweep then propagates adjoints through the same instructions,
+// so the gradient costs a small constant multiple of evaluating the value.
+class GradientKernel {
+public:
+    explicit GradientKernel(Program p);
+
+    // Returns f(x) and writes df/dx_i to gradient[i].
+    auto operator()(std::span<const double> x, std::span<double> gradient) -> double;
+
+    auto program() const -> const Program& { return m_program; }
+
+private:
+    Program m_program;
+    std::vector<double> m_values;
+    std::vector<double> m_adjoints;
+};
+
+auto compile_gradient(const Symbolic& expr, std::vector<std::string> variables) -> GradientKernel;
+
+} // namespace symb
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+enum class Identity {
+    Equal,
+    Different,
+    // Differing values were found, but the expressions contain functions or
+    // fractional powers whose identities the test knows nothing about.
+    Undecided
+};
+
+struct IdentityOptions {
+    // Upper bound for the probability that two different expressions are
+    // reported as Equal
+    double error_bound = 1e-30;
+    // Seed for primes and points, 0 draws one from std::random_device
+    std::uint64_t seed = 0;
+};
+
+// A Schwartz-Zippel identity test. Both sides are evaluated at random
+// points modulo random primes p > 2^62, each evaluation catches a
+// difference with probability at least 1 - d/p for the degree d of the
+// numerator of a - b, so a handful of them reach the error bound.
+//
+// Functions and non-integer powers are treated as unknown functions of
+// their arguments with pseudo-random values. Different is therefore only
+// returned for rational expressions, which makes it certain.
+auto test_identity(const Symbolic& a, const Symbolic& b, IdentityOptions options = {}) -> Identity;
+
+// test_identity, with exact comparison of the simplified difference as
+// the fallback for Undecided.
+auto probably_equal(const Symbolic& a, const Symbolic& b, IdentityOptions options = {}) -> bool;
+
+} // namespace symb
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "evaluate.hpp"
+
+namespace symb{
+
+// Caches the value of every node of a program and re-evaluates only the
+// nodes depending on the variables changed since the last update.
+//
+// The nodes depending on a variable are those whose free symbols contain
+// it, they are found by walking the consumer edges of the program from the
+// variable. Updates visit them in program order, which is topological, and
+// stop propagating along nodes whose value did not change.
+class EvaluationGraph {
+public:
+    EvaluationGraph(Program program, std::span<const double> point);
+
+    void set(std::size_t variable, double value);
+    void set(const std::string& variable, double value);
+
+    // Recomputes the pending nodes, returns how many were evaluated
+    auto update() -> std::size_t;
+
+    // Value of output k, updated if necessary
+    auto value(std::size_t k = 0) -> double;
+
+    auto program() const -> const Program& { return m_program; }
+
+private:
+    void invalidate_consumers(std::uint32_t node);
+
+    Program m_program;
+    std::vector<double> m_vars;
+    std::vector<double> m_regs;
+    // Consumers of node i are m_consumers[m_offsets[i] .. m_offsets[i+1])
+    std::vector<std::uint32_t> m_offsets;
+    std::vector<std::uint32_t> m_consumers;
+    // The Variable node of each variable, or none if it is unused
+    std::vector<std::uint32_t> m_variable_nodes;
+    // Min-heap of nodes waiting to be recomputed
+    std::vector<std::uint32_t> m_pending;
+    std::vector<bool> m_queued;
+};
+
+} // namespace symb
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+
+#include "math/interval.hpp"
+#include "evaluate.hpp"
+
+namespace symb{
+
+template<std::floating_point T>
+auto call_builtin(Builtin f, const Interval<T>& x) -> Interval<T> {
+    switch(f){
+    case Builtin::Sin: return sin(x);
+    case Builtin::Cos: return cos(x);
+    case Builtin::Tan: return tan(x);
+    case Builtin::Exp: return exp(x);
+    case Builtin::Log: return log(x);
+    case Builtin::Sqrt: return sqrt(x);
+    }
+    return Interval<T>::invalid();
+}
+
+// Encloses the first output of p over the box given by one interval per
+// variable. The result is rigorous: it contains the exact value of the
+// expression at every point of the box.
+auto evaluate_interval(const Program& p, std::span<const Interval<double>> box) -> Interval<double>;
+
+// Encloses the first output over many boxes. boxes holds the boxes one
+// after another, each with one interval per program variable, out receives
+// one enclosure per box. The rounding mode is switched once for all of them.
+void evaluate_interval_batch(const Program& p, std::span<const Interval<double>> boxes, std::span<Interval<double>> out);
+
+} // namespace symb
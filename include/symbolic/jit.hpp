@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include "evaluate.hpp"
+
+namespace symb{
+
+// Machine code compiled from a Program, living in its own executable pages.
+// Only x86-64 with the System V calling convention is supported, on other
+// targets jit_compile throws.
+class JitFunction {
+public:
+    // Evaluates the first output at in[0..variables)
+    using Scalar = double(*)(const double* in);
+    // Evaluates all outputs at n points, in[i] and out[j] are columns as
+    // in evaluate_batch. Two points are processed per iteration with packed
+    // SSE2 instructions.
+    using Batch = void(*)(std::size_t n, const double* const* in, double* const* out);
+
+    JitFunction(void* _memory, std::size_t _size, Scalar _scalar, Batch _batch)
+        : m_memory{_memory}, m_size{_size}, m_scalar{_scalar}, m_batch{_batch}
+    {}
+
+    JitFunction(const JitFunction&) = delete;
+    auto operator=(const JitFunction&) -> JitFunction& = delete;
+
+    JitFunction(JitFunction&& other)
+        : m_memory{std::exchange(other.m_memory, nullptr)}, m_size{other.m_size},
+          m_scalar{other.m_scalar}, m_batch{other.m_batch}
+    {}
+
+    auto operator=(JitFunction&& other) -> JitFunction& {
+        std::swap(m_memory, other.m_memory);
+        std::swap(m_size, other.m_size);
+        std::swap(m_scalar, other.m_scalar);
+        std::swap(m_batch, other.m_batch);
+        return *this;
+    }
+
+    ~JitFunction();
+
+    auto operator()(const double* in) const -> double { return m_scalar(in); }
+    auto scalar() const -> Scalar { return m_scalar; }
+    auto batch() const -> Batch { return m_batch; }
+
+private:
+    void* m_memory;
+    std::size_t m_size;
+    Scalar m_scalar;
+    Batch m_batch;
+};
+
+auto jit_compile(const Program& p) -> JitFunction;
+
+} // namespace symb
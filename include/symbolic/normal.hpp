@@ -0,0 +1,17 @@
+#pragma once
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Brings an expression over a common denominator: the quotient of two
+// expanded polynomials in its atoms without common factors. The atoms are
+// the symbols, functions and non-integer powers, with their arguments in
+// normal form in turn. The atoms are ordered as by cmp_expression, not as
+// they occur in expr, and the denominator has coprime integer coefficients
+// and a positive leading coefficient in that order, so equal rational
+// functions have equal normal forms: 1/(x-y) and y/(x*y-y^2) both give
+// (x-y)^-1. Throws on a division by zero.
+auto normal(const Symbolic& expr) -> Symbolic;
+
+} // namespace symb
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+// A wildcard in a pattern, the symbol named name followed by an
+// underscore. It matches any subexpression, and the same one wherever it
+// occurs in a pattern.
+auto wild(const std::string& name) -> Symbolic;
+
+// The subexpressions the wildcards matched, by the names given to wild
+using Bindings = std::unordered_map<std::string, Symbolic>;
+
+using Rule = std::pair<Symbolic, Symbolic>;
+
+// Matches the whole of expr. Patterns match structurally, except that the
+// operands of sums and products match in any order. There a wildcard that
+// is an operand of its own matches one operand, the last such wildcard
+// all operands left over.
+auto match(const Symbolic& expr, const Symbolic& pattern) -> std::optional<Bindings>;
+
+// Where patterns can match in an expression. Nodes are numbered in
+// preorder, so a subtree is a range of numbers, and listed by kind and by
+// their head: the name of a function or symbol, or the symbol a power is
+// of. A pattern is only tried at the nodes of its kind and head.
+class PatternIndex {
+public:
+    explicit PatternIndex(Symbolic _expr);
+    // The index points into its own copy of the expression
+    PatternIndex(const PatternIndex&) = delete;
+    PatternIndex(PatternIndex&&) = default;
+    auto operator=(const PatternIndex&) -> PatternIndex& = delete;
+    auto operator=(PatternIndex&&) -> PatternIndex& = default;
+
+    // The nodes a pattern may match at, all of them for a wildcard
+    auto candidates(const Symbolic& pattern) const -> std::vector<const impl::ExpressionBase*>;
+
+    // Replaces the outermost matches of the patterns by their templates,
+    // the wildcards substituted. The rules are tried in order. A sum or
+    // product pattern also matches some of the operands of a larger sum or
+    // product, which are then replaced with the others left alone. Only
+    // the candidates of the patterns and the nodes above them are visited.
+    auto replace_all(const std::vector<Rule>& rules) const -> Symbolic;
+
+    auto expr() const -> const Symbolic& { return m_expr; }
+
+private:
+    // Heads point into the names in m_expr
+    using Key = std::pair<impl::Kind, std::string_view>;
+
+    struct KeyHash {
+        auto operator()(const Key& k) const -> std::size_t {
+            return std::hash<std::string_view>{}(k.second) * 31 + static_cast<std::size_t>(k.first);
+        }
+    };
+
+    void add(const impl::ExprPtr& e);
+    auto positions(const Symbolic& pattern) const -> const std::vector<std::uint32_t>&;
+
+    Symbolic m_expr;
+    std::vector<const impl::ExpressionBase*> m_nodes;
+    // One past the last node of the subtree of each node
+    std::vector<std::uint32_t> m_end;
+    std::vector<std::uint32_t> m_all;
+    std::unordered_map<impl::Kind, std::vector<std::uint32_t>> m_by_kind;
+    std::unordered_map<Key, std::vector<std::uint32_t>, KeyHash> m_by_head;
+};
+
+auto replace_all(const Symbolic& expr, const Symbolic& pattern, const Symbolic& replacement) -> Symbolic;
+auto replace_all(const Symbolic& expr, const std::vector<Rule>& rules) -> Symbolic;
+
+} // namespace symb
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "math/factor.hpp"
+#include "math/groebner.hpp"
+#include "math/poly_gcd.hpp"
+#include "math/real_roots.hpp"
+#include "math/resultant.hpp"
+#include "math/sparse_poly.hpp"
+#include "symbolic.hpp"
+
+namespace symb{
+
+using Rational = impl::ExpressionBase::Number_t;
+
+// Converts a polynomial expression in the given variables. Sums, products
+// and non-negative integer powers are multiplied out, any other symbol or
+// subexpression throws, as do non-integer coefficients for C = MPi.
+template<class C>
+auto to_sparse_poly(const Symbolic& expr, const std::vector<std::string>& variables, MonomialOrder order = MonomialOrder::Lex) -> SparsePoly<C>;
+
+// The expression of p with variable k named variables[k]
+template<class C>
+auto to_symbolic(const SparsePoly<C>& p, const std::vector<std::string>& variables) -> Symbolic;
+
+// The greatest common divisor of two polynomials in their symbols, see
+// gcd for SparsePoly: with a positive leading coefficient if both have
+// integer coefficients, monic otherwise. Throws for non-polynomials.
+auto gcd(const Symbolic& a, const Symbolic& b) -> Symbolic;
+
+// A polynomial as a product of a rational number and powers of primitive
+// integer polynomials with positive leading coefficients. square_free
+// gives pairwise coprime, square-free factors of distinct multiplicities.
+// factor gives the irreducible factors over Z for polynomials in one
+// symbol, and falls back to square_free for several. Throws for
+// non-polynomials.
+auto square_free(const Symbolic& expr) -> Symbolic;
+auto factor(const Symbolic& expr) -> Symbolic;
+
+// The reduced Gröbner basis over Q of the ideal the polynomials generate,
+// see groebner for SparsePoly, in the given variables and monomial order:
+// monic, by decreasing leading monomials. Throws for non-polynomials.
+auto groebner(const std::vector<Symbolic>& polys, const std::vector<std::string>& variables, MonomialOrder order = MonomialOrder::Grevlex, GroebnerOptions options = {}) -> std::vector<Symbolic>;
+
+// The resultant of two polynomials in variable, a polynomial in their
+// other symbols, and the discriminant of one, see resultant for
+// SparsePoly. Throws for non-polynomials.
+auto resultant(const Symbolic& a, const Symbolic& b, const std::string& variable) -> Symbolic;
+auto discriminant(const Symbolic& a, const std::string& variable) -> Symbolic;
+
+// Isolating intervals of the distinct real roots of a polynomial in
+// variable, see real_roots for UPoly, as pairs of rational numbers that
+// are equal for roots found exactly. Throws for non-polynomials, other
+// symbols and zero.
+auto real_roots(const Symbolic& expr, const std::string& variable, RealRootOptions options = {}) -> std::vector<std::pair<Symbolic, Symbolic>>;
+
+extern template auto to_sparse_poly<multiprecision::MPi>(const Symbolic&, const std::vector<std::string>&, MonomialOrder) -> SparsePoly<multiprecision::MPi>;
+extern template auto to_sparse_poly<Rational>(const Symbolic&, const std::vector<std::string>&, MonomialOrder) -> SparsePoly<Rational>;
+extern template auto to_symbolic<multiprecision::MPi>(const SparsePoly<multiprecision::MPi>&, const std::vector<std::string>&) -> Symbolic;
+extern template auto to_symbolic<Rational>(const SparsePoly<Rational>&, const std::vector<std::string>&) -> Symbolic;
+
+} // namespace symb
@@ -64,6 +64,8 @@ struct Simplifier{
     static ExprPtr automatic_simplify(ExprPtr);
 
     static ExprPtr automatic_simplify_impl(const SimplificationContext& sc, ExprPtr t);
+    // Simplifies t assuming its children are simplified already
+    static ExprPtr automatic_simplify_node(const SimplificationContext& sc, ExprPtr t);
     static ExprPtr automatic_simplify_product(const SimplificationContext& sc, ExprPtr t);
     static ExprPtr automatic_simplify_sum(const SimplificationContext& sc, ExprPtr t);
     static ExprPtr automatic_simplify_power(const SimplificationContext& sc, ExprPtr t);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "evaluate.hpp"
+#include "symbolic.hpp"
+
+namespace symb{
+
+using Parameters = std::unordered_map<std::string, impl::ExpressionBase::Number_t>;
+
+// Replaces the given parameters by their values and constant-folds the
+// result in the same bottom-up pass. Only nodes above a replaced parameter
+// are simplified again, everything else is already in canonical form.
+auto specialize(const Symbolic& expr, const Parameters& params) -> Symbolic;
+
+// Specializes expr and compiles the result over the remaining variables.
+auto specialize(const Symbolic& expr, const Parameters& params, std::vector<std::string> variables) -> Program;
+
+} // namespace symb
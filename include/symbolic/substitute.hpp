@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "symbolic.hpp"
+
+namespace symb{
+
+// Replaces subexpressions, all at once: the replacements are not searched
+// for further matches. A subexpression matches when it compares equal to
+// a pattern in automatically simplified form, so x*y matches in sin(x*y)
+// but not in 2*x*y, whose product has three factors.
+//
+// The tree is walked once, bottom-up, hashing every node from the hashes
+// of its children. Subtrees that occur several times are substituted once,
+// later copies are looked up by their hash. Only the nodes above a
+// replacement are simplified again.
+auto subs(const Symbolic& expr, const std::vector<std::pair<Symbolic, Symbolic>>& rules) -> Symbolic;
+
+// Replaces symbols by name
+auto subs(const Symbolic& expr, const std::unordered_map<std::string, Symbolic>& symbols) -> Symbolic;
+
+} // namespace symb
@@ -83,8 +83,22 @@ public:
         };
     }
 
+    auto expr() const -> const impl::ExprPtr& { return m_expr; }
+
+    // Wraps an expression that is already in automatically simplified form,
+    // skipping the simplification pass of the constructor.
+    static auto from_simplified(impl::ExprPtr e) -> Symbolic {
+        return Symbolic(std::move(e), simplified_tag{});
+    }
+
     friend auto func(std::string name);
 private:
+    struct simplified_tag{};
+
+    Symbolic(impl::ExprPtr e, simplified_tag)
+        : m_expr{std::move(e)}
+    {}
+
     impl::ExprPtr m_expr;
 };
 
@@ -95,11 +109,11 @@ Symbolic num(T v) {
     return Symbolic(std::make_unique<impl::Number>(v));
 }
 
-Symbolic var(std::string name) {
+inline Symbolic var(std::string name) {
     return Symbolic(impl::make_expression<impl::Symbol>(name));
 }
 
-auto func(std::string name){
+inline auto func(std::string name){
     return [name]<class... Ts>(Ts&&... ts){
         std::vector<impl::ExprPtr> exprs;
         (
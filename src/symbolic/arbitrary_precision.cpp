@@ -0,0 +1,136 @@
+#include "symbolic/arbitrary_precision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace symb{
+
+namespace{
+
+using Number_t = impl::ExpressionBase::Number_t;
+
+auto to_mpf(const Number_t& v, mp_bitcnt_t precision) -> MPf {
+    return MPf(v.num(), precision) / MPf(v.denom(), precision);
+}
+
+auto bit_length(long n) -> long {
+    long ret = 0;
+    for(n = n < 0 ? -n : n; n != 0; n >>= 1) ret++;
+    return ret;
+}
+
+// A first order estimate of the number of correct leading bits of every
+// register of the last run, starting from full accuracy at the leaves.
+// Additions carry over the absolute errors of their operands, so a sum
+// that cancels k leading bits loses k bits of relative accuracy, while
+// the other operations lose a bit for rounding plus their condition number.
+auto accuracy(const Program& p, std::span<const MPf> regs, mp_bitcnt_t precision) -> long {
+    auto full = static_cast<long>(precision);
+    auto exponent = [&](std::uint32_t i){ return regs[i].exponent(); };
+    auto zero = [&](std::uint32_t i){ return mpf_sgn(regs[i].handle()) == 0; };
+    std::vector<long> acc(p.code.size(), full);
+    for(std::uint32_t i = 0; i < p.code.size(); i++){
+        const auto& ins = p.code[i];
+        auto a = ins.a;
+        auto b = ins.b;
+        switch(ins.op){
+        case OpCode::Constant: case OpCode::Variable: break;
+        case OpCode::Add: case OpCode::Sub: {
+            if(zero(a) && zero(b)) break;
+            if(zero(i)){
+                acc[i] = 0;
+                break;
+            }
+            auto error = std::numeric_limits<long>::min();
+            if(not zero(a)) error = std::max(error, exponent(a) - acc[a]);
+            if(not zero(b)) error = std::max(error, exponent(b) - acc[b]);
+            acc[i] = exponent(i) - error - 1;
+            break;
+        }
+        case OpCode::Mul: case OpCode::Div: acc[i] = std::min(acc[a], acc[b]) - 1; break;
+        case OpCode::Neg: acc[i] = acc[a]; break;
+        case OpCode::PowInt: acc[i] = acc[a] - bit_length(ins.n) - 1; break;
+        case OpCode::Pow: acc[i] = std::min(acc[a], acc[b]) - bit_length(exponent(i)) - 1; break;
+        case OpCode::Call: {
+            auto e = std::max(0l, exponent(a));
+            switch(ins.fn){
+            case Builtin::Exp: acc[i] = acc[a] - e - 1; break;
+            case Builtin::Log: acc[i] = acc[a] + exponent(i) - 1; break;
+            case Builtin::Sqrt: acc[i] = acc[a]; break;
+            case Builtin::Sin: case Builtin::Cos: acc[i] = acc[a] - e + exponent(i) - 1; break;
+            case Builtin::Tan: acc[i] = acc[a] - e - std::abs(exponent(i)) - 2; break;
+            }
+            break;
+        }
+        }
+        acc[i] = std::clamp(acc[i], 0l, full);
+    }
+    return acc[p.outputs.at(0)];
+}
+
+} // namespace
+
+auto evaluate_mpf(const Program& p, std::span<const Number_t> vars, mp_bitcnt_t precision) -> PreciseResult {
+    if(vars.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format("Expected {} variables, got {}", p.variables.size(), vars.size()));
+    }
+    std::vector<MPf> constants;
+    for(const auto& c : p.constants) constants.push_back(to_mpf(c, precision));
+    std::vector<MPf> args;
+    for(const auto& v : vars) args.push_back(to_mpf(v, precision));
+    std::vector<MPf> regs(p.registers());
+    impl::execute<MPf>(p, constants, args, regs);
+    auto accurate = accuracy(p, regs, precision);
+    return {regs[p.outputs.at(0)], precision, static_cast<mp_bitcnt_t>(accurate)};
+}
+
+auto evaluate_precise(const Program& p, std::span<const Number_t> vars, mp_bitcnt_t bits, PrecisionOptions options) -> PreciseResult {
+    auto guard = options.guard_bits;
+    auto work = bits + guard;
+    while(work + guard <= options.max_precision){
+        auto first = evaluate_mpf(p, vars, work);
+        if(first.accurate_bits == 0 && work >= options.zero_precision){
+            // Cancelled completely, indistinguishable from zero
+            first.value = MPf::zero(work);
+            return first;
+        }
+        if(first.accurate_bits < bits + guard / 2){
+            // Raise the precision by the bits lost to cancellation
+            work = std::max(work + bits + guard - first.accurate_bits, work + work / 2);
+            continue;
+        }
+        auto second = evaluate_mpf(p, vars, work + guard);
+        auto diff = first.value - second.value;
+        if(mpf_sgn(diff.handle()) == 0 || diff.exponent() < second.value.exponent() - static_cast<long>(bits) - 1){
+            return second;
+        }
+        work *= 2;
+    }
+    throw std::runtime_error(fmt::format(
+        "No {} bit result within a working precision of {} bits", bits, options.max_precision
+    ));
+}
+
+auto evaluate_digits(const Program& p, std::span<const Number_t> vars, std::size_t digits, PrecisionOptions options) -> std::string {
+    auto bits = static_cast<mp_bitcnt_t>(std::ceil(static_cast<double>(digits) * std::log2(10.0))) + 8;
+    while(true){
+        // The value is within a relative 2^-bits, the rounding is correct
+        // once both ends of that neighbourhood round to the same digits.
+        auto r = evaluate_precise(p, vars, bits, options);
+        auto err = r.value.ldexp(-static_cast<long>(bits));
+        mpf_abs(err.handle(), err.handle());
+        auto lo = multiprecision::to_string(r.value - err, digits);
+        auto hi = multiprecision::to_string(r.value + err, digits);
+        if(lo == hi) return lo;
+        // Only values on a tie between two decimals stay undecided, those
+        // are rounded as the final approximation says.
+        if(2 * (bits + options.guard_bits) > options.max_precision){
+            return multiprecision::to_string(r.value, digits);
+        }
+        bits *= 2;
+    }
+}
+
+} // namespace symb
@@ -0,0 +1,173 @@
+#include "symbolic/codegen.hpp"
+
+#include <cmath>
+#include <functional>
+#include <map>
+#include <span>
+#include <utility>
+
+#include "symbolic/evaluate.hpp"
+
+namespace symb{
+namespace codegen{
+
+namespace{
+
+auto literal(double v) -> std::string {
+    if(std::isinf(v)) return v > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+    auto ret = fmt::format("{}", v);
+    if(ret.find_first_of(".en") == std::string::npos) ret += ".0";
+    if(v < 0) ret = "(" + ret + ")";
+    return ret;
+}
+
+// Writes the instructions of a program as a sequence of C statements.
+struct Emitter {
+    const Program& p;
+    Language language;
+    std::function<std::string(std::uint32_t)> variable;
+    std::function<std::string(std::size_t)> output;
+    std::string indent;
+
+    std::string body = {};
+    std::vector<std::string> operand = {};
+    // Repeated squares base^(2^k), shared by all integer powers of a base
+    std::map<std::pair<std::uint32_t, int>, std::string> squares = {};
+    // Temporaries by their defining expression, so that partial products of
+    // power chains are shared as well
+    std::map<std::string, std::string> declared = {};
+    int temporaries = 0;
+
+    auto declare(const std::string& value) -> std::string {
+        if(auto it = declared.find(value); it != declared.end()) return it->second;
+        auto name = fmt::format("t{}", temporaries++);
+        body += fmt::format("{}const double {} = {};\n", indent, name, value);
+        declared.emplace(value, name);
+        return name;
+    }
+
+    auto square(std::uint32_t base, int k) -> std::string {
+        if(k == 0) return operand[base];
+        auto key = std::pair{base, k};
+        if(auto it = squares.find(key); it != squares.end()) return it->second;
+        auto x = square(base, k - 1);
+        auto ret = declare(fmt::format("{} * {}", x, x));
+        squares.emplace(key, ret);
+        return ret;
+    }
+
+    // Integer powers become a chain of multiplications of repeated squares.
+    auto power(std::uint32_t base, long n) -> std::string {
+        std::string ret;
+        for(int k = 0; n != 0; k++, n >>= 1){
+            if(n & 1){
+                auto x = square(base, k);
+                ret = ret.empty() ? x : declare(fmt::format("{} * {}", ret, x));
+            }
+        }
+        return ret;
+    }
+
+    auto function(Builtin f) -> std::string {
+        auto name = builtin_name(f);
+        return language == Language::Cpp ? "std::" + name : name;
+    }
+
+    void run() {
+        for(const auto& ins : p.code){
+            auto a = ins.a < operand.size() ? operand[ins.a] : std::string{};
+            auto b = ins.b < operand.size() ? operand[ins.b] : std::string{};
+            switch(ins.op){
+            case OpCode::Constant: operand.push_back(literal(p.constant_values[ins.a])); break;
+            case OpCode::Variable: operand.push_back(variable(ins.a)); break;
+            case OpCode::Add: operand.push_back(declare(fmt::format("{} + {}", a, b))); break;
+            case OpCode::Sub: operand.push_back(declare(fmt::format("{} - {}", a, b))); break;
+            case OpCode::Mul: operand.push_back(declare(fmt::format("{} * {}", a, b))); break;
+            case OpCode::Div: operand.push_back(declare(fmt::format("{} / {}", a, b))); break;
+            case OpCode::Neg: operand.push_back(declare(fmt::format("-{}", a))); break;
+            case OpCode::PowInt: operand.push_back(power(ins.a, ins.n)); break;
+            case OpCode::Pow: operand.push_back(declare(fmt::format("{}({}, {})", language == Language::Cpp ? "std::pow" : "pow", a, b))); break;
+            case OpCode::Call: operand.push_back(declare(fmt::format("{}({})", function(ins.fn), a))); break;
+            }
+        }
+        for(std::size_t j = 0; j < p.outputs.size(); j++){
+            body += fmt::format("{}{} = {};\n", indent, output(j), operand[p.outputs[j]]);
+        }
+    }
+};
+
+// The function computing the outputs of p, which are exprs in terms of
+// the temporaries
+auto emit(const Program& p, std::span<const std::pair<Symbolic, Symbolic>> temporaries, const std::vector<Symbolic>& exprs, const std::vector<std::string>& vars, const Options& options) -> std::string {
+    auto cpp = options.language == Language::Cpp;
+    auto restrict_kw = cpp ? "__restrict" : "restrict";
+
+    std::string ret;
+    ret += cpp ? "#include <cmath>\n#include <cstddef>\n\n" : "#include <math.h>\n#include <stddef.h>\n\n";
+    ret += "// Inputs:\n";
+    for(std::size_t i = 0; i < vars.size(); i++){
+        ret += fmt::format("//   in[{}] = {}\n", i, vars[i]);
+    }
+    if(not temporaries.empty()) ret += "// Temporaries:\n";
+    for(const auto& [symbol, definition] : temporaries){
+        ret += fmt::format("//   {} = {}\n", symbol, definition);
+    }
+    ret += "// Outputs:\n";
+    for(std::size_t j = 0; j < exprs.size(); j++){
+        ret += fmt::format("//   out[{}] = {}\n", j, exprs[j]);
+    }
+
+    auto scalar = Emitter{
+        p, options.language,
+        [](std::uint32_t i){ return fmt::format("in[{}]", i); },
+        [](std::size_t j){ return fmt::format("out[{}]", j); },
+        "    "
+    };
+    scalar.run();
+    ret += fmt::format("void {}(const double* {} in, double* {} out)\n{{\n", options.function_name, restrict_kw, restrict_kw);
+    ret += scalar.body;
+    ret += "}\n";
+
+    if(options.batch){
+        // in[i] and out[j] are arrays of n values each, the loop body is the
+        // scalar code with every load and store indexed by the point.
+        auto batch = Emitter{
+            p, options.language,
+            [](std::uint32_t i){ return fmt::format("x{}[k]", i); },
+            [](std::size_t j){ return fmt::format("y{}[k]", j); },
+            "        "
+        };
+        batch.run();
+        ret += fmt::format(
+            "\nvoid {}_batch(size_t n, const double* const* in, double* const* out)\n{{\n",
+            options.function_name
+        );
+        for(std::size_t i = 0; i < vars.size(); i++){
+            ret += fmt::format("    const double* {} x{} = in[{}];\n", restrict_kw, i, i);
+        }
+        for(std::size_t j = 0; j < exprs.size(); j++){
+            ret += fmt::format("    double* {} y{} = out[{}];\n", restrict_kw, j, j);
+        }
+        ret += "    #pragma omp simd\n";
+        ret += "    for(size_t k = 0; k < n; k++){\n";
+        ret += batch.body;
+        ret += "    }\n}\n";
+    }
+    return ret;
+}
+
+} // namespace
+
+auto emit_c(const std::vector<Symbolic>& exprs, const std::vector<std::string>& vars, Options options) -> std::string {
+    // Lowering all outputs into one program shares their common subexpressions.
+    auto p = compile(exprs, vars, {.polynomial = options.polynomial});
+    return emit(p, {}, exprs, vars, options);
+}
+
+auto emit_c(const CseResult& cse, const std::vector<std::string>& vars, Options options) -> std::string {
+    auto p = compile(cse, vars, {.polynomial = options.polynomial});
+    return emit(p, cse.temporaries, cse.outputs, vars, options);
+}
+
+} // namespace codegen
+} // namespace symb
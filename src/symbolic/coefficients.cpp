@@ -0,0 +1,139 @@
+#include "symbolic/coefficients.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace symb{
+
+namespace{
+
+using namespace impl;
+
+auto symbol_name(const Symbolic& x) -> const std::string& {
+    auto s = get_as<Symbol>(x.expr());
+    if(s == nullptr) throw std::runtime_error(fmt::format("Coefficients are taken in symbols, not in {}", x.expr()->str()));
+    return s->name;
+}
+
+// The factors of a term, a term that is no product is its only factor
+auto factors(const ExprPtr& term) -> std::span<const ExprPtr> {
+    if(term->kind() == Kind::ProdOp) return term->children;
+    return {&term, 1};
+}
+
+// The symbol and exponent of a factor that is an integer power of a symbol
+auto symbol_power(const ExprPtr& e) -> std::optional<std::pair<const std::string*, long>> {
+    if(e->kind() == Kind::Symbol) return std::pair{&get_as<Symbol>(e)->name, 1l};
+    if(e->kind() != Kind::PowOp || e->children[0]->kind() != Kind::Symbol) return {};
+    auto n = get_as<Number>(e->children[1]);
+    if(n == nullptr || n->value.denom() != 1 || not mpz_fits_slong_p(n->value.num().handle())) return {};
+    return std::pair{&get_as<Symbol>(e->children[0])->name, mpz_get_si(n->value.num().handle())};
+}
+
+} // namespace
+
+CoefficientIndex::CoefficientIndex(Symbolic _expr)
+    : m_expr{std::move(_expr)}
+{
+    auto t = terms();
+    for(std::size_t i = 0; i < t.size(); i++){
+        auto f = factors(t[i]);
+        for(std::size_t j = 0; j < f.size(); j++){
+            auto power = symbol_power(f[j]);
+            if(not power) continue;
+            auto& buckets = m_symbols[*power->first];
+            buckets.degrees[power->second].push_back({static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j)});
+            buckets.size++;
+        }
+    }
+    // The terms without a power of the symbol, which have degree zero in it
+    std::vector<std::size_t> seen(t.size(), 0);
+    std::size_t stamp = 0;
+    for(auto& [name, buckets] : m_symbols){
+        stamp++;
+        for(const auto& [degree, entries] : buckets.degrees){
+            for(const auto& entry : entries) seen[entry.term] = stamp;
+        }
+        for(std::size_t i = 0; i < t.size(); i++){
+            if(seen[i] != stamp) buckets.constant.push_back({static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(factors(t[i]).size())});
+        }
+    }
+}
+
+auto CoefficientIndex::terms() const -> std::span<const ExprPtr> {
+    const auto& e = m_expr.expr();
+    if(e->kind() == Kind::SumOp) return e->children;
+    if(e->kind() == Kind::Number && get_as<Number>(e)->value == 0) return {};
+    return {&e, 1};
+}
+
+auto CoefficientIndex::bucket(const Symbolic& x, long k) const -> std::span<const Entry> {
+    auto it = m_symbols.find(symbol_name(x));
+    if(it == m_symbols.end()) return {};
+    const auto& buckets = it->second;
+    if(k != 0){
+        auto d = buckets.degrees.find(k);
+        if(d == buckets.degrees.end()) return {};
+        return d->second;
+    }
+    return buckets.constant;
+}
+
+auto CoefficientIndex::coeff(const Symbolic& x, long k) const -> Symbolic {
+    if(k == 0 && not m_symbols.contains(symbol_name(x))) return m_expr;
+    auto t = terms();
+    std::vector<ExprPtr> summands;
+    for(const auto& entry : bucket(x, k)){
+        auto f = factors(t[entry.term]);
+        std::vector<ExprPtr> rest;
+        for(std::size_t j = 0; j < f.size(); j++){
+            if(j != entry.factor) rest.push_back(f[j]->copy());
+        }
+        if(rest.empty()) summands.push_back(make_expression<Number>(1));
+        else if(rest.size() == 1) summands.push_back(std::move(rest.front()));
+        else summands.push_back(make_expression<Product>(std::move(rest)));
+    }
+    if(summands.empty()) return Symbolic(make_expression<Number>(0));
+    if(summands.size() == 1) return Symbolic(std::move(summands.front()));
+    return Symbolic(make_expression<Sum>(std::move(summands)));
+}
+
+auto CoefficientIndex::degree(const Symbolic& x) const -> long {
+    auto it = m_symbols.find(symbol_name(x));
+    if(it == m_symbols.end()) return 0;
+    const auto& buckets = it->second;
+    auto ret = std::ranges::max(buckets.degrees | std::views::keys);
+    // A term without a power of x has degree zero
+    if(buckets.size < terms().size()) ret = std::max(ret, 0l);
+    return ret;
+}
+
+auto CoefficientIndex::collect(const Symbolic& x) const -> Symbolic {
+    std::vector<long> degrees{0};
+    if(auto it = m_symbols.find(symbol_name(x)); it != m_symbols.end()){
+        for(const auto& [k, entries] : it->second.degrees) degrees.push_back(k);
+    }
+    std::ranges::sort(degrees, std::greater<>{});
+    std::vector<ExprPtr> summands;
+    for(auto k : degrees){
+        auto c = coeff(x, k);
+        if(k == 0) summands.push_back(c.expr()->copy());
+        else summands.push_back(make_expression<Product>(c.expr()->copy(), make_expression<Power>(x.expr()->copy(), make_expression<Number>(k))));
+    }
+    return Symbolic(make_expression<Sum>(std::move(summands)));
+}
+
+auto coeff(const Symbolic& expr, const Symbolic& x, long k) -> Symbolic {
+    return CoefficientIndex(expr).coeff(x, k);
+}
+
+auto degree(const Symbolic& expr, const Symbolic& x) -> long {
+    return CoefficientIndex(expr).degree(x);
+}
+
+auto collect(const Symbolic& expr, const Symbolic& x) -> Symbolic {
+    return CoefficientIndex(expr).collect(x);
+}
+
+} // namespace symb
@@ -1,6 +1,10 @@
 #include "symbolic/expression.hpp"
 #include "symbolic/compare.hpp"
 
+#include <functional>
+#include <string>
+#include <vector>
+
 
 namespace symb{
 namespace impl{
@@ -57,8 +61,14 @@ std::strong_ordering cmp_expression(const ExprPtr& lhs, const ExprPtr& rhs) {
                 return cmp_expression_list(all(lhs->children), all(rhs->children));
             else return c;
         }
+        else if(rhs->kind() == Kind::Symbol){
+            // Functions order by their name, after a symbol of the same name
+            auto c = get_as<Function>(lhs)->name <=> get_as<Symbol>(rhs)->name;
+            if(c == 0) return std::strong_ordering::greater;
+            else return c;
+        }
         else{
-            return cmp_expression_list(all(lhs->children), single_cref_view(rhs));
+            return std::strong_ordering::less;
         }
     }
     case Kind::Symbol:{
@@ -75,5 +85,50 @@ std::strong_ordering cmp_expression(const ExprPtr& lhs, const ExprPtr& rhs) {
     throw std::runtime_error(fmt::format("Unknown Expression kind: {}", static_cast<int>(lhs->kind())));
 }
 
+namespace{
+
+// Residues modulo the largest prime below 2^64
+auto hash_integer(const multiprecision::MPi& v) -> std::size_t {
+    auto r = mpz_fdiv_ui(v.handle(), 18446744073709551557ul);
+    return mix(mpz_sgn(v.handle()) < 0 ? ~r : r);
+}
+
+} // namespace
+
+std::size_t hash_node(const ExprPtr& e, std::span<const std::size_t> children) {
+    // Forms that compare equal to their only operand: x^1, sums and
+    // products of one term
+    switch(e->kind()){
+    case Kind::PowOp: {
+        auto n = get_as<Number>(e->children[1]);
+        if(n != nullptr && n->value == 1) return children[0];
+        break;
+    }
+    case Kind::SumOp:
+    case Kind::ProdOp:
+        if(children.size() == 1) return children[0];
+        break;
+    default: break;
+    }
+    auto h = mix(static_cast<std::size_t>(e->kind()));
+    switch(e->kind()){
+    case Kind::Number: {
+        const auto& v = get_as<Number>(e)->value;
+        return mix(h ^ hash_integer(v.num()) ^ mix(hash_integer(v.denom())));
+    }
+    case Kind::Symbol: return mix(h ^ std::hash<std::string>{}(get_as<Symbol>(e)->name));
+    case Kind::Function: h = mix(h ^ std::hash<std::string>{}(get_as<Function>(e)->name)); break;
+    default: break;
+    }
+    for(auto c : children) h = mix(h ^ c);
+    return h;
+}
+
+std::size_t hash_expression(const ExprPtr& e) {
+    std::vector<std::size_t> children;
+    for(const auto& c : e->children) children.push_back(hash_expression(c));
+    return hash_node(e, children);
+}
+
 } // namespace impl
 } // namespace symb
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "symbolic/cse.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "symbolic/compare.hpp"
+
+namespace symb{
+namespace impl{
+namespace{
+
+// A node of the expression graph. The source is any expression of the
+// same kind, name or value, the children are nodes.
+struct Node {
+    const ExprPtr* source;
+    std::vector<std::uint32_t> children;
+    std::size_t hash;
+};
+
+// The expressions with equal subtrees merged. Nodes are added bottom-up,
+// so children have smaller indices until sums and products are rewritten.
+struct Graph {
+    std::vector<Node> nodes;
+    std::unordered_multimap<std::size_t, std::uint32_t> index;
+
+    static auto same(const Node& a, const Node& b) -> bool {
+        auto kind = (*a.source)->kind();
+        if(kind != (*b.source)->kind() || a.children != b.children) return false;
+        switch(kind){
+        case Kind::Number:
+        case Kind::Symbol: return cmp_expression(*a.source, *b.source) == 0;
+        case Kind::Function: return get_as<Function>(*a.source)->name == get_as<Function>(*b.source)->name;
+        default: return true;
+        }
+    }
+
+    auto kind(std::uint32_t id) const -> Kind { return (*nodes[id].source)->kind(); }
+    auto is_leaf(std::uint32_t id) const -> bool { return nodes[id].children.empty(); }
+
+    auto intern(Node node) -> std::uint32_t {
+        auto [first, last] = index.equal_range(node.hash);
+        for(auto it = first; it != last; ++it){
+            if(same(nodes[it->second], node)) return it->second;
+        }
+        auto id = static_cast<std::uint32_t>(nodes.size());
+        index.emplace(node.hash, id);
+        nodes.push_back(std::move(node));
+        return id;
+    }
+
+    // The node of kind and name of source with the given children
+    auto make(const ExprPtr* source, std::vector<std::uint32_t> children) -> std::uint32_t {
+        std::vector<std::size_t> hashes;
+        for(auto c : children) hashes.push_back(nodes[c].hash);
+        auto h = hash_node(*source, hashes);
+        return intern({source, std::move(children), h});
+    }
+
+    auto add(const ExprPtr& e) -> std::uint32_t {
+        std::vector<std::uint32_t> children;
+        for(const auto& c : e->children) children.push_back(add(c));
+        return make(&e, std::move(children));
+    }
+
+    // The children of a sum or product that take part in partial matches,
+    // sorted: all but the numbers
+    auto operands(std::uint32_t id) const -> std::vector<std::uint32_t> {
+        std::vector<std::uint32_t> ret;
+        for(auto c : nodes[id].children){
+            if(kind(c) != Kind::Number) ret.push_back(c);
+        }
+        std::ranges::sort(ret);
+        return ret;
+    }
+
+    // Replaces the operands common by one node standing for them
+    void replace(std::uint32_t id, const std::vector<std::uint32_t>& common, std::uint32_t with) {
+        auto& children = nodes[id].children;
+        std::erase_if(children, [&](std::uint32_t c){ return std::ranges::binary_search(common, c); });
+        children.push_back(with);
+    }
+};
+
+// Greedily pairs each sum (or product) with the one sharing most of its
+// operands, at least two, and moves the shared operands into a node of
+// their own, used by every node of the kind containing all of them.
+void share_operands(Graph& g, Kind kind) {
+    // The nodes of the kind having an operand
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> users;
+    auto add_user = [&](std::uint32_t id){
+        for(auto op : g.operands(id)) users[op].push_back(id);
+    };
+    for(std::uint32_t id = 0; id < g.nodes.size(); id++){
+        if(g.kind(id) == kind) add_user(id);
+    }
+
+    for(std::uint32_t a = 0; a < g.nodes.size(); a++){
+        if(g.kind(a) != kind) continue;
+        while(true){
+            auto ops = g.operands(a);
+            std::unordered_map<std::uint32_t, std::size_t> overlap;
+            for(auto op : ops){
+                for(auto b : users[op]){
+                    if(b != a) overlap[b]++;
+                }
+            }
+            std::optional<std::uint32_t> best;
+            std::size_t most = 1;
+            for(auto [b, k] : overlap){
+                if(k > most || (k == most && best && b < *best)){
+                    best = b;
+                    most = k;
+                }
+            }
+            if(not best) break;
+
+            std::vector<std::uint32_t> common;
+            std::ranges::set_intersection(ops, g.operands(*best), std::back_inserter(common));
+            auto size = g.nodes.size();
+            auto n = g.make(g.nodes[a].source, common);
+            auto rewritten = 0;
+            for(auto c : std::vector(users[common.front()])){
+                if(c == n || not std::ranges::includes(g.operands(c), common)) continue;
+                for(auto op : common) std::erase(users[op], c);
+                g.replace(c, common, n);
+                users[n].push_back(c);
+                rewritten++;
+            }
+            if(g.nodes.size() > size) add_user(n);
+            if(rewritten == 0) break;
+        }
+    }
+}
+
+struct Eliminator {
+    Graph graph;
+    std::vector<std::size_t> uses;
+    std::vector<std::uint32_t> order;
+
+    // Postorder from the outputs, counting the uses of reachable nodes
+    void visit(std::uint32_t id) {
+        if(uses[id]++ > 0) return;
+        for(auto c : graph.nodes[id].children) visit(c);
+        order.push_back(id);
+    }
+
+    // Numbers, symbols and negated symbols are cheaper to repeat
+    auto trivial(std::uint32_t id) const -> bool {
+        if(graph.is_leaf(id)) return true;
+        const auto& children = graph.nodes[id].children;
+        return graph.kind(id) == Kind::ProdOp && children.size() == 2
+            && graph.kind(children[0]) == Kind::Number && graph.is_leaf(children[1]);
+    }
+};
+
+} // namespace
+} // namespace impl
+
+auto cse(const std::vector<Symbolic>& exprs, CseOptions options) -> CseResult {
+    using namespace impl;
+    auto el = Eliminator{};
+    std::vector<std::uint32_t> outputs;
+    for(const auto& e : exprs) outputs.push_back(el.graph.add(e.expr()));
+    share_operands(el.graph, Kind::SumOp);
+    share_operands(el.graph, Kind::ProdOp);
+
+    el.uses.assign(el.graph.nodes.size(), 0);
+    for(auto id : outputs) el.visit(id);
+
+    std::unordered_set<std::string> names;
+    for(const auto& node : el.graph.nodes){
+        if((*node.source)->kind() == Kind::Symbol) names.insert(get_as<Symbol>(*node.source)->name);
+    }
+    std::size_t counter = 0;
+    auto next_name = [&]{
+        auto name = options.prefix + std::to_string(counter++);
+        while(names.contains(name)) name = options.prefix + std::to_string(counter++);
+        return name;
+    };
+
+    // Expressions of the nodes that are no temporaries, moved into their
+    // user if there is only one
+    auto ret = CseResult{};
+    std::vector<ExprPtr> built(el.graph.nodes.size());
+    std::vector<std::optional<std::string>> temporary(el.graph.nodes.size());
+    auto expression = [&](std::uint32_t id) -> ExprPtr {
+        if(el.graph.is_leaf(id)) return (*el.graph.nodes[id].source)->copy();
+        if(temporary[id]) return make_expression<Symbol>(*temporary[id]);
+        if(el.uses[id] > 1) return built[id]->copy();
+        return std::move(built[id]);
+    };
+    for(auto id : el.order){
+        const auto& node = el.graph.nodes[id];
+        if(node.children.empty()) continue;
+        std::vector<ExprPtr> children;
+        for(auto c : node.children) children.push_back(expression(c));
+        auto e = with_children(*node.source, std::move(children));
+        if(el.uses[id] < 2 || el.trivial(id)){
+            built[id] = std::move(e);
+            continue;
+        }
+        temporary[id] = next_name();
+        ret.temporaries.emplace_back(var(*temporary[id]), Symbolic(std::move(e)));
+    }
+    for(auto id : outputs) ret.outputs.emplace_back(expression(id));
+    return ret;
+}
+
+} // namespace symb
@@ -0,0 +1,596 @@
+#include "symbolic/evaluate.hpp"
+#include "symbolic/compare.hpp"
+#include "symbolic/cse.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+namespace symb{
+
+namespace{
+
+constexpr std::array builtin_names = {
+    std::pair{Builtin::Sin, "sin"},
+    std::pair{Builtin::Cos, "cos"},
+    std::pair{Builtin::Tan, "tan"},
+    std::pair{Builtin::Exp, "exp"},
+    std::pair{Builtin::Log, "log"},
+    std::pair{Builtin::Sqrt, "sqrt"},
+};
+
+} // namespace
+
+auto builtin_name(Builtin f) -> std::string {
+    for(auto [g, name] : builtin_names){
+        if(f == g) return name;
+    }
+    throw std::runtime_error(fmt::format("Unknown builtin: {}", static_cast<int>(f)));
+}
+
+auto find_builtin(const std::string& name) -> std::optional<Builtin> {
+    for(auto [f, n] : builtin_names){
+        if(name == n) return f;
+    }
+    return std::nullopt;
+}
+
+namespace impl{
+
+// mpq_get_d truncates towards zero, the nearest double is the truncation
+// or the next double away from zero, whichever is on the side of their
+// midpoint v is on, with ties to the even one. Above the largest double
+// the midpoint is half a step of the doubles below it, past which v
+// rounds to infinity.
+auto to_double(const ExpressionBase::Number_t& v) -> double {
+    mpq_t q, x;
+    mpq_init(q);
+    mpq_init(x);
+    mpz_set(mpq_numref(q), v.num().handle());
+    mpz_set(mpq_denref(q), v.denom().handle());
+    auto ret = mpq_get_d(q);
+    // Values that truncate to infinity are far past the largest double
+    if(not std::isinf(ret)) mpq_set_d(x, ret);
+    if(not std::isinf(ret) && not mpq_equal(x, q)){
+        auto sign = mpq_sgn(q);
+        auto away = std::nextafter(ret, sign * std::numeric_limits<double>::infinity());
+        // Differences of neighbouring doubles are exact
+        auto step = std::isinf(away) ? ret - std::nextafter(ret, 0.0) : away - ret;
+        mpq_t middle;
+        mpq_init(middle);
+        mpq_set_d(middle, step);
+        mpq_div_2exp(middle, middle, 1);
+        mpq_add(middle, middle, x);
+        auto c = mpq_cmp(q, middle) * sign;
+        if(c > 0 || (c == 0 && (std::bit_cast<std::uint64_t>(ret) & 1) != 0)) ret = away;
+        mpq_clear(middle);
+    }
+    mpq_clear(q);
+    mpq_clear(x);
+    return ret;
+}
+
+namespace{
+
+using Number_t = ExpressionBase::Number_t;
+
+// A summand c * atoms[i]^e * ... of a sum lowered as a polynomial
+struct Monomial {
+    Number_t c;
+    std::vector<std::pair<std::size_t, long>> powers;
+
+    auto exponent(std::size_t atom) const -> long {
+        for(auto [a, e] : powers) if(a == atom) return e;
+        return 0;
+    }
+
+    void divide(std::size_t atom, long e) {
+        for(auto& [a, k] : powers) if(a == atom) k -= e;
+        std::erase_if(powers, [](const auto& x){ return x.second == 0; });
+    }
+};
+
+// Number of terms each atom occurs in, atoms occurring in none are left out
+using Occurrences = std::map<std::size_t, int>;
+
+auto count_atoms(std::span<const Monomial> terms) -> Occurrences {
+    Occurrences ret;
+    for(const auto& t : terms) for(auto [a, e] : t.powers) ret[a]++;
+    return ret;
+}
+
+struct AtomLess {
+    auto operator()(const ExprPtr* a, const ExprPtr* b) const -> bool {
+        return cmp_expression(*a, *b) < 0;
+    }
+};
+
+// A register holding the value or the negated value of a subexpression,
+// negations are folded into the additions using it.
+struct Signed {
+    std::uint32_t reg;
+    bool negative = false;
+};
+
+struct Lowering {
+    Program& p;
+    CompileOptions options;
+    std::map<std::tuple<OpCode, Builtin, std::uint32_t, std::uint32_t, long>, std::uint32_t> emitted;
+    std::map<Number_t, std::uint32_t> constant_index;
+    // Symbols standing for registers computed earlier, as the temporaries
+    // of a cse
+    std::unordered_map<std::string, std::uint32_t> bound;
+
+    // Emits an instruction, reusing an identical earlier one if there is one.
+    auto emit(Instruction ins) -> std::uint32_t {
+        if((ins.op == OpCode::Add || ins.op == OpCode::Mul) && ins.a > ins.b){
+            std::swap(ins.a, ins.b);
+        }
+        auto key = std::tuple{ins.op, ins.fn, ins.a, ins.b, ins.n};
+        if(auto it = emitted.find(key); it != emitted.end()) return it->second;
+        auto index = static_cast<std::uint32_t>(p.code.size());
+        p.code.push_back(ins);
+        emitted.emplace(key, index);
+        return index;
+    }
+
+    auto constant(const Number_t& v) -> std::uint32_t {
+        auto it = constant_index.find(v);
+        if(it == constant_index.end()){
+            it = constant_index.emplace(v, static_cast<std::uint32_t>(p.constants.size())).first;
+            p.constants.push_back(v);
+            p.constant_values.push_back(to_double(v));
+        }
+        return emit({.op = OpCode::Constant, .a = it->second});
+    }
+
+    auto variable(const std::string& name) -> std::uint32_t {
+        if(auto b = bound.find(name); b != bound.end()) return b->second;
+        auto it = std::find(p.variables.begin(), p.variables.end(), name);
+        if(it == p.variables.end()){
+            throw std::runtime_error(fmt::format("Unbound symbol in compiled expression: {}", name));
+        }
+        return emit({.op = OpCode::Variable, .a = static_cast<std::uint32_t>(it - p.variables.begin())});
+    }
+
+    auto binary(OpCode op, std::uint32_t a, std::uint32_t b) -> std::uint32_t {
+        return emit({.op = op, .a = a, .b = b});
+    }
+
+    auto lower(const ExprPtr& e) -> std::uint32_t {
+        switch(e->kind()){
+        case Kind::Number: return constant(get_as<Number>(e)->value);
+        case Kind::Symbol: return variable(get_as<Symbol>(e)->name);
+        case Kind::SumOp: return lower_sum(e);
+        case Kind::ProdOp: return lower_product(e);
+        case Kind::PowOp: return lower_power(e);
+        case Kind::Function: return lower_function(e);
+        default: break;
+        }
+        throw std::runtime_error(fmt::format("Cannot compile expression: {}", e->str()));
+    }
+
+    // Lowers c*factors, where the factors do not contain a numeric coefficient.
+    auto lower_term(Number_t c, std::span<const ExprPtr> factors) -> std::uint32_t {
+        std::optional<std::uint32_t> num, den;
+        auto multiply = [&](std::optional<std::uint32_t>& acc, std::uint32_t x){
+            acc = acc ? binary(OpCode::Mul, *acc, x) : x;
+        };
+        for(const auto& f : factors){
+            if(f->kind() == Kind::PowOp && f->children[1]->kind() == Kind::Number
+                && get_as<Number>(f->children[1])->value < 0)
+            {
+                auto e = Number_t(0) - get_as<Number>(f->children[1])->value;
+                multiply(den, lower_power(f->children[0], e));
+            }
+            else{
+                multiply(num, lower(f));
+            }
+        }
+        auto negative = c < 0;
+        if(negative) c = Number_t(0) - c;
+        if(c != 1 || not num) multiply(num, constant(c));
+        auto ret = den ? binary(OpCode::Div, *num, *den) : *num;
+        return negative ? emit({.op = OpCode::Neg, .a = ret}) : ret;
+    }
+
+    auto lower_product(const ExprPtr& e) -> std::uint32_t {
+        std::span<const ExprPtr> factors = e->children;
+        if(factors[0]->kind() == Kind::Number){
+            return lower_term(get_as<Number>(factors[0])->value, factors.subspan(1));
+        }
+        return lower_term(Number_t(1), factors);
+    }
+
+    auto lower_sum(const ExprPtr& e) -> std::uint32_t {
+        if(options.polynomial != PolynomialForm::Expanded){
+            if(auto ret = lower_polynomial(e)) return *ret;
+        }
+        std::optional<std::uint32_t> acc;
+        std::vector<std::uint32_t> subtracted;
+        for(const auto& s : e->children){
+            // Summands with a negative coefficient are subtracted instead of
+            // negated and added.
+            auto c = Number_t(1);
+            std::span<const ExprPtr> factors(&s, 1);
+            if(s->kind() == Kind::Number){
+                c = get_as<Number>(s)->value;
+                factors = {};
+            }
+            else if(s->kind() == Kind::ProdOp && s->children[0]->kind() == Kind::Number){
+                c = get_as<Number>(s->children[0])->value;
+                factors = std::span<const ExprPtr>(s->children).subspan(1);
+            }
+            if(c < 0){
+                subtracted.push_back(lower_term(Number_t(0) - c, factors));
+            }
+            else{
+                auto x = lower_term(c, factors);
+                acc = acc ? binary(OpCode::Add, *acc, x) : x;
+            }
+        }
+        for(auto x : subtracted){
+            acc = acc ? binary(OpCode::Sub, *acc, x) : emit({.op = OpCode::Neg, .a = x});
+        }
+        return *acc;
+    }
+
+    /* ***********************************************
+        Horner and Estrin forms
+    ************************************************** */
+
+    // Splits the summands of e into monomials over atoms. Returns nothing
+    // if no atom occurs in two summands, then nothing can be factored out.
+    auto lower_polynomial(const ExprPtr& e) -> std::optional<std::uint32_t> {
+        std::vector<const ExprPtr*> atoms;
+        std::map<const ExprPtr*, std::size_t, AtomLess> index;
+        auto atom_index = [&](const ExprPtr& a){
+            auto [it, inserted] = index.emplace(&a, atoms.size());
+            if(inserted) atoms.push_back(&a);
+            return it->second;
+        };
+        std::vector<Monomial> terms;
+        for(const auto& s : e->children){
+            auto m = Monomial{Number_t(1), {}};
+            std::span<const ExprPtr> factors(&s, 1);
+            if(s->kind() == Kind::Number){
+                m.c = get_as<Number>(s)->value;
+                factors = {};
+            }
+            else if(s->kind() == Kind::ProdOp){
+                factors = s->children;
+                if(factors[0]->kind() == Kind::Number){
+                    m.c = get_as<Number>(factors[0])->value;
+                    factors = factors.subspan(1);
+                }
+            }
+            for(const auto& f : factors){
+                const ExprPtr* base = &f;
+                long n = 1;
+                if(f->kind() == Kind::PowOp && f->children[1]->kind() == Kind::Number){
+                    const auto& v = get_as<Number>(f->children[1])->value;
+                    if(math::is_integer(v) && v > 0 && mpz_fits_slong_p(v.num().handle())){
+                        base = &f->children[0];
+                        n = mpz_get_si(v.num().handle());
+                    }
+                }
+                m.powers.emplace_back(atom_index(*base), n);
+            }
+            terms.push_back(std::move(m));
+        }
+        auto count = count_atoms(terms);
+        if(std::ranges::none_of(count, [](const auto& x){ return x.second >= 2; })) return {};
+
+        std::vector<std::uint32_t> regs;
+        for(auto a : atoms) regs.push_back(lower(*a));
+        auto ret = horner(std::move(terms), std::move(count), regs);
+        return ret.negative ? emit({.op = OpCode::Neg, .a = ret.reg}) : ret.reg;
+    }
+
+    auto add(Signed x, Signed y) -> Signed {
+        if(x.negative == y.negative) return {binary(OpCode::Add, x.reg, y.reg), x.negative};
+        if(y.negative) return {binary(OpCode::Sub, x.reg, y.reg)};
+        return {binary(OpCode::Sub, y.reg, x.reg)};
+    }
+
+    auto power(std::uint32_t x, long n) -> std::uint32_t {
+        return n == 1 ? x : emit({.op = OpCode::PowInt, .a = x, .n = n});
+    }
+
+    auto monomial(const Monomial& m, std::span<const std::uint32_t> atoms) -> Signed {
+        std::optional<std::uint32_t> acc;
+        for(auto [a, e] : m.powers){
+            auto x = power(atoms[a], e);
+            acc = acc ? binary(OpCode::Mul, *acc, x) : x;
+        }
+        auto c = m.c < 0 ? Number_t(0) - m.c : m.c;
+        if(c != 1 || not acc){
+            auto x = constant(c);
+            acc = acc ? binary(OpCode::Mul, x, *acc) : x;
+        }
+        return {*acc, m.c < 0};
+    }
+
+    // count holds the occurrences of the atoms in terms. It is split along
+    // with the terms, so that only the terms without the factored atom are
+    // counted again.
+    auto horner(std::vector<Monomial> terms, Occurrences count, std::span<const std::uint32_t> atoms) -> Signed {
+        if(terms.size() == 1) return monomial(terms[0], atoms);
+
+        // Greedy choice of the atom occurring in most terms
+        auto most = std::ranges::max_element(count, {}, [](const auto& x){ return x.second; });
+        if(most == count.end() || most->second < 2){
+            auto ret = monomial(terms[0], atoms);
+            for(std::size_t i = 1; i < terms.size(); i++) ret = add(ret, monomial(terms[i], atoms));
+            return ret;
+        }
+        auto v = most->first;
+
+        std::vector<Monomial> with, without;
+        for(auto& t : terms) (t.exponent(v) > 0 ? with : without).push_back(std::move(t));
+
+        if(options.polynomial == PolynomialForm::Estrin){
+            if(auto ret = estrin(with, without, v, atoms)) return *ret;
+        }
+
+        auto without_count = count_atoms(without);
+        for(auto [a, k] : without_count){
+            auto it = count.find(a);
+            if((it->second -= k) == 0) count.erase(it);
+        }
+        auto m = std::ranges::min(with | std::views::transform([&](const Monomial& t){ return t.exponent(v); }));
+        for(auto& t : with){
+            if(t.exponent(v) == m) count[v]--;
+            t.divide(v, m);
+        }
+        if(count[v] == 0) count.erase(v);
+        auto inner = horner(std::move(with), std::move(count), atoms);
+        auto ret = Signed{binary(OpCode::Mul, inner.reg, power(atoms[v], m)), inner.negative};
+        if(without.empty()) return ret;
+        return add(horner(std::move(without), std::move(without_count), atoms), ret);
+    }
+
+    // Sum c_k v^k with coefficients c_k over the other atoms, evaluated as
+    // (c_0 + c_1 v) + v^2 (c_2 + c_3 v) + ... with the pairs combined
+    // recursively. Sparse polynomials are left to horner.
+    auto estrin(std::vector<Monomial>& with, std::vector<Monomial>& without, std::size_t v, std::span<const std::uint32_t> atoms) -> std::optional<Signed> {
+        std::map<long, std::vector<Monomial>> groups;
+        for(const auto& t : with) groups[t.exponent(v)];
+        auto degree = groups.rbegin()->first;
+        if(degree < 3 || static_cast<std::size_t>(degree) >= 2 * (groups.size() + 1)) return {};
+        for(auto& t : with){
+            auto k = t.exponent(v);
+            t.divide(v, k);
+            groups[k].push_back(std::move(t));
+        }
+        std::vector<std::optional<Signed>> coeffs(static_cast<std::size_t>(degree) + 1);
+        if(not without.empty()) coeffs[0] = horner(std::move(without), count_atoms(without), atoms);
+        for(auto& [k, ts] : groups) coeffs[static_cast<std::size_t>(k)] = horner(std::move(ts), count_atoms(ts), atoms);
+
+        auto x = atoms[v];
+        while(coeffs.size() > 1){
+            std::vector<std::optional<Signed>> next;
+            for(std::size_t i = 0; i < coeffs.size(); i += 2){
+                auto lo = coeffs[i];
+                auto hi = i + 1 < coeffs.size() ? coeffs[i + 1] : std::nullopt;
+                if(hi) hi = Signed{binary(OpCode::Mul, hi->reg, x), hi->negative};
+                if(lo && hi) next.push_back(add(*lo, *hi));
+                else next.push_back(lo ? lo : hi);
+            }
+            coeffs = std::move(next);
+            if(coeffs.size() > 1) x = binary(OpCode::Mul, x, x);
+        }
+        return coeffs[0];
+    }
+
+    auto lower_power(const ExprPtr& b, const Number_t& e) -> std::uint32_t {
+        if(e < 0){
+            return binary(OpCode::Div, constant(Number_t(1)), lower_power(b, Number_t(0) - e));
+        }
+        if(math::is_integer(e) && mpz_fits_slong_p(e.num().handle())){
+            auto n = mpz_get_si(e.num().handle());
+            if(n == 0) return constant(Number_t(1));
+            if(n == 1) return lower(b);
+            return emit({.op = OpCode::PowInt, .a = lower(b), .n = n});
+        }
+        if(e == Number_t(1, 2)){
+            return emit({.op = OpCode::Call, .fn = Builtin::Sqrt, .a = lower(b)});
+        }
+        return binary(OpCode::Pow, lower(b), constant(e));
+    }
+
+    auto lower_power(const ExprPtr& e) -> std::uint32_t {
+        const auto& exponent = e->children[1];
+        if(exponent->kind() == Kind::Number){
+            return lower_power(e->children[0], get_as<Number>(exponent)->value);
+        }
+        return binary(OpCode::Pow, lower(e->children[0]), lower(exponent));
+    }
+
+    auto lower_function(const ExprPtr& e) -> std::uint32_t {
+        auto f = find_builtin(get_as<Function>(e)->name);
+        if(not f || e->children.size() != 1){
+            throw std::runtime_error(fmt::format("Cannot compile function: {}", e->str()));
+        }
+        return emit({.op = OpCode::Call, .fn = *f, .a = lower(e->children[0])});
+    }
+};
+
+} // namespace
+
+auto compile(std::span<const ExprPtr> exprs, std::vector<std::string> variables, CompileOptions options) -> Program {
+    auto p = Program{};
+    p.variables = std::move(variables);
+    auto lowering = Lowering{p, options, {}, {}, {}};
+    for(const auto& e : exprs){
+        p.outputs.push_back(lowering.lower(e));
+    }
+    return p;
+}
+
+} // namespace impl
+
+auto compile(const Symbolic& expr, std::vector<std::string> variables, CompileOptions options) -> Program {
+    return impl::compile(std::span(&expr.expr(), 1), std::move(variables), options);
+}
+
+auto compile(const std::vector<Symbolic>& exprs, std::vector<std::string> variables, CompileOptions options) -> Program {
+    std::vector<impl::ExprPtr> tmp;
+    for(const auto& e : exprs) tmp.emplace_back(e.expr()->copy());
+    return impl::compile(tmp, std::move(variables), options);
+}
+
+auto compile(const CseResult& cse, std::vector<std::string> variables, CompileOptions options) -> Program {
+    auto p = Program{};
+    p.variables = std::move(variables);
+    auto lowering = impl::Lowering{p, options, {}, {}, {}};
+    for(const auto& [symbol, definition] : cse.temporaries){
+        lowering.bound[impl::get_as<impl::Symbol>(symbol.expr())->name] = lowering.lower(definition.expr());
+    }
+    for(const auto& e : cse.outputs) p.outputs.push_back(lowering.lower(e.expr()));
+    return p;
+}
+
+auto evaluate(const Program& p, std::span<const double> vars) -> double {
+    if(vars.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} variables, got {}", p.variables.size(), vars.size()
+        ));
+    }
+    std::vector<double> regs(p.registers());
+    impl::execute<double>(p, p.constant_values, vars, regs);
+    return regs[p.outputs.at(0)];
+}
+
+namespace{
+
+// Evaluates `count` points starting at `begin` one instruction at a time, so
+// that every instruction becomes a tight loop over the chunk. Register i of
+// point k lives in scratch[i * stride + k].
+void execute_chunk(
+    const Program& p,
+    std::span<const std::span<const double>> inputs,
+    std::span<const std::span<double>> outputs,
+    std::size_t begin, std::size_t count, std::size_t stride,
+    double* scratch
+) {
+    for(std::size_t i = 0; i < p.code.size(); i++){
+        const auto& ins = p.code[i];
+        auto* r = scratch + i * stride;
+        const auto* x = scratch + ins.a * stride;
+        const auto* y = scratch + ins.b * stride;
+        switch(ins.op){
+        case OpCode::Constant: std::fill_n(r, count, p.constant_values[ins.a]); break;
+        case OpCode::Variable: std::copy_n(inputs[ins.a].data() + begin, count, r); break;
+        case OpCode::Add: for(std::size_t k = 0; k < count; k++) r[k] = x[k] + y[k]; break;
+        case OpCode::Sub: for(std::size_t k = 0; k < count; k++) r[k] = x[k] - y[k]; break;
+        case OpCode::Mul: for(std::size_t k = 0; k < count; k++) r[k] = x[k] * y[k]; break;
+        case OpCode::Div: for(std::size_t k = 0; k < count; k++) r[k] = x[k] / y[k]; break;
+        case OpCode::Neg: for(std::size_t k = 0; k < count; k++) r[k] = -x[k]; break;
+        case OpCode::PowInt: for(std::size_t k = 0; k < count; k++) r[k] = math::pow(x[k], ins.n); break;
+        case OpCode::Pow: for(std::size_t k = 0; k < count; k++) r[k] = std::pow(x[k], y[k]); break;
+        case OpCode::Call: for(std::size_t k = 0; k < count; k++) r[k] = call_builtin(ins.fn, x[k]); break;
+        }
+    }
+    for(std::size_t j = 0; j < outputs.size(); j++){
+        std::copy_n(scratch + p.outputs[j] * stride, count, outputs[j].data() + begin);
+    }
+}
+
+// Points per chunk such that the scratch registers of one thread stay within
+// a typical L2 cache. Chunks are a multiple of a cache line worth of doubles,
+// so neighbouring chunks written by different threads do not share lines.
+auto default_chunk_size(const Program& p) -> std::size_t {
+    constexpr std::size_t cache_budget = 256 * 1024 / sizeof(double);
+    constexpr std::size_t line = 64 / sizeof(double);
+    auto chunk = cache_budget / std::max<std::size_t>(p.registers(), 1);
+    chunk = std::clamp<std::size_t>(chunk, line, 4096);
+    return chunk - chunk % line;
+}
+
+// The chunks owned by one thread. The owner and thieves both claim chunks
+// with fetch_add, a claim past `end` means the range is exhausted.
+struct alignas(64) WorkRange {
+    std::atomic<std::size_t> next = 0;
+    std::size_t end = 0;
+};
+
+} // namespace
+
+auto evaluate_batch(
+    const Program& p,
+    std::span<const std::span<const double>> inputs,
+    std::span<const std::span<double>> outputs,
+    BatchOptions options
+) -> BatchStats {
+    if(inputs.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} input columns, got {}", p.variables.size(), inputs.size()
+        ));
+    }
+    if(outputs.size() != p.outputs.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} output columns, got {}", p.outputs.size(), outputs.size()
+        ));
+    }
+    auto n = outputs.empty() ? 0 : outputs[0].size();
+    auto same_length = [&](const auto& column){ return column.size() == n; };
+    if(not std::ranges::all_of(inputs, same_length) || not std::ranges::all_of(outputs, same_length)){
+        throw std::runtime_error("All input and output columns must have the same length");
+    }
+
+    auto stats = BatchStats{};
+    stats.chunk_size = options.chunk_size != 0 ? options.chunk_size : default_chunk_size(p);
+    auto chunks = (n + stats.chunk_size - 1) / stats.chunk_size;
+
+    auto threads = options.threads != 0 ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+    threads = static_cast<unsigned>(std::clamp<std::size_t>(chunks, 1, threads));
+    stats.threads.resize(threads);
+
+    // Every thread starts on its own contiguous block of chunks, which keeps
+    // the memory it touches local, and steals from the others once done.
+    auto ranges = std::make_unique<WorkRange[]>(threads);
+    for(unsigned t = 0; t < threads; t++){
+        ranges[t].next = chunks * t / threads;
+        ranges[t].end = chunks * (t + 1) / threads;
+    }
+
+    auto worker = [&](unsigned t){
+        auto start = std::chrono::steady_clock::now();
+        auto& s = stats.threads[t];
+        std::vector<double> scratch(p.registers() * stats.chunk_size);
+        for(unsigned k = 0; k < threads; k++){
+            auto& range = ranges[(t + k) % threads];
+            for(auto c = range.next++; c < range.end; c = range.next++){
+                auto begin = c * stats.chunk_size;
+                auto count = std::min(stats.chunk_size, n - begin);
+                execute_chunk(p, inputs, outputs, begin, count, stats.chunk_size, scratch.data());
+                s.points += count;
+                s.chunks++;
+                if(k != 0) s.stolen_chunks++;
+            }
+        }
+        s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<std::jthread> pool;
+    for(unsigned t = 1; t < threads; t++){
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    pool.clear();
+    return stats;
+}
+
+} // namespace symb
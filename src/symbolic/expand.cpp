@@ -0,0 +1,165 @@
+#include "symbolic/expand.hpp"
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+#include "math/sparse_poly.hpp"
+#include "symbolic/compare.hpp"
+
+namespace symb{
+
+namespace{
+
+using namespace impl;
+using multiprecision::MPi;
+using Rational = ExpressionBase::Number_t;
+
+// The exponent of a power that is expanded, or -1
+auto expanded_exponent(const ExprPtr& e) -> long {
+    auto n = get_as<Number>(e->children[1]);
+    if(n == nullptr || n->value < 0 || n->value.denom() != 1 || not mpz_fits_slong_p(n->value.num().handle())) return -1;
+    return mpz_get_si(n->value.num().handle());
+}
+
+struct AtomLess {
+    auto operator()(const ExprPtr* a, const ExprPtr* b) const -> bool {
+        return cmp_expression(*a, *b) < 0;
+    }
+};
+
+// First pass: finds the atoms, a bound for the degree of the expansion and
+// whether all coefficients are integers.
+struct Atoms {
+    // A deque for stable addresses, the index points into it
+    std::deque<ExprPtr> atoms;
+    std::map<const ExprPtr*, std::size_t, AtomLess> index;
+    std::unordered_map<const ExpressionBase*, std::size_t> atom_of;
+    bool integral = true;
+
+    auto collect(const ExprPtr& e) -> long {
+        switch(e->kind()){
+        case Kind::Number:
+            if(get_as<Number>(e)->value.denom() != 1) integral = false;
+            return 0;
+        case Kind::SumOp: {
+            long ret = 0;
+            for(const auto& c : e->children) ret = std::max(ret, collect(c));
+            return ret;
+        }
+        case Kind::ProdOp: {
+            long ret = 0;
+            for(const auto& c : e->children) ret += collect(c);
+            return ret;
+        }
+        case Kind::PowOp: {
+            auto n = expanded_exponent(e);
+            if(n >= 0) return collect(e->children[0]) * n;
+            break;
+        }
+        default: break;
+        }
+        add_atom(e);
+        return 1;
+    }
+
+    void add_atom(const ExprPtr& e) {
+        auto a = e->copy();
+        for(auto& c : a->children) c = expand(Symbolic::from_simplified(std::move(c))).expr()->copy();
+        if(not a->children.empty()) a = Symbolic(std::move(a)).expr()->copy();
+        atoms.push_back(std::move(a));
+        auto [it, inserted] = index.emplace(&atoms.back(), atoms.size() - 1);
+        if(not inserted) atoms.pop_back();
+        atom_of[e.get()] = it->second;
+    }
+};
+
+template<class C>
+struct Expander {
+    MonomialLayout layout;
+    const Atoms& atoms;
+
+    auto coefficient(const ExprPtr& e) -> C {
+        const auto& v = get_as<Number>(e)->value;
+        if constexpr(std::same_as<C, MPi>) return v.num();
+        else return v;
+    }
+
+    auto convert(const ExprPtr& e) -> SparsePoly<C> {
+        switch(e->kind()){
+        case Kind::Number:
+            return SparsePoly<C>::constant(layout, coefficient(e));
+        case Kind::SumOp: {
+            auto acc = TermAccumulator<C>(layout);
+            for(const auto& c : e->children) acc.add(convert(c));
+            return std::move(acc).finish();
+        }
+        case Kind::ProdOp: {
+            std::vector<SparsePoly<C>> factors;
+            for(const auto& c : e->children) factors.push_back(convert(c));
+            // Small factors first keeps the intermediate products small
+            std::ranges::sort(factors, {}, [](const auto& p){ return p.size(); });
+            auto ret = std::move(factors[0]);
+            for(std::size_t i = 1; i < factors.size(); i++) ret = ret * factors[i];
+            return ret;
+        }
+        case Kind::PowOp: {
+            auto n = expanded_exponent(e);
+            if(n >= 0) return multinomial_power(convert(e->children[0]), n);
+            break;
+        }
+        default: break;
+        }
+        return SparsePoly<C>::variable(layout, atoms.atom_of.at(e.get()));
+    }
+};
+
+template<class C>
+auto expand_as(const ExprPtr& e, const Atoms& atoms, long degree) -> Symbolic {
+    auto bits = degree < (1l << 15) ? 16u : 32u;
+    auto expander = Expander<C>{MonomialLayout(atoms.atoms.size(), MonomialOrder::Lex, bits), atoms};
+    auto p = expander.convert(e);
+
+    // Products of distinct atoms that are not powers are in canonical form
+    // once their factors are sorted, and as the terms are distinct monomials
+    // the sum is too once its terms are sorted. Powers of power atoms may
+    // still combine, e.g. sqrt(x)^2 with x, so they are simplified as usual.
+    auto canonical = std::ranges::none_of(atoms.atoms, [](const auto& a){ return a->kind() == Kind::PowOp; });
+    auto less = [](const ExprPtr& a, const ExprPtr& b){ return cmp_expression(a, b) < 0; };
+    std::vector<ExprPtr> terms;
+    for(std::size_t i = 0; i < p.size(); i++){
+        std::vector<ExprPtr> factors;
+        auto c = Rational(p.coefficient(i));
+        if(not canonical || c != 1) factors.push_back(make_expression<Number>(std::move(c)));
+        auto exponents = p.exponents(i);
+        for(std::size_t k = 0; k < exponents.size(); k++){
+            if(exponents[k] == 0) continue;
+            if(canonical && exponents[k] == 1) factors.push_back(atoms.atoms[k]->copy());
+            else factors.push_back(make_expression<Power>(atoms.atoms[k]->copy(), make_expression<Number>(exponents[k])));
+        }
+        if(factors.empty()) terms.push_back(make_expression<Number>(1));
+        else if(factors.size() == 1) terms.push_back(std::move(factors[0]));
+        else{
+            std::ranges::sort(factors, less);
+            terms.push_back(make_expression<Product>(std::move(factors)));
+        }
+    }
+    if(terms.empty()) return Symbolic(make_expression<Number>(0));
+    if(not canonical) return Symbolic(make_expression<Sum>(std::move(terms)));
+    if(terms.size() == 1) return Symbolic::from_simplified(std::move(terms[0]));
+    std::ranges::sort(terms, less);
+    return Symbolic::from_simplified(make_expression<Sum>(std::move(terms)));
+}
+
+} // namespace
+
+auto expand(const Symbolic& expr) -> Symbolic {
+    const auto& e = expr.expr();
+    if(e->kind() == Kind::Number || e->kind() == Kind::Symbol) return expr;
+    auto atoms = Atoms{};
+    auto degree = atoms.collect(e);
+    if(atoms.integral) return expand_as<MPi>(e, atoms, degree);
+    else return expand_as<Rational>(e, atoms, degree);
+}
+
+} // namespace symb
@@ -0,0 +1,47 @@
+#include "symbolic/forward_mode.hpp"
+#include "symbolic/gradient.hpp"
+
+namespace symb{
+
+auto directional_derivative(const Program& p, std::span<const double> x, std::span<const double> v) -> Dual<double> {
+    if(v.size() != x.size()){
+        throw std::runtime_error("Direction and point must have the same dimension");
+    }
+    std::vector<Dual<double>> args;
+    for(std::size_t i = 0; i < x.size(); i++){
+        args.emplace_back(x[i], v[i]);
+    }
+    return evaluate_forward<Dual<double>>(p, args);
+}
+
+auto hessian_vector_product(const Program& p, std::span<const double> x, std::span<const double> v, std::span<double> hv) -> double {
+    if(v.size() != x.size() || hv.size() != x.size()){
+        throw std::runtime_error("Direction, result and point must have the same dimension");
+    }
+    if(x.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} variables, got {}", p.variables.size(), x.size()
+        ));
+    }
+    if(p.outputs.empty()){
+        throw std::runtime_error("Cannot differentiate a program without outputs");
+    }
+    // Forward over reverse: the forward sweep carries the derivative along
+    // v, the reverse sweep over those duals then yields grad f + (H v) e.
+    std::vector<Dual<double>> args;
+    for(std::size_t i = 0; i < x.size(); i++){
+        args.emplace_back(x[i], v[i]);
+    }
+    std::vector<Dual<double>> constants(p.constant_values.begin(), p.constant_values.end());
+    std::vector<Dual<double>> values(p.registers());
+    std::vector<Dual<double>> adjoints(p.registers());
+    std::vector<Dual<double>> gradient(x.size());
+    impl::execute<Dual<double>>(p, constants, args, values);
+    impl::reverse_sweep<Dual<double>>(p, values, adjoints, gradient);
+    for(std::size_t j = 0; j < x.size(); j++){
+        hv[j] = gradient[j].derivative;
+    }
+    return values[p.outputs[0]].value;
+}
+
+} // namespace symb
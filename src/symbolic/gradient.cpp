@@ -0,0 +1,32 @@
+#include "symbolic/gradient.hpp"
+
+#include <stdexcept>
+
+namespace symb{
+
+GradientKernel::GradientKernel(Program p)
+    : m_program{std::move(p)}, m_values(m_program.registers()), m_adjoints(m_program.registers())
+{
+    if(m_program.outputs.empty()){
+        throw std::runtime_error("Cannot differentiate a program without outputs");
+    }
+}
+
+auto GradientKernel::operator()(std::span<const double> x, std::span<double> gradient) -> double {
+    const auto& p = m_program;
+    if(x.size() != p.variables.size() || gradient.size() != p.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} variables, got {} values and {} gradient entries",
+            p.variables.size(), x.size(), gradient.size()
+        ));
+    }
+    impl::execute<double>(p, p.constant_values, x, m_values);
+    impl::reverse_sweep<double>(p, m_values, m_adjoints, gradient);
+    return m_values[p.outputs[0]];
+}
+
+auto compile_gradient(const Symbolic& expr, std::vector<std::string> variables) -> GradientKernel {
+    return GradientKernel(compile(expr, std::move(variables)));
+}
+
+} // namespace symb
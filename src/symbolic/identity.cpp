@@ -0,0 +1,208 @@
+#include "symbolic/identity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "math/modular.hpp"
+#include "symbolic/compare.hpp"
+
+namespace symb{
+
+namespace{
+
+using namespace impl;
+using Number_t = ExpressionBase::Number_t;
+
+// Degree of numerator and denominator of a rational expression, functions
+// and other opaque subexpressions count as one more variable.
+struct Degree {
+    double num = 0;
+    double den = 0;
+    bool opaque = false;
+};
+
+auto integer_exponent(const ExprPtr& e) -> const Number*{
+    auto n = get_as<Number>(e);
+    if(n == nullptr || n->value.denom() != 1) return nullptr;
+    return n;
+}
+
+auto degree(const ExprPtr& e) -> Degree {
+    switch(e->kind()){
+    case Kind::Number: return {};
+    case Kind::Symbol: return {1, 0, false};
+    case Kind::SumOp: {
+        auto ret = Degree{};
+        for(const auto& c : e->children){
+            auto d = degree(c);
+            ret = {std::max(ret.num + d.den, d.num + ret.den), ret.den + d.den, ret.opaque || d.opaque};
+        }
+        return ret;
+    }
+    case Kind::ProdOp: {
+        auto ret = Degree{};
+        for(const auto& c : e->children){
+            auto d = degree(c);
+            ret = {ret.num + d.num, ret.den + d.den, ret.opaque || d.opaque};
+        }
+        return ret;
+    }
+    case Kind::PowOp: {
+        auto n = integer_exponent(e->children[1]);
+        if(n == nullptr) return {1, 0, true};
+        auto b = degree(e->children[0]);
+        auto k = std::abs(mpz_get_d(n->value.num().handle()));
+        if(n->value < 0) std::swap(b.num, b.den);
+        return {k * b.num, k * b.den, b.opaque};
+    }
+    case Kind::Function: return {1, 0, true};
+    case Kind::Undefined: break;
+    }
+    throw std::runtime_error("Cannot test identities of undefined expressions");
+}
+
+// Evaluates expressions modulo p at one random point. Division by a
+// multiple of p yields no value, the caller moves on to another point.
+class Evaluator {
+public:
+    Evaluator(std::uint64_t p, std::mt19937_64& rng)
+        : m_p{p}, m_salt{rng()}, m_rng{rng}
+    {}
+
+    auto operator()(const ExprPtr& e) -> std::optional<std::uint64_t> {
+        using namespace modular;
+        switch(e->kind()){
+        case Kind::Number: return number(get_as<Number>(e)->value);
+        case Kind::Symbol: {
+            auto [it, inserted] = m_symbols.try_emplace(get_as<Symbol>(e)->name, 0);
+            if(inserted) it->second = m_rng() % m_p;
+            return it->second;
+        }
+        case Kind::SumOp: {
+            std::uint64_t ret = 0;
+            for(const auto& c : e->children){
+                auto v = (*this)(c);
+                if(not v) return {};
+                ret = add_mod(ret, *v, m_p);
+            }
+            return ret;
+        }
+        case Kind::ProdOp: {
+            std::uint64_t ret = 1;
+            for(const auto& c : e->children){
+                auto v = (*this)(c);
+                if(not v) return {};
+                ret = mul_mod(ret, *v, m_p);
+            }
+            return ret;
+        }
+        case Kind::PowOp: {
+            auto b = (*this)(e->children[0]);
+            if(not b) return {};
+            auto n = integer_exponent(e->children[1]);
+            if(n == nullptr){
+                auto x = (*this)(e->children[1]);
+                if(not x) return {};
+                return opaque("^", {*b, *x});
+            }
+            return power(*b, n->value.num());
+        }
+        case Kind::Function: {
+            std::vector<std::uint64_t> args;
+            for(const auto& c : e->children){
+                auto v = (*this)(c);
+                if(not v) return {};
+                args.push_back(*v);
+            }
+            return opaque(get_as<Function>(e)->name, args);
+        }
+        case Kind::Undefined: break;
+        }
+        throw std::runtime_error("Cannot test identities of undefined expressions");
+    }
+
+private:
+    auto residue(const multiprecision::MPi& v) const -> std::uint64_t {
+        auto r = mpz_fdiv_ui(v.handle(), m_p);
+        return static_cast<std::uint64_t>(r);
+    }
+
+    auto number(const Number_t& v) const -> std::optional<std::uint64_t> {
+        auto d = residue(v.denom());
+        if(d == 0) return {};
+        return modular::mul_mod(residue(v.num()), modular::inverse_mod(d, m_p), m_p);
+    }
+
+    // b^n, the exponent is reduced modulo p - 1 by Fermat's little theorem
+    auto power(std::uint64_t b, const multiprecision::MPi& n) const -> std::optional<std::uint64_t> {
+        auto sign = mpz_sgn(n.handle());
+        if(sign == 0) return 1;
+        if(b == 0) return sign > 0 ? std::optional<std::uint64_t>(0) : std::nullopt;
+        if(sign < 0) b = modular::inverse_mod(b, m_p);
+        auto k = static_cast<std::uint64_t>(mpz_fdiv_ui(n.handle(), m_p - 1));
+        if(sign < 0) k = (m_p - 1 - k) % (m_p - 1);
+        return modular::pow_mod(b, k, m_p);
+    }
+
+    // A pseudo-random function of name and arguments, fixed for this point
+    auto opaque(const std::string& name, const std::vector<std::uint64_t>& args) const -> std::uint64_t {
+        auto h = mix(m_salt ^ std::hash<std::string>{}(name));
+        for(auto a : args) h = mix(h ^ a);
+        return h % m_p;
+    }
+
+    std::uint64_t m_p;
+    std::uint64_t m_salt;
+    std::mt19937_64& m_rng;
+    std::unordered_map<std::string, std::uint64_t> m_symbols;
+};
+
+} // namespace
+
+auto test_identity(const Symbolic& a, const Symbolic& b, IdentityOptions options) -> Identity {
+    auto da = degree(a.expr());
+    auto db = degree(b.expr());
+    auto d = std::max(da.num + db.den, db.num + da.den);
+    auto opaque = da.opaque || db.opaque;
+
+    // Chance of a zero of a - b at a random point, constants count as
+    // degree one since p might divide their numerator.
+    auto miss = (d + 1) / std::ldexp(1.0, 62);
+    if(miss >= 0.5) return Identity::Undecided;
+    auto trials = std::max(1, static_cast<int>(std::ceil(std::log(options.error_bound) / std::log(miss))));
+
+    auto rng = std::mt19937_64(options.seed != 0 ? options.seed : std::random_device{}());
+    // Points where a denominator vanishes are skipped, but only so often
+    auto skips = 8;
+    for(auto k = 0; k < trials;){
+        auto ev = Evaluator(modular::random_prime(rng), rng);
+        auto va = ev(a.expr());
+        auto vb = ev(b.expr());
+        if(not va || not vb){
+            if(--skips < 0) return Identity::Undecided;
+            continue;
+        }
+        if(*va != *vb) return opaque ? Identity::Undecided : Identity::Different;
+        k++;
+    }
+    return Identity::Equal;
+}
+
+auto probably_equal(const Symbolic& a, const Symbolic& b, IdentityOptions options) -> bool {
+    switch(test_identity(a, b, options)){
+    case Identity::Equal: return true;
+    case Identity::Different: return false;
+    case Identity::Undecided: break;
+    }
+    if(cmp_expression(a.expr(), b.expr()) == 0) return true;
+    auto diff = a - b;
+    auto n = get_as<Number>(diff.expr());
+    return n != nullptr && n->value == 0;
+}
+
+} // namespace symb
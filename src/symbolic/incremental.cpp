@@ -0,0 +1,115 @@
+#include "symbolic/incremental.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace symb{
+
+namespace{
+
+constexpr auto no_node = std::numeric_limits<std::uint32_t>::max();
+
+auto operands(const Instruction& ins) -> int {
+    switch(ins.op){
+    case OpCode::Constant: case OpCode::Variable: return 0;
+    case OpCode::Neg: case OpCode::PowInt: case OpCode::Call: return 1;
+    default: return 2;
+    }
+}
+
+// Whether consumers of a register changing from x to y can keep their
+// values. Bits are compared, since -0.0 == 0.0 but 1/x tells them apart.
+auto unchanged(double x, double y) -> bool {
+    return std::bit_cast<std::uint64_t>(x) == std::bit_cast<std::uint64_t>(y);
+}
+
+} // namespace
+
+EvaluationGraph::EvaluationGraph(Program program, std::span<const double> point)
+    : m_program{std::move(program)}, m_vars(point.begin(), point.end()),
+      m_regs(m_program.registers()), m_queued(m_program.registers(), false)
+{
+    const auto& code = m_program.code;
+    if(point.size() != m_program.variables.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} variables, got {}", m_program.variables.size(), point.size()
+        ));
+    }
+
+    // Consumer lists in compressed form, counted first then filled
+    m_offsets.assign(code.size() + 1, 0);
+    for(const auto& ins : code){
+        auto k = operands(ins);
+        if(k >= 1) m_offsets[ins.a + 1]++;
+        if(k >= 2 && ins.b != ins.a) m_offsets[ins.b + 1]++;
+    }
+    for(std::size_t i = 0; i < code.size(); i++) m_offsets[i + 1] += m_offsets[i];
+    m_consumers.resize(m_offsets.back());
+    auto fill = std::vector<std::uint32_t>(m_offsets.begin(), m_offsets.end() - 1);
+    m_variable_nodes.assign(m_vars.size(), no_node);
+    for(std::uint32_t i = 0; i < code.size(); i++){
+        const auto& ins = code[i];
+        auto k = operands(ins);
+        if(k >= 1) m_consumers[fill[ins.a]++] = i;
+        if(k >= 2 && ins.b != ins.a) m_consumers[fill[ins.b]++] = i;
+        if(ins.op == OpCode::Variable) m_variable_nodes[ins.a] = i;
+    }
+
+    impl::execute<double>(m_program, m_program.constant_values, m_vars, m_regs);
+}
+
+void EvaluationGraph::set(std::size_t variable, double value) {
+    if(variable >= m_vars.size()){
+        throw std::runtime_error(fmt::format("Variable index {} out of range", variable));
+    }
+    m_vars[variable] = value;
+    auto node = m_variable_nodes[variable];
+    if(node == no_node || unchanged(m_regs[node], value)) return;
+    m_regs[node] = value;
+    invalidate_consumers(node);
+}
+
+void EvaluationGraph::set(const std::string& variable, double value) {
+    auto it = std::ranges::find(m_program.variables, variable);
+    if(it == m_program.variables.end()){
+        throw std::runtime_error(fmt::format("Unknown variable {}", variable));
+    }
+    set(static_cast<std::size_t>(it - m_program.variables.begin()), value);
+}
+
+void EvaluationGraph::invalidate_consumers(std::uint32_t node) {
+    for(auto k = m_offsets[node]; k < m_offsets[node + 1]; k++){
+        auto c = m_consumers[k];
+        if(m_queued[c]) continue;
+        m_queued[c] = true;
+        m_pending.push_back(c);
+        std::ranges::push_heap(m_pending, std::greater{});
+    }
+}
+
+auto EvaluationGraph::update() -> std::size_t {
+    std::size_t count = 0;
+    while(not m_pending.empty()){
+        std::ranges::pop_heap(m_pending, std::greater{});
+        auto i = m_pending.back();
+        m_pending.pop_back();
+        m_queued[i] = false;
+        count++;
+        auto v = impl::step<double>(m_program, i, m_program.constant_values, m_vars, m_regs);
+        if(unchanged(m_regs[i], v)) continue;
+        m_regs[i] = v;
+        invalidate_consumers(i);
+    }
+    return count;
+}
+
+auto EvaluationGraph::value(std::size_t k) -> double {
+    update();
+    return m_regs[m_program.outputs.at(k)];
+}
+
+} // namespace symb
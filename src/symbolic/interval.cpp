@@ -0,0 +1,62 @@
+#include "symbolic/interval.hpp"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace symb{
+
+namespace{
+
+// The smallest interval of doubles containing the rational v.
+auto enclose(const impl::ExpressionBase::Number_t& v) -> Interval<double> {
+    auto d = impl::to_double(v);
+    if(std::isinf(d)){
+        auto max = std::numeric_limits<double>::max();
+        return d > 0 ? Interval<double>(max, d) : Interval<double>(d, -max);
+    }
+    mpq_t exact, rounded;
+    mpq_init(exact);
+    mpq_init(rounded);
+    mpz_set(mpq_numref(exact), v.num().handle());
+    mpz_set(mpq_denref(exact), v.denom().handle());
+    mpq_set_d(rounded, d);
+    auto c = mpq_cmp(rounded, exact);
+    mpq_clear(exact);
+    mpq_clear(rounded);
+    if(c < 0) return Interval<double>(d, interval_impl::above(d));
+    if(c > 0) return Interval<double>(interval_impl::below(d), d);
+    return Interval<double>(d);
+}
+
+auto enclose_constants(const Program& p) {
+    std::vector<Interval<double>> ret;
+    for(const auto& c : p.constants) ret.push_back(enclose(c));
+    return ret;
+}
+
+} // namespace
+
+auto evaluate_interval(const Program& p, std::span<const Interval<double>> box) -> Interval<double> {
+    auto ret = Interval<double>();
+    evaluate_interval_batch(p, box, std::span(&ret, 1));
+    return ret;
+}
+
+void evaluate_interval_batch(const Program& p, std::span<const Interval<double>> boxes, std::span<Interval<double>> out) {
+    auto n = p.variables.size();
+    if(boxes.size() != n * out.size()){
+        throw std::runtime_error(fmt::format(
+            "Expected {} boxes of {} intervals, got {} intervals", out.size(), n, boxes.size()
+        ));
+    }
+    auto constants = enclose_constants(p);
+    std::vector<Interval<double>> regs(p.registers());
+    auto rounding = RoundUpward{};
+    for(std::size_t k = 0; k < out.size(); k++){
+        impl::execute<Interval<double>>(p, constants, boxes.subspan(k * n, n), regs);
+        out[k] = regs[p.outputs.at(0)];
+    }
+}
+
+} // namespace symb
@@ -0,0 +1,411 @@
+#include "symbolic/jit.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define SYMB_JIT_X86_64 1
+#endif
+
+namespace symb{
+
+#ifdef SYMB_JIT_X86_64
+
+JitFunction::~JitFunction() {
+    if(m_memory) munmap(m_memory, m_size);
+}
+
+namespace{
+
+enum Gp : std::uint8_t {
+    rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+// SSE2 opcodes, used with the F2 prefix for scalar and 66 for packed doubles
+constexpr std::uint8_t op_load = 0x10;
+constexpr std::uint8_t op_store = 0x11;
+constexpr std::uint8_t op_sqrt = 0x51;
+constexpr std::uint8_t op_xor = 0x57;
+constexpr std::uint8_t op_add = 0x58;
+constexpr std::uint8_t op_mul = 0x59;
+constexpr std::uint8_t op_sub = 0x5C;
+constexpr std::uint8_t op_div = 0x5E;
+constexpr std::uint8_t op_movapd = 0x28;
+
+constexpr std::uint8_t prefix_scalar = 0xF2;
+constexpr std::uint8_t prefix_packed = 0x66;
+
+// Just enough of an x86-64 assembler for the code below. Memory operands are
+// always [base + disp32].
+struct Assembler {
+    std::vector<std::uint8_t> code;
+
+    void emit(std::initializer_list<std::uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    void imm32(std::int32_t v) {
+        auto u = static_cast<std::uint32_t>(v);
+        for(int k = 0; k < 4; k++) code.push_back(static_cast<std::uint8_t>(u >> (8 * k)));
+    }
+
+    void imm64(std::uint64_t v) {
+        for(int k = 0; k < 8; k++) code.push_back(static_cast<std::uint8_t>(v >> (8 * k)));
+    }
+
+    static auto rex(bool w, int reg, int base) -> std::uint8_t {
+        return static_cast<std::uint8_t>(0x40 | (w << 3) | ((reg >= 8) << 2) | (base >= 8));
+    }
+
+    static auto modrm(int mod, int reg, int rm) -> std::uint8_t {
+        return static_cast<std::uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void memory(int reg, Gp base, std::int32_t disp) {
+        code.push_back(modrm(2, reg, base));
+        if((base & 7) == rsp) code.push_back(0x24);
+        imm32(disp);
+    }
+
+    void sse_mem(std::uint8_t prefix, std::uint8_t op, int xmm, Gp base, std::int32_t disp) {
+        code.push_back(prefix);
+        if(xmm >= 8 || base >= 8) code.push_back(rex(false, xmm, base));
+        emit({0x0F, op});
+        memory(xmm, base, disp);
+    }
+
+    // Only xmm0 to xmm7, which is all the code below uses
+    void sse_reg(std::uint8_t prefix, std::uint8_t op, int dst, int src) {
+        emit({prefix, 0x0F, op, modrm(3, dst, src)});
+    }
+
+    void mov_load(Gp dst, Gp base, std::int32_t disp) {
+        emit({rex(true, dst, base), 0x8B});
+        memory(dst, base, disp);
+    }
+
+    void mov_store(Gp base, std::int32_t disp, Gp src) {
+        emit({rex(true, src, base), 0x89});
+        memory(src, base, disp);
+    }
+
+    void mov_reg(Gp dst, Gp src) {
+        emit({rex(true, src, dst), 0x89, modrm(3, src, dst)});
+    }
+
+    void mov_imm(Gp dst, std::uint64_t v) {
+        emit({rex(true, 0, dst), static_cast<std::uint8_t>(0xB8 + (dst & 7))});
+        imm64(v);
+    }
+
+    void add_reg(Gp dst, Gp src) {
+        emit({rex(true, src, dst), 0x01, modrm(3, src, dst)});
+    }
+
+    void cmp_reg(Gp lhs, Gp rhs) {
+        emit({rex(true, rhs, lhs), 0x39, modrm(3, rhs, lhs)});
+    }
+
+    // 81 /ext with ext = 0 for add, 4 for and, 5 for sub
+    void alu_imm(int ext, Gp dst, std::int32_t v) {
+        emit({rex(true, 0, dst), 0x81, modrm(3, ext, dst)});
+        imm32(v);
+    }
+
+    void shl_imm(Gp dst, std::uint8_t v) {
+        emit({rex(true, 0, dst), 0xC1, modrm(3, 4, dst), v});
+    }
+
+    void push(Gp r) {
+        if(r >= 8) code.push_back(0x41);
+        code.push_back(static_cast<std::uint8_t>(0x50 + (r & 7)));
+    }
+
+    void pop(Gp r) {
+        if(r >= 8) code.push_back(0x41);
+        code.push_back(static_cast<std::uint8_t>(0x58 + (r & 7)));
+    }
+
+    void call(Gp r) {
+        if(r >= 8) code.push_back(0x41);
+        emit({0xFF, modrm(3, 2, r)});
+    }
+
+    // Emits a jump with a yet unknown target, returns where to patch it.
+    auto jump(std::initializer_list<std::uint8_t> opcode) -> std::size_t {
+        emit(opcode);
+        imm32(0);
+        return code.size();
+    }
+
+    void patch(std::size_t jump_end, std::size_t target) {
+        auto rel = static_cast<std::int32_t>(static_cast<std::int64_t>(target) - static_cast<std::int64_t>(jump_end));
+        std::memcpy(code.data() + jump_end - 4, &rel, 4);
+    }
+
+    void ret() { code.push_back(0xC3); }
+};
+
+template<Builtin f>
+double builtin_thunk(double x) {
+    return call_builtin(f, x);
+}
+
+double pow_thunk(double x, double y) {
+    return std::pow(x, y);
+}
+
+auto builtin_address(Builtin f) -> std::uint64_t {
+    double(*fn)(double) = nullptr;
+    switch(f){
+    case Builtin::Sin: fn = builtin_thunk<Builtin::Sin>; break;
+    case Builtin::Cos: fn = builtin_thunk<Builtin::Cos>; break;
+    case Builtin::Tan: fn = builtin_thunk<Builtin::Tan>; break;
+    case Builtin::Exp: fn = builtin_thunk<Builtin::Exp>; break;
+    case Builtin::Log: fn = builtin_thunk<Builtin::Log>; break;
+    case Builtin::Sqrt: fn = builtin_thunk<Builtin::Sqrt>; break;
+    }
+    return reinterpret_cast<std::uintptr_t>(fn);
+}
+
+// Register i of the program is spilled to [rsp + 16 * i], constants live in
+// 16 byte entries [c, c] at r12, followed by the sign mask used for negation.
+// In column mode rbx points to the input columns, r13 to the output columns
+// and r15 holds the byte offset of the current point, otherwise rbx points
+// to the input values directly.
+struct CodeGenerator {
+    const Program& p;
+    Assembler& as;
+    int width;
+    bool columns;
+
+    auto prefix() const { return width == 2 ? prefix_packed : prefix_scalar; }
+
+    static auto slot(std::size_t i) -> std::int32_t { return static_cast<std::int32_t>(16 * i); }
+    static auto entry(std::size_t i) -> std::int32_t { return static_cast<std::int32_t>(16 * i); }
+
+    void load(int xmm, Gp base, std::int32_t disp) { as.sse_mem(prefix(), op_load, xmm, base, disp); }
+    void store(Gp base, std::int32_t disp, int xmm) { as.sse_mem(prefix(), op_store, xmm, base, disp); }
+
+    void load_variable(int xmm, std::uint32_t a) {
+        if(columns){
+            as.mov_load(rax, rbx, static_cast<std::int32_t>(8 * a));
+            as.add_reg(rax, r15);
+            load(xmm, rax, 0);
+        }
+        else{
+            as.sse_mem(prefix_scalar, op_load, xmm, rbx, static_cast<std::int32_t>(8 * a));
+        }
+    }
+
+    // Calls f once per lane with the lane values of registers a and b in xmm0 and xmm1.
+    void call_per_lane(std::uint64_t f, std::size_t i, std::uint32_t a, std::optional<std::uint32_t> b) {
+        for(int lane = 0; lane < width; lane++){
+            as.sse_mem(prefix_scalar, op_load, 0, rsp, slot(a) + 8 * lane);
+            if(b) as.sse_mem(prefix_scalar, op_load, 1, rsp, slot(*b) + 8 * lane);
+            as.mov_imm(rax, f);
+            as.call(rax);
+            as.sse_mem(prefix_scalar, op_store, 0, rsp, slot(i) + 8 * lane);
+        }
+    }
+
+    void arithmetic(std::uint8_t op, const Instruction& ins) {
+        load(0, rsp, slot(ins.a));
+        load(1, rsp, slot(ins.b));
+        as.sse_reg(prefix(), op, 0, 1);
+    }
+
+    // x^n by repeated squaring, the square is kept in xmm0 and the result in xmm1
+    void power(const Instruction& ins) {
+        load(0, rsp, slot(ins.a));
+        auto have_result = false;
+        for(auto n = ins.n; n != 0; n >>= 1){
+            if(n & 1){
+                if(have_result) as.sse_reg(prefix(), op_mul, 1, 0);
+                else as.sse_reg(prefix_packed, op_movapd, 1, 0);
+                have_result = true;
+            }
+            if(n > 1) as.sse_reg(prefix(), op_mul, 0, 0);
+        }
+        as.sse_reg(prefix_packed, op_movapd, 0, 1);
+    }
+
+    void body() {
+        for(std::size_t i = 0; i < p.code.size(); i++){
+            const auto& ins = p.code[i];
+            switch(ins.op){
+            case OpCode::Constant: load(0, r12, entry(ins.a)); break;
+            case OpCode::Variable: load_variable(0, ins.a); break;
+            case OpCode::Add: arithmetic(op_add, ins); break;
+            case OpCode::Sub: arithmetic(op_sub, ins); break;
+            case OpCode::Mul: arithmetic(op_mul, ins); break;
+            case OpCode::Div: arithmetic(op_div, ins); break;
+            case OpCode::Neg:{
+                load(0, rsp, slot(ins.a));
+                as.sse_mem(prefix_packed, op_load, 1, r12, entry(p.constants.size()));
+                as.sse_reg(prefix_packed, op_xor, 0, 1);
+                break;
+            }
+            case OpCode::PowInt: power(ins); break;
+            case OpCode::Pow:{
+                call_per_lane(reinterpret_cast<std::uintptr_t>(&pow_thunk), i, ins.a, ins.b);
+                continue;
+            }
+            case OpCode::Call:{
+                if(ins.fn == Builtin::Sqrt){
+                    load(1, rsp, slot(ins.a));
+                    as.sse_reg(prefix(), op_sqrt, 0, 1);
+                    break;
+                }
+                call_per_lane(builtin_address(ins.fn), i, ins.a, std::nullopt);
+                continue;
+            }
+            }
+            store(rsp, slot(i), 0);
+        }
+    }
+
+    void store_outputs() {
+        for(std::size_t j = 0; j < p.outputs.size(); j++){
+            load(0, rsp, slot(p.outputs[j]));
+            as.mov_load(rax, r13, static_cast<std::int32_t>(8 * j));
+            as.add_reg(rax, r15);
+            store(rax, 0, 0);
+        }
+    }
+};
+
+auto frame_size(const Program& p) -> std::int32_t {
+    // One more slot than registers, the batch kernel keeps n there.
+    return static_cast<std::int32_t>(16 * (p.registers() + 1));
+}
+
+// double f(const double* in)
+void emit_scalar(const Program& p, Assembler& as, std::uint64_t table) {
+    // Entry leaves rsp 8 off 16 byte alignment, three pushes fix that up.
+    as.push(rbx);
+    as.push(r12);
+    as.push(r13);
+    as.alu_imm(5, rsp, frame_size(p));
+    as.mov_reg(rbx, rdi);
+    as.mov_imm(r12, table);
+
+    CodeGenerator{p, as, 1, false}.body();
+    as.sse_mem(prefix_scalar, op_load, 0, rsp, CodeGenerator::slot(p.outputs.at(0)));
+
+    as.alu_imm(0, rsp, frame_size(p));
+    as.pop(r13);
+    as.pop(r12);
+    as.pop(rbx);
+    as.ret();
+}
+
+// void f(size_t n, const double* const* in, double* const* out)
+void emit_batch(const Program& p, Assembler& as, std::uint64_t table) {
+    as.push(rbx);
+    as.push(r12);
+    as.push(r13);
+    as.push(r14);
+    as.push(r15);
+    as.alu_imm(5, rsp, frame_size(p));
+    auto n_slot = CodeGenerator::slot(p.registers());
+    as.mov_store(rsp, n_slot, rdi);
+    as.mov_reg(rbx, rsi);
+    as.mov_reg(r13, rdx);
+    as.mov_imm(r12, table);
+    // r14 = byte offset past the last pair of points, r15 = current offset
+    as.mov_reg(r14, rdi);
+    as.alu_imm(4, r14, -2);
+    as.shl_imm(r14, 3);
+    as.mov_imm(r15, 0);
+
+    auto loop = as.code.size();
+    as.cmp_reg(r15, r14);
+    auto exit_loop = as.jump({0x0F, 0x83});    // jae
+    auto packed = CodeGenerator{p, as, 2, true};
+    packed.body();
+    packed.store_outputs();
+    as.alu_imm(0, r15, 16);
+    as.patch(as.jump({0xE9}), loop);
+    as.patch(exit_loop, as.code.size());
+
+    // A remaining odd point goes through the scalar variant.
+    as.mov_load(rax, rsp, n_slot);
+    as.emit({0xA8, 0x01});  // test al, 1
+    auto skip_tail = as.jump({0x0F, 0x84});    // jz
+    auto tail = CodeGenerator{p, as, 1, true};
+    tail.body();
+    tail.store_outputs();
+    as.patch(skip_tail, as.code.size());
+
+    as.alu_imm(0, rsp, frame_size(p));
+    as.pop(r15);
+    as.pop(r14);
+    as.pop(r13);
+    as.pop(r12);
+    as.pop(rbx);
+    as.ret();
+}
+
+} // namespace
+
+auto jit_compile(const Program& p) -> JitFunction {
+    if(p.outputs.empty()){
+        throw std::runtime_error("Cannot compile a program without outputs");
+    }
+
+    // Constant table first, code after it, all in one mapping.
+    std::vector<double> table;
+    for(auto c : p.constant_values){
+        table.push_back(c);
+        table.push_back(c);
+    }
+    auto sign_mask = -0.0;
+    table.push_back(sign_mask);
+    table.push_back(sign_mask);
+    auto table_size = table.size() * sizeof(double);
+
+    // The table address is only known after mapping, so assemble twice:
+    // once to learn the size and once for real.
+    auto assemble = [&](std::uint64_t table_address, std::size_t& batch_offset){
+        auto as = Assembler{};
+        emit_scalar(p, as, table_address);
+        batch_offset = as.code.size();
+        emit_batch(p, as, table_address);
+        return as.code;
+    };
+    std::size_t batch_offset = 0;
+    auto size = table_size + assemble(0, batch_offset).size();
+
+    auto* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED){
+        throw std::runtime_error("Could not map memory for JIT compiled code");
+    }
+    auto* bytes = static_cast<std::uint8_t*>(memory);
+    auto code = assemble(reinterpret_cast<std::uintptr_t>(bytes), batch_offset);
+    std::memcpy(bytes, table.data(), table_size);
+    std::memcpy(bytes + table_size, code.data(), code.size());
+    if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0){
+        munmap(memory, size);
+        throw std::runtime_error("Could not make JIT compiled code executable");
+    }
+
+    auto scalar = reinterpret_cast<JitFunction::Scalar>(reinterpret_cast<std::uintptr_t>(bytes + table_size));
+    auto batch = reinterpret_cast<JitFunction::Batch>(reinterpret_cast<std::uintptr_t>(bytes + table_size + batch_offset));
+    return JitFunction(memory, size, scalar, batch);
+}
+
+#else
+
+JitFunction::~JitFunction() {}
+
+auto jit_compile(const Program&) -> JitFunction {
+    throw std::runtime_error("JIT compilation is only supported on x86-64");
+}
+
+#endif
+
+} // namespace symb
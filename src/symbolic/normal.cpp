@@ -0,0 +1,161 @@
+#include "symbolic/normal.hpp"
+
+#include <deque>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "math/rational_function.hpp"
+#include "symbolic/compare.hpp"
+
+namespace symb{
+
+namespace{
+
+using namespace impl;
+using multiprecision::MPi;
+using Rational = ExpressionBase::Number_t;
+using Poly = SparsePoly<Rational>;
+
+// The exponent of a power of a rational function, if it is an integer
+auto integer_exponent(const ExprPtr& e) -> std::optional<long> {
+    auto n = get_as<Number>(e->children[1]);
+    if(n == nullptr || n->value.denom() != 1 || not mpz_fits_slong_p(n->value.num().handle())) return {};
+    return mpz_get_si(n->value.num().handle());
+}
+
+struct AtomLess {
+    auto operator()(const ExprPtr* a, const ExprPtr* b) const -> bool {
+        return cmp_expression(*a, *b) < 0;
+    }
+};
+
+// First pass: finds the atoms and bounds the degrees of numerator and
+// denominator together
+struct Atoms {
+    // A deque for stable addresses, the index points into it
+    std::deque<ExprPtr> atoms;
+    std::map<const ExprPtr*, std::size_t, AtomLess> index;
+    std::unordered_map<const ExpressionBase*, std::size_t> atom_of;
+
+    auto collect(const ExprPtr& e) -> long {
+        switch(e->kind()){
+        case Kind::Number:
+            return 0;
+        case Kind::SumOp:
+        case Kind::ProdOp: {
+            long ret = 0;
+            for(const auto& c : e->children) ret += collect(c);
+            return ret;
+        }
+        case Kind::PowOp: {
+            if(auto n = integer_exponent(e)) return collect(e->children[0]) * std::abs(*n);
+            break;
+        }
+        default: break;
+        }
+        add_atom(e);
+        return 1;
+    }
+
+    void add_atom(const ExprPtr& e) {
+        auto a = e->copy();
+        for(auto& c : a->children) c = normal(Symbolic::from_simplified(std::move(c))).expr()->copy();
+        if(not a->children.empty()) a = Symbolic(std::move(a)).expr()->copy();
+        atoms.push_back(std::move(a));
+        auto [it, inserted] = index.emplace(&atoms.back(), atoms.size() - 1);
+        if(not inserted) atoms.pop_back();
+        atom_of[e.get()] = it->second;
+    }
+
+    // Numbers the atoms in the order of cmp_expression, so the leading
+    // term, and with it the normal form, does not depend on the order in
+    // which the atoms were found
+    void sort() {
+        auto position = std::vector<std::size_t>(atoms.size());
+        auto sorted = std::deque<ExprPtr>();
+        for(auto& [atom, i] : index){
+            position[i] = sorted.size();
+            sorted.push_back(std::move(atoms[i]));
+        }
+        atoms = std::move(sorted);
+        index.clear();
+        for(auto& [node, i] : atom_of) i = position[i];
+    }
+};
+
+struct Converter {
+    MonomialLayout layout;
+    const Atoms& atoms;
+
+    auto convert(const ExprPtr& e) -> RationalFunction<Rational> {
+        switch(e->kind()){
+        case Kind::Number:
+            return RationalFunction<Rational>(Poly::constant(layout, get_as<Number>(e)->value));
+        case Kind::SumOp: {
+            auto ret = convert(e->children[0]);
+            for(std::size_t i = 1; i < e->children.size(); i++) ret += convert(e->children[i]);
+            return ret;
+        }
+        case Kind::ProdOp: {
+            auto ret = convert(e->children[0]);
+            for(std::size_t i = 1; i < e->children.size(); i++) ret *= convert(e->children[i]);
+            return ret;
+        }
+        case Kind::PowOp: {
+            if(auto n = integer_exponent(e)) return math::pow(convert(e->children[0]), *n);
+            break;
+        }
+        default: break;
+        }
+        return RationalFunction<Rational>(Poly::variable(layout, atoms.atom_of.at(e.get())));
+    }
+};
+
+auto to_expression(const Poly& p, const Atoms& atoms) -> ExprPtr {
+    std::vector<ExprPtr> terms;
+    for(std::size_t i = 0; i < p.size(); i++){
+        std::vector<ExprPtr> factors;
+        factors.push_back(make_expression<Number>(p.coefficient(i)));
+        auto exponents = p.exponents(i);
+        for(std::size_t k = 0; k < exponents.size(); k++){
+            if(exponents[k] == 0) continue;
+            factors.push_back(make_expression<Power>(atoms.atoms[k]->copy(), make_expression<Number>(exponents[k])));
+        }
+        terms.push_back(make_expression<Product>(std::move(factors)));
+    }
+    if(terms.empty()) return make_expression<Number>(0);
+    return make_expression<Sum>(std::move(terms));
+}
+
+} // namespace
+
+auto normal(const Symbolic& expr) -> Symbolic {
+    const auto& e = expr.expr();
+    if(e->kind() == Kind::Number || e->kind() == Kind::Symbol) return expr;
+    auto atoms = Atoms{};
+    auto degree = atoms.collect(e);
+    atoms.sort();
+    auto bits = degree < (1l << 15) ? 16u : 32u;
+    auto converter = Converter{MonomialLayout(atoms.atoms.size(), MonomialOrder::Lex, bits), atoms};
+    auto f = converter.convert(e);
+    const auto& denominator = f.denominator();
+    if(denominator.degree() <= 0) return Symbolic(to_expression(f.numerator(), atoms));
+
+    // Scaled to coprime integer coefficients, the monic denominator keeps
+    // its leading coefficient positive
+    auto lcm = MPi(1), content = MPi(0);
+    for(std::size_t i = 0; i < denominator.size(); i++) mpz_lcm(lcm.handle(), lcm.handle(), denominator.coefficient(i).denom().handle());
+    for(std::size_t i = 0; i < denominator.size(); i++){
+        auto c = MPi();
+        mpz_divexact(c.handle(), lcm.handle(), denominator.coefficient(i).denom().handle());
+        mpz_gcd(content.handle(), content.handle(), (c * denominator.coefficient(i).num()).handle());
+    }
+    auto scale = Rational(lcm, content);
+    auto numerator = to_expression(f.numerator() * scale, atoms);
+    auto inverse = make_expression<Power>(to_expression(denominator * scale, atoms), make_expression<Number>(-1));
+    return Symbolic(make_expression<Product>(std::move(numerator), std::move(inverse)));
+}
+
+} // namespace symb
@@ -0,0 +1,297 @@
+#include "symbolic/pattern.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+#include "symbolic/compare.hpp"
+
+namespace symb{
+namespace impl{
+namespace{
+
+constexpr auto kinds = static_cast<std::size_t>(Kind::Undefined) + 1;
+
+// The name of a wildcard, with the underscore
+auto wildcard(const ExprPtr& e) -> const std::string* {
+    auto s = get_as<Symbol>(e);
+    if(s == nullptr || s->name.size() < 2 || s->name.back() != '_') return nullptr;
+    return &s->name;
+}
+
+// The name of a function or symbol, or of the symbol a power is of. Empty
+// for other nodes and wildcards.
+auto head(const ExprPtr& e) -> std::string_view {
+    switch(e->kind()){
+    case Kind::Function: return get_as<Function>(e)->name;
+    case Kind::Symbol: return wildcard(e) ? "" : std::string_view{get_as<Symbol>(e)->name};
+    case Kind::PowOp: return e->children[0]->kind() == Kind::Symbol ? head(e->children[0]) : "";
+    default: return "";
+    }
+}
+
+struct Matcher {
+    // The wildcards bound so far, failed attempts truncate it to where they
+    // started
+    std::vector<std::pair<std::string, ExprPtr>> bindings;
+
+    auto bind(const std::string& name, ExprPtr value) -> bool {
+        for(const auto& [n, v] : bindings){
+            if(n == name) return cmp_expression(v, value) == 0;
+        }
+        bindings.emplace_back(name, std::move(value));
+        return true;
+    }
+
+    auto node(const ExprPtr& p, const ExprPtr& e) -> bool {
+        if(auto w = wildcard(p)) return bind(*w, e->copy());
+        if(p->kind() != e->kind()) return false;
+        switch(p->kind()){
+        case Kind::Function:
+            if(get_as<Function>(p)->name != get_as<Function>(e)->name) return false;
+            return ordered(p, e);
+        case Kind::PowOp:
+            return ordered(p, e);
+        case Kind::SumOp:
+        case Kind::ProdOp: {
+            std::vector<char> used(e->children.size(), 0);
+            return operands(p, e, used, false);
+        }
+        default:
+            return cmp_expression(p, e) == 0;
+        }
+    }
+
+    auto ordered(const ExprPtr& p, const ExprPtr& e) -> bool {
+        if(p->children.size() != e->children.size()) return false;
+        for(std::size_t i = 0; i < p->children.size(); i++){
+            if(not node(p->children[i], e->children[i])) return false;
+        }
+        return true;
+    }
+
+    // Matches the operands of the sum or product p with some of those of
+    // e, marking them in used, all of them unless partial. The counts of
+    // operands of each kind are compared before any search.
+    auto operands(const ExprPtr& p, const ExprPtr& e, std::vector<char>& used, bool partial) -> bool {
+        std::vector<const ExprPtr*> fixed;
+        std::vector<const std::string*> wild;
+        for(const auto& c : p->children){
+            if(auto w = wildcard(c)) wild.push_back(w);
+            else fixed.push_back(&c);
+        }
+        auto n = e->children.size();
+        if(fixed.size() + wild.size() > n) return false;
+        if(not partial && wild.empty() && fixed.size() != n) return false;
+        std::array<std::size_t, kinds> have{}, need{};
+        for(const auto& c : e->children) have[static_cast<std::size_t>(c->kind())]++;
+        for(auto f : fixed) need[static_cast<std::size_t>((*f)->kind())]++;
+        for(std::size_t k = 0; k < kinds; k++){
+            if(need[k] > have[k]) return false;
+        }
+        return assign(fixed, 0, wild, e, used, partial);
+    }
+
+    // Backtracks over the operands of e for the fixed operands from i on,
+    // then for the wildcards
+    auto assign(const std::vector<const ExprPtr*>& fixed, std::size_t i, const std::vector<const std::string*>& wild, const ExprPtr& e, std::vector<char>& used, bool partial) -> bool {
+        if(i == fixed.size()) return assign_wildcards(wild, 0, e, used, partial);
+        for(std::size_t j = 0; j < e->children.size(); j++){
+            if(used[j] || e->children[j]->kind() != (*fixed[i])->kind()) continue;
+            auto mark = bindings.size();
+            if(node(*fixed[i], e->children[j])){
+                used[j] = 1;
+                if(assign(fixed, i + 1, wild, e, used, partial)) return true;
+                used[j] = 0;
+            }
+            bindings.resize(mark);
+        }
+        return false;
+    }
+
+    auto assign_wildcards(const std::vector<const std::string*>& wild, std::size_t i, const ExprPtr& e, std::vector<char>& used, bool partial) -> bool {
+        if(i == wild.size()) return partial || std::ranges::all_of(used, [](char u){ return u != 0; });
+        const auto& children = e->children;
+        if(i + 1 == wild.size() && not partial){
+            // The last wildcard takes all the rest, a subset of the operands
+            // of a simplified sum or product is simplified as well
+            std::vector<ExprPtr> rest;
+            for(std::size_t j = 0; j < children.size(); j++){
+                if(not used[j]) rest.push_back(children[j]->copy());
+            }
+            if(rest.empty()) return false;
+            auto value = rest.size() == 1 ? std::move(rest.front()) : with_children(e, std::move(rest));
+            if(not bind(*wild[i], std::move(value))) return false;
+            std::ranges::fill(used, 1);
+            return true;
+        }
+        for(std::size_t j = 0; j < children.size(); j++){
+            if(used[j]) continue;
+            auto mark = bindings.size();
+            if(bind(*wild[i], children[j]->copy())){
+                used[j] = 1;
+                if(assign_wildcards(wild, i + 1, e, used, partial)) return true;
+                used[j] = 0;
+            }
+            bindings.resize(mark);
+        }
+        return false;
+    }
+
+    // The template t with the bound wildcards substituted, nothing if it
+    // has none
+    auto instantiate(const SimplificationContext& sc, const ExprPtr& t) const -> std::optional<ExprPtr> {
+        if(auto w = wildcard(t)){
+            for(const auto& [n, v] : bindings){
+                if(n == *w) return v->copy();
+            }
+            return std::nullopt;
+        }
+        std::vector<std::optional<ExprPtr>> replaced;
+        auto changed = false;
+        for(const auto& c : t->children){
+            replaced.push_back(instantiate(sc, c));
+            changed = changed || replaced.back().has_value();
+        }
+        if(not changed) return std::nullopt;
+        std::vector<ExprPtr> children;
+        for(std::size_t i = 0; i < replaced.size(); i++){
+            children.push_back(replaced[i] ? std::move(*replaced[i]) : t->children[i]->copy());
+        }
+        return Simplifier::automatic_simplify_node(sc, with_children(t, std::move(children)));
+    }
+
+    auto instantiate(const SimplificationContext& sc, const Symbolic& replacement) const -> ExprPtr {
+        auto ret = instantiate(sc, replacement.expr());
+        return ret ? std::move(*ret) : replacement.expr()->copy();
+    }
+};
+
+struct Replacer {
+    const SimplificationContext& sc;
+    const std::vector<Rule>& rules;
+    const std::vector<std::uint32_t>& end;
+    std::vector<char> candidate;
+    // The number of candidates before each node, a subtree holds some if
+    // the count at its end is larger
+    std::vector<std::uint32_t> before;
+
+    // Returns nothing if the subtree at node i does not change
+    auto run(const ExprPtr& e, std::uint32_t i) -> std::optional<ExprPtr> {
+        if(before[end[i]] == before[i]) return std::nullopt;
+        if(candidate[i]){
+            if(auto ret = replace(e, i)) return ret;
+        }
+        return children(e, i, std::vector<char>(e->children.size(), 0), std::nullopt);
+    }
+
+    auto replace(const ExprPtr& e, std::uint32_t i) -> std::optional<ExprPtr> {
+        for(const auto& [pattern, replacement] : rules){
+            const auto& p = pattern.expr();
+            auto m = Matcher{};
+            if(m.node(p, e)) return m.instantiate(sc, replacement);
+            if(p->kind() != e->kind() || (p->kind() != Kind::SumOp && p->kind() != Kind::ProdOp)) continue;
+            m = Matcher{};
+            std::vector<char> used(e->children.size(), 0);
+            if(m.operands(p, e, used, true)) return children(e, i, used, m.instantiate(sc, replacement));
+        }
+        return std::nullopt;
+    }
+
+    // e with the children not used rewritten in turn, and the others
+    // replaced by extra
+    auto children(const ExprPtr& e, std::uint32_t i, const std::vector<char>& used, std::optional<ExprPtr> extra) -> std::optional<ExprPtr> {
+        std::vector<std::optional<ExprPtr>> replaced;
+        auto changed = extra.has_value();
+        for(std::size_t k = 0, j = i + 1; k < e->children.size(); k++, j = end[j]){
+            replaced.push_back(used[k] ? std::nullopt : run(e->children[k], static_cast<std::uint32_t>(j)));
+            changed = changed || replaced.back().has_value();
+        }
+        if(not changed) return std::nullopt;
+        std::vector<ExprPtr> children;
+        for(std::size_t k = 0; k < replaced.size(); k++){
+            if(used[k]) continue;
+            children.push_back(replaced[k] ? std::move(*replaced[k]) : e->children[k]->copy());
+        }
+        if(extra) children.push_back(std::move(*extra));
+        return Simplifier::automatic_simplify_node(sc, with_children(e, std::move(children)));
+    }
+};
+
+} // namespace
+} // namespace impl
+
+auto wild(const std::string& name) -> Symbolic {
+    return var(name + "_");
+}
+
+auto match(const Symbolic& expr, const Symbolic& pattern) -> std::optional<Bindings> {
+    auto m = impl::Matcher{};
+    if(not m.node(pattern.expr(), expr.expr())) return std::nullopt;
+    auto ret = Bindings{};
+    for(auto& [name, value] : m.bindings){
+        ret.emplace(name.substr(0, name.size() - 1), Symbolic::from_simplified(std::move(value)));
+    }
+    return ret;
+}
+
+PatternIndex::PatternIndex(Symbolic _expr)
+    : m_expr{std::move(_expr)}
+{
+    add(m_expr.expr());
+    m_all.resize(m_nodes.size());
+    std::iota(m_all.begin(), m_all.end(), 0);
+}
+
+void PatternIndex::add(const impl::ExprPtr& e) {
+    auto i = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.push_back(e.get());
+    m_end.push_back(0);
+    m_by_kind[e->kind()].push_back(i);
+    if(auto h = impl::head(e); not h.empty()) m_by_head[{e->kind(), h}].push_back(i);
+    for(const auto& c : e->children) add(c);
+    m_end[i] = static_cast<std::uint32_t>(m_nodes.size());
+}
+
+auto PatternIndex::positions(const Symbolic& pattern) const -> const std::vector<std::uint32_t>& {
+    static const auto none = std::vector<std::uint32_t>{};
+    const auto& p = pattern.expr();
+    if(impl::wildcard(p)) return m_all;
+    if(auto h = impl::head(p); not h.empty()){
+        auto it = m_by_head.find({p->kind(), h});
+        return it == m_by_head.end() ? none : it->second;
+    }
+    auto it = m_by_kind.find(p->kind());
+    return it == m_by_kind.end() ? none : it->second;
+}
+
+auto PatternIndex::candidates(const Symbolic& pattern) const -> std::vector<const impl::ExpressionBase*> {
+    std::vector<const impl::ExpressionBase*> ret;
+    for(auto i : positions(pattern)) ret.push_back(m_nodes[i]);
+    return ret;
+}
+
+auto PatternIndex::replace_all(const std::vector<Rule>& rules) const -> Symbolic {
+    auto sc = impl::SimplificationContext{};
+    auto replacer = impl::Replacer{sc, rules, m_end, std::vector<char>(m_nodes.size(), 0), {}};
+    for(const auto& [pattern, replacement] : rules){
+        for(auto i : positions(pattern)) replacer.candidate[i] = 1;
+    }
+    replacer.before.resize(m_nodes.size() + 1, 0);
+    for(std::size_t i = 0; i < m_nodes.size(); i++){
+        replacer.before[i + 1] = replacer.before[i] + static_cast<std::uint32_t>(replacer.candidate[i]);
+    }
+    auto ret = replacer.run(m_expr.expr(), 0);
+    if(not ret) return m_expr;
+    return Symbolic::from_simplified(std::move(*ret));
+}
+
+auto replace_all(const Symbolic& expr, const Symbolic& pattern, const Symbolic& replacement) -> Symbolic {
+    return replace_all(expr, {{pattern, replacement}});
+}
+
+auto replace_all(const Symbolic& expr, const std::vector<Rule>& rules) -> Symbolic {
+    return PatternIndex(expr).replace_all(rules);
+}
+
+} // namespace symb
@@ -0,0 +1,268 @@
+#include "symbolic/polynomial.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace symb{
+
+namespace{
+
+using namespace impl;
+using multiprecision::MPi;
+
+template<class C>
+auto coefficient(const Rational& v, const ExprPtr& e) -> C {
+    if constexpr(std::same_as<C, MPi>){
+        if(v.denom() != 1){
+            throw std::runtime_error(fmt::format("Non-integer coefficient in an integer polynomial: {}", e->str()));
+        }
+        return v.num();
+    }
+    else return v;
+}
+
+// The largest degree an expression can expand to, to size the exponent fields
+auto degree_bound(const ExprPtr& e) -> long {
+    switch(e->kind()){
+    case Kind::Symbol: return 1;
+    case Kind::SumOp: {
+        long ret = 0;
+        for(const auto& c : e->children) ret = std::max(ret, degree_bound(c));
+        return ret;
+    }
+    case Kind::ProdOp: {
+        long ret = 0;
+        for(const auto& c : e->children) ret += degree_bound(c);
+        return ret;
+    }
+    case Kind::PowOp: {
+        auto n = get_as<Number>(e->children[1]);
+        if(n == nullptr || not mpz_fits_slong_p(n->value.num().handle())) return 0;
+        return degree_bound(e->children[0]) * mpz_get_si(n->value.num().handle());
+    }
+    default: return 0;
+    }
+}
+
+// The names of all symbols and whether all numbers are integers
+void collect_symbols(const ExprPtr& e, std::vector<std::string>& names, bool& integral) {
+    if(e->kind() == Kind::Symbol) names.push_back(get_as<Symbol>(e)->name);
+    if(e->kind() == Kind::Number && get_as<Number>(e)->value.denom() != 1) integral = false;
+    for(const auto& c : e->children) collect_symbols(c, names, integral);
+}
+
+template<class C>
+struct Converter {
+    MonomialLayout layout;
+    const std::vector<std::string>& variables;
+
+    auto convert(const ExprPtr& e) -> SparsePoly<C> {
+        switch(e->kind()){
+        case Kind::Number:
+            return SparsePoly<C>::constant(layout, coefficient<C>(get_as<Number>(e)->value, e));
+        case Kind::Symbol: {
+            auto it = std::ranges::find(variables, get_as<Symbol>(e)->name);
+            if(it == variables.end()) break;
+            return SparsePoly<C>::variable(layout, static_cast<std::size_t>(it - variables.begin()));
+        }
+        case Kind::SumOp: {
+            auto ret = SparsePoly<C>(layout);
+            for(const auto& c : e->children) ret += convert(c);
+            return ret;
+        }
+        case Kind::ProdOp: {
+            auto ret = SparsePoly<C>::constant(layout, C(1));
+            for(const auto& c : e->children) ret *= convert(c);
+            return ret;
+        }
+        case Kind::PowOp: {
+            auto n = get_as<Number>(e->children[1]);
+            if(n == nullptr || n->value < 0 || n->value.denom() != 1 || not mpz_fits_slong_p(n->value.num().handle())) break;
+            return math::pow(convert(e->children[0]), mpz_get_si(n->value.num().handle()));
+        }
+        default: break;
+        }
+        throw std::runtime_error(fmt::format("Not a polynomial in the given variables: {}", e->str()));
+    }
+};
+
+// The sorted symbols of some expressions, and whether all numbers are
+// integers
+template<class... E>
+auto symbols(bool& integral, const E&... exprs) -> std::vector<std::string> {
+    std::vector<std::string> ret;
+    (collect_symbols(exprs.expr(), ret, integral), ...);
+    std::ranges::sort(ret);
+    auto [first, last] = std::ranges::unique(ret);
+    ret.erase(first, last);
+    return ret;
+}
+
+// The polynomial times the least common denominator of its coefficients,
+// which is returned alongside
+auto clear_denominators(const SparsePoly<Rational>& p) -> std::pair<SparsePoly<MPi>, MPi> {
+    auto denominator = MPi(1);
+    for(std::size_t i = 0; i < p.size(); i++) mpz_lcm(denominator.handle(), denominator.handle(), p.coefficient(i).denom().handle());
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(std::size_t i = 0; i < p.size(); i++){
+        auto c = p.coefficient(i).num();
+        mpz_mul(c.handle(), c.handle(), denominator.handle());
+        mpz_divexact(c.handle(), c.handle(), p.coefficient(i).denom().handle());
+        terms.emplace_back(std::move(c), p.exponents(i));
+    }
+    return {SparsePoly<MPi>::from_terms(p.layout(), std::move(terms)), std::move(denominator)};
+}
+
+// p with its terms packed in another layout of the same variables
+auto relayout(const SparsePoly<MPi>& p, const MonomialLayout& layout) -> SparsePoly<MPi> {
+    std::vector<std::pair<MPi, std::vector<long>>> terms;
+    for(std::size_t i = 0; i < p.size(); i++) terms.emplace_back(p.coefficient(i), p.exponents(i));
+    return SparsePoly<MPi>::from_terms(layout, std::move(terms));
+}
+
+// The polynomials in the variables cleared of denominators, which are
+// returned alongside, with exponent fields as wide as the widest any of
+// them needs
+auto integer_polynomials(const std::vector<Symbolic>& polys, const std::vector<std::string>& variables, MonomialOrder order = MonomialOrder::Lex) -> std::pair<std::vector<SparsePoly<MPi>>, std::vector<MPi>> {
+    std::vector<SparsePoly<MPi>> integral;
+    std::vector<MPi> denominators;
+    auto bits = 16u;
+    for(const auto& p : polys){
+        auto [f, d] = clear_denominators(to_sparse_poly<Rational>(p, variables, order));
+        bits = std::max(bits, f.layout().bits());
+        integral.push_back(std::move(f));
+        denominators.push_back(std::move(d));
+    }
+    auto layout = MonomialLayout(variables.size(), order, bits);
+    for(auto& f : integral){
+        if(not (f.layout() == layout)) f = relayout(f, layout);
+    }
+    return {std::move(integral), std::move(denominators)};
+}
+
+// The position of a variable, added in order if missing
+auto index_of(std::vector<std::string>& variables, const std::string& variable) -> std::size_t {
+    auto it = std::ranges::lower_bound(variables, variable);
+    if(it == variables.end() || *it != variable) it = variables.insert(it, variable);
+    return static_cast<std::size_t>(it - variables.begin());
+}
+
+// p / d with rational coefficients
+auto divided(const SparsePoly<MPi>& p, const MPi& d) -> SparsePoly<Rational> {
+    auto ret = SparsePoly<Rational>(p.layout());
+    ret.reserve(p.size());
+    for(std::size_t i = 0; i < p.size(); i++) ret.push_back(Rational(p.coefficient(i), d), p.monomial(i));
+    return ret;
+}
+
+// The factorization of expr's polynomial in its symbols as an expression
+template<class Factor>
+auto factored(const Symbolic& expr, Factor factor) -> Symbolic {
+    auto integral = true;
+    auto variables = symbols(integral, expr);
+    auto [p, denominator] = clear_denominators(to_sparse_poly<Rational>(expr, variables));
+    if(p.is_zero()) return Symbolic(make_expression<Number>(0));
+    if(variables.empty()) return Symbolic(make_expression<Number>(Rational(p.coefficient(0), std::move(denominator))));
+    auto f = factor(p);
+    std::vector<ExprPtr> factors;
+    factors.push_back(make_expression<Number>(Rational(std::move(f.content), std::move(denominator))));
+    for(auto& [g, multiplicity] : f.factors){
+        auto e = to_symbolic(g, variables).expr()->copy();
+        if(multiplicity == 1) factors.push_back(std::move(e));
+        else factors.push_back(make_expression<Power>(std::move(e), make_expression<Number>(multiplicity)));
+    }
+    return Symbolic(make_expression<Product>(std::move(factors)));
+}
+
+} // namespace
+
+template<class C>
+auto to_sparse_poly(const Symbolic& expr, const std::vector<std::string>& variables, MonomialOrder order) -> SparsePoly<C> {
+    auto d = degree_bound(expr.expr());
+    auto bits = d < (1l << 15) ? 16u : 32u;
+    auto converter = Converter<C>{MonomialLayout(variables.size(), order, bits), variables};
+    return converter.convert(expr.expr());
+}
+
+template<class C>
+auto to_symbolic(const SparsePoly<C>& p, const std::vector<std::string>& variables) -> Symbolic {
+    if(variables.size() != p.layout().variables()){
+        throw std::runtime_error(fmt::format("Expected {} variable names, got {}", p.layout().variables(), variables.size()));
+    }
+    std::vector<ExprPtr> terms;
+    for(std::size_t i = 0; i < p.size(); i++){
+        std::vector<ExprPtr> factors;
+        factors.push_back(make_expression<Number>(Rational(p.coefficient(i))));
+        auto e = p.exponents(i);
+        for(std::size_t k = 0; k < e.size(); k++){
+            if(e[k] == 0) continue;
+            factors.push_back(make_expression<Power>(make_expression<Symbol>(variables[k]), make_expression<Number>(e[k])));
+        }
+        terms.push_back(make_expression<Product>(std::move(factors)));
+    }
+    if(terms.empty()) return Symbolic(make_expression<Number>(0));
+    return Symbolic(make_expression<Sum>(std::move(terms)));
+}
+
+auto gcd(const Symbolic& a, const Symbolic& b) -> Symbolic {
+    auto integral = true;
+    auto variables = symbols(integral, a, b);
+    if(integral) return to_symbolic(::gcd(to_sparse_poly<MPi>(a, variables), to_sparse_poly<MPi>(b, variables)), variables);
+    return to_symbolic(::gcd(to_sparse_poly<Rational>(a, variables), to_sparse_poly<Rational>(b, variables)), variables);
+}
+
+auto square_free(const Symbolic& expr) -> Symbolic {
+    return factored(expr, [](const SparsePoly<MPi>& p){ return ::square_free(p); });
+}
+
+auto factor(const Symbolic& expr) -> Symbolic {
+    return factored(expr, [](const SparsePoly<MPi>& p){
+        if(p.layout().variables() > 1) return ::square_free(p);
+        auto f = ::factor(factor_impl::to_upoly(p));
+        auto ret = Factorization<SparsePoly<MPi>>{std::move(f.content), {}};
+        for(auto& [g, multiplicity] : f.factors) ret.factors.emplace_back(factor_impl::to_sparse(g), multiplicity);
+        return ret;
+    });
+}
+
+auto groebner(const std::vector<Symbolic>& polys, const std::vector<std::string>& variables, MonomialOrder order, GroebnerOptions options) -> std::vector<Symbolic> {
+    auto [integral, denominators] = integer_polynomials(polys, variables, order);
+    std::vector<Symbolic> ret;
+    for(const auto& g : ::groebner(integral, options)) ret.push_back(to_symbolic(g, variables));
+    return ret;
+}
+
+auto resultant(const Symbolic& a, const Symbolic& b, const std::string& variable) -> Symbolic {
+    auto integral = true;
+    auto variables = symbols(integral, a, b);
+    auto x = index_of(variables, variable);
+    auto [p, d] = integer_polynomials({a, b}, variables);
+    auto r = ::resultant(p[0], p[1], x);
+    // res(a / d_a, b / d_b) = res(a, b) / (d_a^deg b d_b^deg a)
+    auto scale = math::pow(d[0], std::max(p[1].degree(x), 0l)) * math::pow(d[1], std::max(p[0].degree(x), 0l));
+    return to_symbolic(divided(r, scale), variables);
+}
+
+auto discriminant(const Symbolic& a, const std::string& variable) -> Symbolic {
+    auto integral = true;
+    auto variables = symbols(integral, a);
+    auto x = index_of(variables, variable);
+    auto [p, d] = integer_polynomials({a}, variables);
+    auto r = ::discriminant(p[0], x);
+    // disc(a / d) = disc(a) / d^(2 deg a - 2)
+    return to_symbolic(divided(r, math::pow(d[0], 2 * p[0].degree(x) - 2)), variables);
+}
+
+auto real_roots(const Symbolic& expr, const std::string& variable, RealRootOptions options) -> std::vector<std::pair<Symbolic, Symbolic>> {
+    auto p = clear_denominators(to_sparse_poly<Rational>(expr, {variable})).first;
+    std::vector<std::pair<Symbolic, Symbolic>> ret;
+    for(const auto& [lower, upper] : ::real_roots(factor_impl::to_upoly(p), options)) ret.emplace_back(num(lower), num(upper));
+    return ret;
+}
+
+template auto to_sparse_poly<MPi>(const Symbolic&, const std::vector<std::string>&, MonomialOrder) -> SparsePoly<MPi>;
+template auto to_sparse_poly<Rational>(const Symbolic&, const std::vector<std::string>&, MonomialOrder) -> SparsePoly<Rational>;
+template auto to_symbolic<MPi>(const SparsePoly<MPi>&, const std::vector<std::string>&) -> Symbolic;
+template auto to_symbolic<Rational>(const SparsePoly<Rational>&, const std::vector<std::string>&) -> Symbolic;
+
+} // namespace symb
@@ -1,5 +1,6 @@
 #include "symbolic/simplify.hpp"
 
+#include "symbolic/evaluate.hpp"
 
 
 namespace symb{
@@ -53,6 +54,10 @@ ExprPtr Simplifier::automatic_simplify(ExprPtr x){
 
 ExprPtr Simplifier::automatic_simplify_impl(const SimplificationContext& sc, ExprPtr expr){
     simplify_subexpressions(sc, expr, automatic_simplify_impl);
+    return automatic_simplify_node(sc, std::move(expr));
+}
+
+ExprPtr Simplifier::automatic_simplify_node(const SimplificationContext& sc, ExprPtr expr){
     switch(expr->kind()){
     case Kind::Function: return automatic_simplify_function(sc, std::move(expr));
     case Kind::PowOp : return automatic_simplify_power(sc, std::move(expr));
@@ -122,6 +127,12 @@ ExprPtr Simplifier::automatic_simplify_sum(const SimplificationContext& sc, Expr
 
 ExprPtr Simplifier::automatic_simplify_product(const SimplificationContext& sc, ExprPtr expr){
     expr = assoc_expand<Kind::ProdOp>(sc, std::move(expr));
+    if(std::any_of(expr->children.begin(), expr->children.end(), [](const ExprPtr& x){ return x->kind() == Kind::Undefined; })){
+        return make_expression<Undefined>();
+    }
+    if(std::any_of(expr->children.begin(), expr->children.end(), [&](const ExprPtr& x){ return sc.is_zero(x); })){
+        return make_expression<Number>(0);
+    }
     expr = sort_subexpressions(sc, std::move(expr));
     expr = combine_subexpressions(std::move(expr), [&](auto write_iter, ExprPtr& lhs, ExprPtr& rhs){
         auto unpack_number = [](const ExprPtr& num){
@@ -189,13 +200,13 @@ ExprPtr Simplifier::automatic_simplify_integer_power(const SimplificationContext
     if(b->kind() == Kind::PowOp){
         auto new_exponent = automatic_simplify_product(sc,
             make_expression<Product>(
-                std::move(b->children[0]),
+                std::move(b->children[1]),
                 std::move(e)
             )
         );
         return automatic_simplify_power(sc,
             make_expression<Power>(
-                std::move(b->children[1]),
+                std::move(b->children[0]),
                 std::move(new_exponent)
             )
         );
@@ -361,7 +372,10 @@ auto simplify_differentiation(const SimplificationContext& sc, ExprPtr x) -> Exp
         std::vector<ExprPtr> new_summands;
         for(auto& s : expr->children){
             new_summands.emplace_back(
-                make_expression<Function>("diff", std::move(s), var->copy())
+                Simplifier::automatic_simplify_function(
+                    sc,
+                    make_expression<Function>("diff", std::move(s), var->copy())
+                )
             );
         }
         return Simplifier::automatic_simplify_sum(
@@ -372,7 +386,23 @@ auto simplify_differentiation(const SimplificationContext& sc, ExprPtr x) -> Exp
         );
     }
     case Kind::Function:{
-        return make_expression<Function>("diff", std::move(expr), std::move(var));
+        auto f = find_builtin(get_as<Function>(expr)->name);
+        if(not f || expr->children.size() != 1){
+            return make_expression<Function>("diff", std::move(expr), std::move(var));
+        }
+        auto& argument = expr->children[0];
+        auto u = Symbolic::from_simplified(argument->copy());
+        auto derivative = builtin_derivative(*f, u, Symbolic::from_simplified(expr->copy()));
+        return Simplifier::automatic_simplify_product(
+            sc,
+            make_expression<Product>(
+                derivative.expr()->copy(),
+                Simplifier::automatic_simplify_function(
+                    sc,
+                    make_expression<Function>("diff", argument->copy(), var->copy())
+                )
+            )
+        );
     }
     default: return make_expression<Undefined>();
     }
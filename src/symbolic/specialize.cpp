@@ -0,0 +1,76 @@
+#include "symbolic/specialize.hpp"
+
+#include <optional>
+
+namespace symb{
+namespace impl{
+namespace{
+
+using Number_t = ExpressionBase::Number_t;
+
+// Exact values of the builtin functions at the points where they are rational.
+auto fold_function(const ExprPtr& e) -> std::optional<Number_t> {
+    if(e->children.size() != 1 || e->children[0]->kind() != Kind::Number) return std::nullopt;
+    const auto& name = get_as<Function>(e)->name;
+    const auto& x = get_as<Number>(e->children[0])->value;
+    if(x == 0 && (name == "sin" || name == "tan" || name == "sqrt")) return Number_t(0);
+    if(x == 0 && (name == "cos" || name == "exp")) return Number_t(1);
+    if(x == 1 && name == "log") return Number_t(0);
+    if(name == "sqrt" && x > 0){
+        auto num = x.num();
+        auto den = x.denom();
+        if(mpz_perfect_square_p(num.handle()) && mpz_perfect_square_p(den.handle())){
+            mpz_sqrt(num.handle(), num.handle());
+            mpz_sqrt(den.handle(), den.handle());
+            return Number_t(std::move(num), std::move(den));
+        }
+    }
+    return std::nullopt;
+}
+
+struct Specializer {
+    const SimplificationContext& sc;
+    const Parameters& params;
+
+    // Returns nothing if the subtree does not contain any parameter.
+    auto run(const ExprPtr& e) -> std::optional<ExprPtr> {
+        if(e->kind() == Kind::Symbol){
+            auto it = params.find(get_as<Symbol>(e)->name);
+            if(it == params.end()) return std::nullopt;
+            return make_expression<Number>(it->second);
+        }
+        std::vector<std::optional<ExprPtr>> replaced;
+        auto changed = false;
+        for(const auto& x : e->children){
+            replaced.push_back(run(x));
+            changed = changed || replaced.back().has_value();
+        }
+        if(not changed) return std::nullopt;
+
+        std::vector<ExprPtr> children;
+        for(std::size_t i = 0; i < replaced.size(); i++){
+            children.push_back(replaced[i] ? std::move(*replaced[i]) : e->children[i]->copy());
+        }
+        auto ret = Simplifier::automatic_simplify_node(sc, with_children(e, std::move(children)));
+        if(ret->kind() == Kind::Function){
+            if(auto v = fold_function(ret)) return make_expression<Number>(*v);
+        }
+        return ret;
+    }
+};
+
+} // namespace
+} // namespace impl
+
+auto specialize(const Symbolic& expr, const Parameters& params) -> Symbolic {
+    auto sc = impl::SimplificationContext{};
+    auto ret = impl::Specializer{sc, params}.run(expr.expr());
+    if(not ret) return expr;
+    return Symbolic::from_simplified(std::move(*ret));
+}
+
+auto specialize(const Symbolic& expr, const Parameters& params, std::vector<std::string> variables) -> Program {
+    return compile(specialize(expr, params), std::move(variables));
+}
+
+} // namespace symb
@@ -0,0 +1,86 @@
+#include "symbolic/substitute.hpp"
+
+#include <optional>
+
+#include "symbolic/compare.hpp"
+
+namespace symb{
+namespace impl{
+namespace{
+
+struct Substituter {
+    const SimplificationContext& sc;
+    // Patterns and their replacements by the hash of the pattern
+    std::unordered_multimap<std::size_t, std::pair<const ExprPtr*, const ExprPtr*>> rules;
+    std::unordered_map<const ExpressionBase*, std::size_t> hashes;
+    // Subtrees substituted so far by their hash, with the result if it
+    // differs
+    std::unordered_multimap<std::size_t, std::pair<const ExprPtr*, std::optional<ExprPtr>>> done;
+
+    auto hash(const ExprPtr& e) -> std::size_t {
+        std::vector<std::size_t> children;
+        for(const auto& c : e->children) children.push_back(hash(c));
+        auto h = hash_node(e, children);
+        hashes.emplace(e.get(), h);
+        return h;
+    }
+
+    static auto copy(const std::optional<ExprPtr>& e) -> std::optional<ExprPtr> {
+        if(not e) return std::nullopt;
+        return (*e)->copy();
+    }
+
+    // Returns nothing if the subtree does not change
+    auto run(const ExprPtr& e) -> std::optional<ExprPtr> {
+        auto h = hashes.at(e.get());
+        auto [first, last] = rules.equal_range(h);
+        for(auto it = first; it != last; ++it){
+            if(cmp_expression(*it->second.first, e) == 0) return (*it->second.second)->copy();
+        }
+        if(e->children.empty()) return std::nullopt;
+        auto [begin, end] = done.equal_range(h);
+        for(auto it = begin; it != end; ++it){
+            if(cmp_expression(*it->second.first, e) == 0) return copy(it->second.second);
+        }
+
+        std::vector<std::optional<ExprPtr>> replaced;
+        auto changed = false;
+        for(const auto& x : e->children){
+            replaced.push_back(run(x));
+            changed = changed || replaced.back().has_value();
+        }
+        std::optional<ExprPtr> ret;
+        if(changed){
+            std::vector<ExprPtr> children;
+            for(std::size_t i = 0; i < replaced.size(); i++){
+                children.push_back(replaced[i] ? std::move(*replaced[i]) : e->children[i]->copy());
+            }
+            ret = Simplifier::automatic_simplify_node(sc, with_children(e, std::move(children)));
+        }
+        auto it = done.emplace(h, std::pair{&e, std::move(ret)});
+        return copy(it->second.second);
+    }
+};
+
+} // namespace
+} // namespace impl
+
+auto subs(const Symbolic& expr, const std::vector<std::pair<Symbolic, Symbolic>>& rules) -> Symbolic {
+    auto sc = impl::SimplificationContext{};
+    auto substituter = impl::Substituter{sc, {}, {}, {}};
+    for(const auto& [pattern, replacement] : rules){
+        substituter.rules.emplace(impl::hash_expression(pattern.expr()), std::pair{&pattern.expr(), &replacement.expr()});
+    }
+    substituter.hash(expr.expr());
+    auto ret = substituter.run(expr.expr());
+    if(not ret) return expr;
+    return Symbolic::from_simplified(std::move(*ret));
+}
+
+auto subs(const Symbolic& expr, const std::unordered_map<std::string, Symbolic>& symbols) -> Symbolic {
+    std::vector<std::pair<Symbolic, Symbolic>> rules;
+    for(const auto& [name, replacement] : symbols) rules.emplace_back(var(name), replacement);
+    return subs(expr, rules);
+}
+
+} // namespace symb
@@ -0,0 +1,103 @@
+#include "math/groebner.hpp"
+
+#include <set>
+
+#include <fmt/format.h>
+
+// Lex bases of standard zero-dimensional systems. Before the conversion
+// from grevlex, F4 in lex ran out of memory on cyclic-5 and Katsura in
+// five variables.
+
+using multiprecision::MPi;
+using Poly = SparsePoly<MPi>;
+
+namespace{
+
+auto cyclic(std::size_t n, const MonomialLayout& layout) -> std::vector<Poly> {
+    std::vector<Poly> ret;
+    for(std::size_t d = 1; d < n; d++){
+        auto s = Poly(layout);
+        for(std::size_t i = 0; i < n; i++){
+            auto t = Poly::constant(layout, MPi(1));
+            for(std::size_t j = 0; j < d; j++) t = t * Poly::variable(layout, (i + j) % n);
+            s = s + t;
+        }
+        ret.push_back(std::move(s));
+    }
+    auto t = Poly::constant(layout, MPi(1));
+    for(std::size_t i = 0; i < n; i++) t = t * Poly::variable(layout, i);
+    ret.push_back(t - Poly::constant(layout, MPi(1)));
+    return ret;
+}
+
+// In the variables u_0, ..., u_n with u_-i = u_i and u_i = 0 for i > n
+auto katsura(std::size_t n, const MonomialLayout& layout) -> std::vector<Poly> {
+    auto u = [&](long i){
+        auto k = static_cast<std::size_t>(std::abs(i));
+        return k <= n ? Poly::variable(layout, k) : Poly(layout);
+    };
+    auto m = static_cast<long>(n);
+    std::vector<Poly> ret;
+    auto s = Poly::constant(layout, MPi(-1));
+    for(long i = -m; i <= m; i++) s = s + u(i);
+    ret.push_back(std::move(s));
+    for(long k = 0; k < m; k++){
+        auto t = Poly(layout) - u(k);
+        for(long i = -m; i <= m; i++) t = t + u(i) * u(k - i);
+        ret.push_back(std::move(t));
+    }
+    return ret;
+}
+
+// The number of monomials no leading monomial of the basis divides, the
+// number of solutions with multiplicity
+auto standard_monomials(const std::vector<SparsePoly<FieldOfFractions<MPi>>>& basis, std::size_t variables) -> std::size_t {
+    std::vector<std::vector<long>> leads;
+    for(const auto& g : basis) leads.push_back(g.exponents(0));
+    auto standard = [&](const std::vector<long>& e){
+        return std::ranges::none_of(leads, [&](const auto& l){
+            for(std::size_t k = 0; k < variables; k++){
+                if(l[k] > e[k]) return false;
+            }
+            return true;
+        });
+    };
+    std::set<std::vector<long>> seen;
+    std::vector<std::vector<long>> queue;
+    if(standard(std::vector<long>(variables, 0))) queue.emplace_back(variables, 0);
+    while(not queue.empty()){
+        auto e = std::move(queue.back());
+        queue.pop_back();
+        if(not seen.insert(e).second) continue;
+        for(std::size_t k = 0; k < variables; k++){
+            auto f = e;
+            f[k]++;
+            if(standard(f)) queue.push_back(std::move(f));
+        }
+    }
+    return seen.size();
+}
+
+auto check(const char* name, const std::vector<Poly>& system, std::size_t variables, std::size_t solutions) -> bool {
+    const auto& layout = system.front().layout();
+    auto basis = groebner(system);
+    auto ok = not basis.empty() && standard_monomials(basis, variables) == solutions;
+    for(std::size_t i = 0; ok && i < basis.size(); i++){
+        ok = basis[i].leading_coefficient() == 1;
+        if(ok && i > 0) ok = layout.compare(basis[i - 1].monomial(0), basis[i].monomial(0)) > 0;
+    }
+    fmt::print("{}: {}\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    auto ok = true;
+    auto lex5 = MonomialLayout(5, MonomialOrder::Lex, 16);
+    ok &= check("cyclic-5 in lex", cyclic(5, lex5), 5, 70);
+    ok &= check("katsura-4 in lex", katsura(4, lex5), 5, 16);
+    auto grevlex5 = MonomialLayout(5, MonomialOrder::Grevlex, 16);
+    ok &= check("cyclic-5 in grevlex", cyclic(5, grevlex5), 5, 70);
+    return ok ? 0 : 1;
+}